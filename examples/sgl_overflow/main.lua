@@ -0,0 +1,34 @@
+-- draws more than one sokol_gl context can hold while deferred drawing is
+-- on, so every context past the first is made while the frame is flushed.
+-- quits with an error if a frame hangs, drops vertices or doesn't overflow.
+
+function spry.conf(t)
+  t.max_vertices = 4096
+  t.max_commands = 256
+end
+
+local frames = 0
+
+function spry.start()
+  spry.deferred_draw(true)
+end
+
+function spry.frame(dt)
+  if frames > 0 then
+    local stats = spry.draw_stats()
+    assert(stats.sgl_contexts > 2, "expected the frame to overflow")
+    assert(stats.sgl_dropped == 0, "dropped vertices")
+  end
+
+  frames = frames + 1
+  if frames > 10 then
+    print "ok"
+    spry.quit()
+    return
+  end
+
+  local w = spry.window_width()
+  for i = 0, 4000 do
+    spry.draw_filled_rect((i * 7) % w, (i // 8) % 600, 4, 4)
+  end
+end
@@ -3,6 +3,8 @@
 #include "array.h"
 #include "assets.h"
 #include "atlas.h"
+#include "batch.h"
+#include "canvas.h"
 #include "concurrency.h"
 #include "deps/microui.h"
 #include "deps/sokol_app.h"
@@ -16,6 +18,7 @@
 #include "luax.h"
 #include "microui.h"
 #include "os.h"
+#include "particles.h"
 #include "physics.h"
 #include "prelude.h"
 #include "profile.h"
@@ -23,9 +26,11 @@
 #include "sprite.h"
 #include "stb_decompress.h"
 #include "sync.h"
+#include "text.h"
 #include "tilemap.h"
 #include "vfs.h"
 #include <box2d/box2d.h>
+#include <new>
 
 #ifndef IS_HTML5
 #include "embed/ltn12_compressed.h"
@@ -152,6 +157,14 @@ static int open_mt_channel(lua_State *L) {
 
 // mt_image
 
+static int mt_image_gc(lua_State *L) {
+  u64 *udata = (u64 *)luaL_checkudata(L, 1, "mt_image");
+  if (*udata != 0) {
+    asset_release(*udata);
+  }
+  return 0;
+}
+
 static int mt_image_draw(lua_State *L) {
   Image img = check_asset_mt(L, 1, "mt_image").image;
 
@@ -174,6 +187,7 @@ static int mt_image_height(lua_State *L) {
 
 static int open_mt_image(lua_State *L) {
   luaL_Reg reg[] = {
+      {"__gc", mt_image_gc},
       {"draw", mt_image_draw},
       {"width", mt_image_width},
       {"height", mt_image_height},
@@ -184,6 +198,126 @@ static int open_mt_image(lua_State *L) {
   return 0;
 }
 
+// mt_canvas
+
+static Canvas *check_canvas_udata(lua_State *L, i32 arg) {
+  Canvas **udata = (Canvas **)luaL_checkudata(L, arg, "mt_canvas");
+  Canvas *canvas = *udata;
+  return canvas;
+}
+
+static int mt_canvas_gc(lua_State *L) {
+  Canvas *canvas = check_canvas_udata(L, 1);
+  canvas->trash();
+  mem_free(canvas);
+  return 0;
+}
+
+static int mt_canvas_begin(lua_State *L) {
+  Canvas *canvas = check_canvas_udata(L, 1);
+
+  bool ok = false;
+  if (lua_isboolean(L, 2) && !lua_toboolean(L, 2)) {
+    ok = canvas->begin(nullptr);
+  } else {
+    Color clear = {};
+    clear.r = (u8)luaL_optnumber(L, 2, 0);
+    clear.g = (u8)luaL_optnumber(L, 3, 0);
+    clear.b = (u8)luaL_optnumber(L, 4, 0);
+    clear.a = (u8)luaL_optnumber(L, 5, 0);
+    ok = canvas->begin(&clear);
+  }
+
+  if (!ok) {
+    return luaL_error(L, "can't begin a canvas inside another canvas");
+  }
+  return 0;
+}
+
+static int mt_canvas_finish(lua_State *L) {
+  Canvas *canvas = check_canvas_udata(L, 1);
+  canvas->finish();
+  return 0;
+}
+
+static int mt_canvas_draw(lua_State *L) {
+  Canvas *canvas = check_canvas_udata(L, 1);
+
+  DrawDescription dd = draw_description_args(L, 2);
+  draw_image(&canvas->img, &dd);
+  return 0;
+}
+
+static int mt_canvas_width(lua_State *L) {
+  Canvas *canvas = check_canvas_udata(L, 1);
+  lua_pushnumber(L, canvas->img.width);
+  return 1;
+}
+
+static int mt_canvas_height(lua_State *L) {
+  Canvas *canvas = check_canvas_udata(L, 1);
+  lua_pushnumber(L, canvas->img.height);
+  return 1;
+}
+
+static int open_mt_canvas(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_canvas_gc},
+      {"begin", mt_canvas_begin},
+      {"finish", mt_canvas_finish},
+      {"draw", mt_canvas_draw},
+      {"width", mt_canvas_width},
+      {"height", mt_canvas_height},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_canvas", reg);
+  return 0;
+}
+
+// mt_text
+
+struct LuaText {
+  StaticText text;
+  i32 font_ref;
+};
+
+static LuaText *check_text_udata(lua_State *L, i32 arg) {
+  LuaText **udata = (LuaText **)luaL_checkudata(L, arg, "mt_text");
+  LuaText *lt = *udata;
+  return lt;
+}
+
+static int mt_text_gc(lua_State *L) {
+  LuaText *lt = check_text_udata(L, 1);
+  lt->text.trash();
+  luaL_unref(L, LUA_REGISTRYINDEX, lt->font_ref);
+  mem_free(lt);
+  return 0;
+}
+
+static int mt_text_draw(lua_State *L) {
+  LuaText *lt = check_text_udata(L, 1);
+
+  lua_Number x = luaL_optnumber(L, 2, 0);
+  lua_Number y = luaL_optnumber(L, 3, 0);
+
+  float bottom = lt->text.draw((float)x, (float)y);
+  lua_pushnumber(L, bottom);
+  return 1;
+}
+
+static int open_mt_text(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_text_gc},
+      {"draw", mt_text_draw},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_text", reg);
+  return 0;
+}
+
 // mt_font
 
 static FontFamily *check_font_udata(lua_State *L, i32 arg) {
@@ -235,11 +369,30 @@ static int mt_font_draw(lua_State *L) {
   return 1;
 }
 
+static int mt_font_make_text(lua_State *L) {
+  FontFamily *font = check_font_udata(L, 1);
+
+  String text = luax_check_string(L, 2);
+  lua_Number size = luaL_optnumber(L, 3, 12);
+  lua_Number wrap = luaL_optnumber(L, 4, -1);
+
+  LuaText *lt = (LuaText *)mem_alloc(sizeof(LuaText));
+  lt->text.make(font, (u64)size, text, (float)wrap);
+
+  // the text draws with the font's atlas images, so keep the font alive
+  lua_pushvalue(L, 1);
+  lt->font_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+  luax_ptr_userdata(L, lt, "mt_text");
+  return 1;
+}
+
 static int open_mt_font(lua_State *L) {
   luaL_Reg reg[] = {
       {"__gc", mt_font_gc},
       {"width", mt_font_width},
       {"draw", mt_font_draw},
+      {"make_text", mt_font_make_text},
       {nullptr, nullptr},
   };
 
@@ -436,6 +589,14 @@ static Sprite *check_sprite_udata(lua_State *L, i32 arg) {
   return spr;
 }
 
+static int mt_sprite_gc(lua_State *L) {
+  Sprite *spr = check_sprite_udata(L, 1);
+  if (spr->sprite != 0) {
+    asset_release(spr->sprite);
+  }
+  return 0;
+}
+
 static int mt_sprite_play(lua_State *L) {
   Sprite *spr = check_sprite_udata(L, 1);
   String tag = luax_check_string(L, 2);
@@ -459,6 +620,7 @@ static int mt_sprite_update(lua_State *L) {
 
 static int mt_sprite_draw(lua_State *L) {
   Sprite *spr = check_sprite_udata(L, 1);
+  check_asset(L, spr->sprite); // errors after spry.unload, like images
   DrawDescription dd = draw_description_args(L, 2);
 
   draw_sprite(spr, &dd);
@@ -499,6 +661,7 @@ static int mt_sprite_total_frames(lua_State *L) {
 
 static int open_mt_sprite(lua_State *L) {
   luaL_Reg reg[] = {
+      {"__gc", mt_sprite_gc},
       {"play", mt_sprite_play},
       {"update", mt_sprite_update},
       {"draw", mt_sprite_draw},
@@ -592,9 +755,29 @@ static int open_mt_atlas(lua_State *L) {
 
 // mt_tilemap
 
+static int mt_tilemap_gc(lua_State *L) {
+  u64 *udata = (u64 *)luaL_checkudata(L, 1, "mt_tilemap");
+  if (*udata != 0) {
+    asset_release(*udata);
+  }
+  return 0;
+}
+
 static int mt_tilemap_draw(lua_State *L) {
   Tilemap tm = check_asset_mt(L, 1, "mt_tilemap").tilemap;
-  draw_tilemap(&tm);
+
+  Vector4 view = {};
+  if (lua_isnoneornil(L, 2)) {
+    view = renderer_view_rect();
+  } else {
+    lua_Number x = luaL_checknumber(L, 2);
+    lua_Number y = luaL_checknumber(L, 3);
+    lua_Number w = luaL_checknumber(L, 4);
+    lua_Number h = luaL_checknumber(L, 5);
+    view = vec4((float)x, (float)y, (float)(x + w), (float)(y + h));
+  }
+
+  draw_tilemap(&tm, view);
   return 0;
 }
 
@@ -734,6 +917,7 @@ static int mt_tilemap_astar(lua_State *L) {
 
 static int open_mt_tilemap(lua_State *L) {
   luaL_Reg reg[] = {
+      {"__gc", mt_tilemap_gc},
       {"draw", mt_tilemap_draw},
       {"entities", mt_tilemap_entities},
       {"make_collision", mt_tilemap_make_collision},
@@ -747,6 +931,548 @@ static int open_mt_tilemap(lua_State *L) {
   return 0;
 }
 
+// mt_batch
+
+static SpriteBatch *check_batch_udata(lua_State *L, i32 arg) {
+  SpriteBatch **udata = (SpriteBatch **)luaL_checkudata(L, arg, "mt_batch");
+  SpriteBatch *batch = *udata;
+  return batch;
+}
+
+static int mt_batch_gc(lua_State *L) {
+  SpriteBatch *batch = check_batch_udata(L, 1);
+  if (batch->image != 0) {
+    asset_release(batch->image);
+  }
+  batch->trash();
+  mem_free(batch);
+  return 0;
+}
+
+static int mt_batch_add(lua_State *L) {
+  SpriteBatch *batch = check_batch_udata(L, 1);
+  DrawDescription dd = draw_description_args(L, 2);
+
+  bool ok = batch->add(&dd);
+  if (!ok) {
+    return 0;
+  }
+
+  lua_pushinteger(L, (lua_Integer)batch->len);
+  return 1;
+}
+
+static int mt_batch_set(lua_State *L) {
+  SpriteBatch *batch = check_batch_udata(L, 1);
+  lua_Integer index = luaL_checkinteger(L, 2);
+  DrawDescription dd = draw_description_args(L, 3);
+
+  bool ok = index >= 1 && batch->set((u64)(index - 1), &dd);
+  lua_pushboolean(L, ok);
+  return 1;
+}
+
+static int mt_batch_clear(lua_State *L) {
+  SpriteBatch *batch = check_batch_udata(L, 1);
+  batch->clear();
+  return 0;
+}
+
+static int mt_batch_draw(lua_State *L) {
+  SpriteBatch *batch = check_batch_udata(L, 1);
+  batch->draw();
+  return 0;
+}
+
+static int mt_batch_len(lua_State *L) {
+  SpriteBatch *batch = check_batch_udata(L, 1);
+  lua_pushinteger(L, (lua_Integer)batch->len);
+  return 1;
+}
+
+static int mt_batch_capacity(lua_State *L) {
+  SpriteBatch *batch = check_batch_udata(L, 1);
+  lua_pushinteger(L, (lua_Integer)batch->capacity);
+  return 1;
+}
+
+static int open_mt_batch(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_batch_gc},
+      {"add", mt_batch_add},
+      {"set", mt_batch_set},
+      {"clear", mt_batch_clear},
+      {"draw", mt_batch_draw},
+      {"len", mt_batch_len},
+      {"capacity", mt_batch_capacity},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_batch", reg);
+  return 0;
+}
+
+// mt_instances
+
+static InstanceBuffer *check_instances_udata(lua_State *L, i32 arg) {
+  InstanceBuffer **udata =
+      (InstanceBuffer **)luaL_checkudata(L, arg, "mt_instances");
+  InstanceBuffer *buf = *udata;
+  return buf;
+}
+
+static int mt_instances_gc(lua_State *L) {
+  InstanceBuffer *buf = check_instances_udata(L, 1);
+  buf->trash();
+  mem_free(buf);
+  return 0;
+}
+
+static int mt_instances_add(lua_State *L) {
+  InstanceBuffer *buf = check_instances_udata(L, 1);
+  DrawDescription dd = draw_description_args(L, 2);
+
+  bool ok = buf->add(&dd);
+  if (!ok) {
+    return 0;
+  }
+
+  lua_pushinteger(L, (lua_Integer)buf->len);
+  return 1;
+}
+
+static int mt_instances_set(lua_State *L) {
+  InstanceBuffer *buf = check_instances_udata(L, 1);
+  lua_Integer index = luaL_checkinteger(L, 2);
+  DrawDescription dd = draw_description_args(L, 3);
+
+  bool ok = index >= 1 && buf->set((u64)(index - 1), &dd);
+  lua_pushboolean(L, ok);
+  return 1;
+}
+
+static int mt_instances_clear(lua_State *L) {
+  InstanceBuffer *buf = check_instances_udata(L, 1);
+  buf->clear();
+  return 0;
+}
+
+static int mt_instances_len(lua_State *L) {
+  InstanceBuffer *buf = check_instances_udata(L, 1);
+  lua_pushinteger(L, (lua_Integer)buf->len);
+  return 1;
+}
+
+static int mt_instances_capacity(lua_State *L) {
+  InstanceBuffer *buf = check_instances_udata(L, 1);
+  lua_pushinteger(L, (lua_Integer)buf->capacity);
+  return 1;
+}
+
+static int open_mt_instances(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_instances_gc},
+      {"add", mt_instances_add},
+      {"set", mt_instances_set},
+      {"clear", mt_instances_clear},
+      {"len", mt_instances_len},
+      {"capacity", mt_instances_capacity},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_instances", reg);
+  return 0;
+}
+
+// mt_emitter
+
+static ParticleEmitter *check_emitter_udata(lua_State *L, i32 arg) {
+  ParticleEmitter **udata =
+      (ParticleEmitter **)luaL_checkudata(L, arg, "mt_emitter");
+  ParticleEmitter *emitter = *udata;
+  return emitter;
+}
+
+static int mt_emitter_gc(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  if (emitter->image != 0) {
+    asset_release(emitter->image);
+  }
+  emitter->trash();
+  mem_free(emitter);
+  return 0;
+}
+
+static int mt_emitter_update(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  lua_Number dt = luaL_checknumber(L, 2);
+  emitter->update((float)dt);
+  return 0;
+}
+
+static int mt_emitter_draw(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  emitter->draw();
+  return 0;
+}
+
+static int mt_emitter_emit(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  lua_Integer count = luaL_checkinteger(L, 2);
+  if (count > 0) {
+    emitter->emit((u64)count);
+  }
+  return 0;
+}
+
+static int mt_emitter_set_position(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  emitter->x = (float)luaL_checknumber(L, 2);
+  emitter->y = (float)luaL_checknumber(L, 3);
+  return 0;
+}
+
+static int mt_emitter_set_rate(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  emitter->rate = (float)luaL_checknumber(L, 2);
+  return 0;
+}
+
+static int mt_emitter_set_direction(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  emitter->direction = (float)luaL_checknumber(L, 2);
+  return 0;
+}
+
+static int mt_emitter_clear(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  emitter->clear();
+  return 0;
+}
+
+static int mt_emitter_len(lua_State *L) {
+  ParticleEmitter *emitter = check_emitter_udata(L, 1);
+  lua_pushinteger(L, (lua_Integer)emitter->len);
+  return 1;
+}
+
+static int open_mt_emitter(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_emitter_gc},
+      {"update", mt_emitter_update},
+      {"draw", mt_emitter_draw},
+      {"emit", mt_emitter_emit},
+      {"set_position", mt_emitter_set_position},
+      {"set_rate", mt_emitter_set_rate},
+      {"set_direction", mt_emitter_set_direction},
+      {"clear", mt_emitter_clear},
+      {"len", mt_emitter_len},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_emitter", reg);
+  return 0;
+}
+
+// mt_draw_list
+
+enum DrawListUse : i32 {
+  DrawListUse_Idle,
+  DrawListUse_Recording,
+  DrawListUse_Drawing,
+};
+
+// lists are sent to other states through channels. every userdata pointing
+// at a list holds a reference, and so does a copy waiting in a channel.
+struct LuaDrawList {
+  DrawList list;
+  std::atomic<i32> refs;
+  std::atomic<i32> use; // DrawListUse, so recording and playback don't overlap
+};
+
+static LuaDrawList *check_draw_list_udata(lua_State *L, i32 arg) {
+  LuaDrawList **udata = (LuaDrawList **)luaL_checkudata(L, arg, "mt_draw_list");
+  LuaDrawList *ldl = *udata;
+  return ldl;
+}
+
+static void draw_list_release(LuaDrawList *ldl) {
+  if (ldl->refs.fetch_sub(1) == 1) {
+    ldl->list.trash();
+    mem_free(ldl);
+  }
+}
+
+static int mt_draw_list_gc(lua_State *L) {
+  LuaDrawList *ldl = check_draw_list_udata(L, 1);
+  draw_list_release(ldl);
+  return 0;
+}
+
+// waits for a playback on another thread to end. false if the list is being
+// recorded.
+static bool draw_list_acquire(LuaDrawList *ldl) {
+  while (true) {
+    i32 use = DrawListUse_Idle;
+    if (ldl->use.compare_exchange_weak(use, DrawListUse_Recording)) {
+      return true;
+    }
+
+    if (use == DrawListUse_Recording) {
+      return false;
+    }
+    os_yield();
+  }
+}
+
+static int mt_draw_list_begin(lua_State *L) {
+  LuaDrawList *ldl = check_draw_list_udata(L, 1);
+
+  if (!draw_list_acquire(ldl)) {
+    return luaL_error(L, "already recording this draw list");
+  }
+
+  bool ok = renderer_record(&ldl->list);
+  if (!ok) {
+    ldl->use.store(DrawListUse_Idle);
+    return luaL_error(L, "already recording a draw list");
+  }
+  return 0;
+}
+
+static int mt_draw_list_finish(lua_State *L) {
+  LuaDrawList *ldl = check_draw_list_udata(L, 1);
+  if (ldl->list.recording) {
+    renderer_stop_recording();
+    ldl->use.store(DrawListUse_Idle);
+  }
+  return 0;
+}
+
+static int mt_draw_list_clear(lua_State *L) {
+  LuaDrawList *ldl = check_draw_list_udata(L, 1);
+
+  if (!draw_list_acquire(ldl)) {
+    return luaL_error(L, "can't clear a draw list while recording it");
+  }
+
+  ldl->list.clear();
+  ldl->use.store(DrawListUse_Idle);
+  return 0;
+}
+
+// a list being recorded on another thread is skipped
+static bool draw_list_start_playback(LuaDrawList *ldl) {
+  i32 use = DrawListUse_Idle;
+  return ldl->use.compare_exchange_strong(use, DrawListUse_Drawing);
+}
+
+static int mt_draw_list_draw(lua_State *L) {
+  LuaDrawList *ldl = check_draw_list_udata(L, 1);
+
+  if (!draw_list_start_playback(ldl)) {
+    lua_pushboolean(L, false);
+    return 1;
+  }
+
+  renderer_draw_list(&ldl->list);
+  ldl->use.store(DrawListUse_Idle);
+
+  lua_pushboolean(L, true);
+  return 1;
+}
+
+static int mt_draw_list_set_order(lua_State *L) {
+  LuaDrawList *ldl = check_draw_list_udata(L, 1);
+  ldl->list.order = (i32)luaL_checkinteger(L, 2);
+  return 0;
+}
+
+static int mt_draw_list_len(lua_State *L) {
+  LuaDrawList *ldl = check_draw_list_udata(L, 1);
+  lua_pushinteger(L, (lua_Integer)ldl->list.vertices.len);
+  return 1;
+}
+
+static int open_mt_draw_list(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_draw_list_gc},
+      {"begin", mt_draw_list_begin},
+      {"finish", mt_draw_list_finish},
+      {"clear", mt_draw_list_clear},
+      {"draw", mt_draw_list_draw},
+      {"set_order", mt_draw_list_set_order},
+      {"len", mt_draw_list_len},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_draw_list", reg);
+  return 0;
+}
+
+// mt_asset_future
+
+// shared between states like LuaDrawList
+struct LuaAssetFuture {
+  AssetFuture *future;
+  AssetKind kind;
+  std::atomic<i32> refs;
+};
+
+static LuaAssetFuture *check_asset_future_udata(lua_State *L, i32 arg) {
+  LuaAssetFuture **udata =
+      (LuaAssetFuture **)luaL_checkudata(L, arg, "mt_asset_future");
+  LuaAssetFuture *laf = *udata;
+  return laf;
+}
+
+static void asset_future_udata_release(LuaAssetFuture *laf) {
+  if (laf->refs.fetch_sub(1) == 1) {
+    asset_future_release(laf->future);
+    mem_free(laf);
+  }
+}
+
+static int mt_asset_future_gc(lua_State *L) {
+  LuaAssetFuture *laf = check_asset_future_udata(L, 1);
+  asset_future_udata_release(laf);
+  return 0;
+}
+
+static int mt_asset_future_ready(lua_State *L) {
+  LuaAssetFuture *laf = check_asset_future_udata(L, 1);
+  lua_pushboolean(L, asset_future_done(laf->future));
+  return 1;
+}
+
+static int mt_asset_future_get(lua_State *L) {
+  LuaAssetFuture *laf = check_asset_future_udata(L, 1);
+
+  Asset asset = {};
+  bool ok = asset_future_get(laf->future, &asset) && asset_retain(asset.hash);
+  if (!ok) {
+    return 0;
+  }
+
+  switch (laf->kind) {
+  case AssetKind_Image: luax_new_userdata(L, asset.hash, "mt_image"); break;
+  case AssetKind_Sprite: {
+    Sprite spr = {};
+    spr.sprite = asset.hash;
+    luax_new_userdata(L, spr, "mt_sprite");
+    break;
+  }
+  case AssetKind_Tilemap:
+    luax_new_userdata(L, asset.hash, "mt_tilemap");
+    break;
+  default: return 0;
+  }
+  return 1;
+}
+
+static int open_mt_asset_future(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_asset_future_gc},
+      {"ready", mt_asset_future_ready},
+      {"get", mt_asset_future_get},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_asset_future", reg);
+  return 0;
+}
+
+void lua_shared_udata_retain(String tname, void *ptr) {
+  if (tname == "mt_draw_list") {
+    ((LuaDrawList *)ptr)->refs.fetch_add(1);
+  } else if (tname == "mt_asset_future") {
+    ((LuaAssetFuture *)ptr)->refs.fetch_add(1);
+  }
+}
+
+void lua_shared_udata_release(String tname, void *ptr) {
+  if (tname == "mt_draw_list") {
+    draw_list_release((LuaDrawList *)ptr);
+  } else if (tname == "mt_asset_future") {
+    asset_future_udata_release((LuaAssetFuture *)ptr);
+  }
+}
+
+// mt_file
+
+static VFSFile *check_file(lua_State *L, i32 arg) {
+  VFSFile **udata = (VFSFile **)luaL_checkudata(L, arg, "mt_file");
+  if (*udata == nullptr) {
+    luaL_error(L, "file is closed");
+  }
+  return *udata;
+}
+
+static int mt_file_gc(lua_State *L) {
+  VFSFile **udata = (VFSFile **)luaL_checkudata(L, 1, "mt_file");
+  if (*udata != nullptr) {
+    vfs_file_close(*udata);
+    *udata = nullptr;
+  }
+  return 0;
+}
+
+static int mt_file_read(lua_State *L) {
+  PROFILE_FUNC();
+
+  VFSFile *f = check_file(L, 1);
+  u64 remaining = vfs_file_size(f) - vfs_file_tell(f);
+  lua_Integer want = luaL_optinteger(L, 2, (lua_Integer)remaining);
+  if (want < 0) {
+    return luaL_error(L, "can't read a negative number of bytes");
+  }
+
+  u64 len = (u64)want < remaining ? (u64)want : remaining;
+  if (len == 0 && want != 0) {
+    return 0;
+  }
+
+  luaL_Buffer b;
+  char *buf = luaL_buffinitsize(L, &b, len);
+  u64 n = vfs_file_read(f, buf, len);
+  luaL_pushresultsize(&b, n);
+  return 1;
+}
+
+static int mt_file_seek(lua_State *L) {
+  VFSFile *f = check_file(L, 1);
+  lua_Integer offset = luaL_checkinteger(L, 2);
+  lua_pushboolean(L, offset >= 0 && vfs_file_seek(f, (u64)offset));
+  return 1;
+}
+
+static int mt_file_tell(lua_State *L) {
+  VFSFile *f = check_file(L, 1);
+  lua_pushinteger(L, (lua_Integer)vfs_file_tell(f));
+  return 1;
+}
+
+static int mt_file_size(lua_State *L) {
+  VFSFile *f = check_file(L, 1);
+  lua_pushinteger(L, (lua_Integer)vfs_file_size(f));
+  return 1;
+}
+
+static int open_mt_file(lua_State *L) {
+  luaL_Reg reg[] = {
+      {"__gc", mt_file_gc},
+      {"close", mt_file_gc},
+      {"read", mt_file_read},
+      {"seek", mt_file_seek},
+      {"tell", mt_file_tell},
+      {"size", mt_file_size},
+      {nullptr, nullptr},
+  };
+
+  luax_new_class(L, "mt_file", reg);
+  return 0;
+}
+
 // box2d fixture
 
 static int mt_b2_fixture_friction(lua_State *L) {
@@ -2303,7 +3029,7 @@ static int spry_scissor_rect(lua_State *L) {
   lua_Number w = luaL_optnumber(L, 3, sapp_widthf());
   lua_Number h = luaL_optnumber(L, 4, sapp_heightf());
 
-  sgl_scissor_rectf(x, y, w, h, true);
+  renderer_scissor_rect(x, y, w, h);
   return 0;
 }
 
@@ -2380,6 +3106,43 @@ static int spry_pop_color(lua_State *L) {
   return ok ? 0 : luaL_error(L, "color stack can't be less than 1");
 }
 
+static int spry_deferred_draw(lua_State *L) {
+  bool deferred = lua_toboolean(L, 1);
+  renderer_set_deferred(deferred);
+  return 0;
+}
+
+static int spry_draw_layer(lua_State *L) {
+  if (lua_gettop(L) == 0) {
+    lua_pushinteger(L, renderer_get_layer());
+    return 1;
+  }
+
+  lua_Integer layer = luaL_checkinteger(L, 1);
+  renderer_set_layer((i32)layer);
+  return 0;
+}
+
+static int spry_draw_stats(lua_State *L) {
+  RendererStats stats = renderer_stats();
+
+  lua_createtable(L, 0, 10);
+  luax_set_int_field(L, "commands", (lua_Integer)stats.commands);
+  luax_set_int_field(L, "vertices", (lua_Integer)stats.vertices);
+  luax_set_int_field(L, "state_changes", (lua_Integer)stats.state_changes);
+  luax_set_int_field(L, "state_changes_saved",
+                     (lua_Integer)stats.state_changes_saved);
+  luax_set_int_field(L, "sgl_vertices", (lua_Integer)stats.sgl_vertices);
+  luax_set_int_field(L, "sgl_commands", (lua_Integer)stats.sgl_commands);
+  luax_set_int_field(L, "sgl_contexts", (lua_Integer)stats.sgl_contexts);
+  luax_set_int_field(L, "sgl_dropped", (lua_Integer)stats.sgl_dropped);
+  luax_set_int_field(L, "sgl_vertices_peak",
+                     (lua_Integer)stats.sgl_vertices_peak);
+  luax_set_int_field(L, "sgl_commands_peak",
+                     (lua_Integer)stats.sgl_commands_peak);
+  return 1;
+}
+
 static int spry_default_font(lua_State *L) {
   if (g_app->default_font == nullptr) {
     g_app->default_font = (FontFamily *)mem_alloc(sizeof(FontFamily));
@@ -2421,6 +3184,51 @@ static int spry_draw_line(lua_State *L) {
   return 0;
 }
 
+static int spry_draw_instances(lua_State *L) {
+  InstanceBuffer *buf = check_instances_udata(L, 2);
+
+  AtlasImage *atlas_img =
+      (AtlasImage *)luaL_testudata(L, 1, "mt_atlas_image");
+  if (atlas_img != nullptr) {
+    buf->draw(atlas_img->img, atlas_img->u0, atlas_img->v0, atlas_img->u1,
+              atlas_img->v1);
+  } else {
+    Image img = check_asset_mt(L, 1, "mt_image").image;
+    float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+    img.uvs(&u0, &v0, &u1, &v1);
+    buf->draw(img.texture(), u0, v0, u1, v1);
+  }
+
+  return 0;
+}
+
+static int spry_draw_lists(lua_State *L) {
+  i32 n = lua_gettop(L);
+
+  Array<LuaDrawList *> playing = {};
+  Array<DrawList *> lists = {};
+  defer({
+    for (LuaDrawList *ldl : playing) {
+      ldl->use.store(DrawListUse_Idle);
+    }
+    playing.trash();
+    lists.trash();
+  });
+
+  playing.reserve(n);
+  lists.reserve(n);
+  for (i32 i = 1; i <= n; i++) {
+    LuaDrawList *ldl = check_draw_list_udata(L, i);
+    if (draw_list_start_playback(ldl)) {
+      playing.push(ldl);
+      lists.push(&ldl->list);
+    }
+  }
+
+  renderer_draw_lists(Slice(lists));
+  return 0;
+}
+
 static int spry_set_master_volume(lua_State *L) {
   lua_Number vol = luaL_checknumber(L, 1);
   ma_engine_set_volume(&g_app->audio_engine, (float)vol);
@@ -2487,20 +3295,33 @@ static int spry_file_read(lua_State *L) {
 
   String path = luax_check_string(L, 1);
 
-  String contents = {};
-  bool ok = vfs_read_entire_file(&contents, path);
+  FileView view = {};
+  bool ok = vfs_view_file(&view, path);
   if (!ok) {
     lua_pushnil(L);
     lua_pushboolean(L, false);
     return 2;
   }
-  defer(mem_free(contents.data));
+  defer(vfs_release_view(&view));
+  String contents = view.contents;
 
   lua_pushlstring(L, contents.data, contents.len);
   lua_pushboolean(L, true);
   return 2;
 }
 
+static int spry_file_open(lua_State *L) {
+  String path = luax_check_string(L, 1);
+
+  VFSFile *f = vfs_open(path);
+  if (f == nullptr) {
+    return 0;
+  }
+
+  luax_ptr_userdata(L, f, "mt_file");
+  return 1;
+}
+
 static int spry_file_write(lua_State *L) {
   String path = luax_check_string(L, 1);
   String contents = luax_check_string(L, 2);
@@ -2596,7 +3417,7 @@ static int spry_image_load(lua_State *L) {
   desc.generate_mips = generate_mips;
 
   Asset asset = {};
-  bool ok = asset_load(desc, str, &asset);
+  bool ok = asset_load(desc, str, &asset) && asset_retain(asset.hash);
   if (!ok) {
     return 0;
   }
@@ -2607,9 +3428,10 @@ static int spry_image_load(lua_State *L) {
 
 static int spry_font_load(lua_State *L) {
   String str = luax_check_string(L, 1);
+  bool sdf = lua_toboolean(L, 2);
 
   FontFamily *font = (FontFamily *)mem_alloc(sizeof(FontFamily));
-  bool ok = font->load(str);
+  bool ok = font->load(str, sdf);
   if (!ok) {
     mem_free(font);
     return 0;
@@ -2635,7 +3457,8 @@ static int spry_sprite_load(lua_State *L) {
   String str = luax_check_string(L, 1);
 
   Asset asset = {};
-  bool ok = asset_load_kind(AssetKind_Sprite, str, &asset);
+  bool ok = asset_load_kind(AssetKind_Sprite, str, &asset) &&
+            asset_retain(asset.hash);
   if (!ok) {
     return 0;
   }
@@ -2665,7 +3488,8 @@ static int spry_tilemap_load(lua_State *L) {
   String str = luax_check_string(L, 1);
 
   Asset asset = {};
-  bool ok = asset_load_kind(AssetKind_Tilemap, str, &asset);
+  bool ok = asset_load_kind(AssetKind_Tilemap, str, &asset) &&
+            asset_retain(asset.hash);
   if (!ok) {
     return 0;
   }
@@ -2674,6 +3498,253 @@ static int spry_tilemap_load(lua_State *L) {
   return 1;
 }
 
+static int load_async(lua_State *L, AssetLoadData desc) {
+  String str = luax_check_string(L, 1);
+
+  LuaAssetFuture *laf = (LuaAssetFuture *)mem_alloc(sizeof(LuaAssetFuture));
+  laf->future = asset_load_async(desc, str);
+  laf->kind = desc.kind;
+  new (&laf->refs) std::atomic<i32>(1);
+
+  luax_ptr_userdata(L, laf, "mt_asset_future");
+  return 1;
+}
+
+static int spry_image_load_async(lua_State *L) {
+  AssetLoadData desc = {};
+  desc.kind = AssetKind_Image;
+  desc.generate_mips = lua_toboolean(L, 2);
+  return load_async(L, desc);
+}
+
+static int spry_sprite_load_async(lua_State *L) {
+  AssetLoadData desc = {};
+  desc.kind = AssetKind_Sprite;
+  return load_async(L, desc);
+}
+
+static int spry_tilemap_load_async(lua_State *L) {
+  AssetLoadData desc = {};
+  desc.kind = AssetKind_Tilemap;
+  return load_async(L, desc);
+}
+
+static int spry_unload(lua_State *L) {
+  u64 key = 0;
+
+  if (u64 *udata = (u64 *)luaL_testudata(L, 1, "mt_image")) {
+    key = *udata;
+    *udata = 0;
+  } else if (u64 *udata = (u64 *)luaL_testudata(L, 1, "mt_tilemap")) {
+    key = *udata;
+    *udata = 0;
+  } else {
+    Sprite *spr = check_sprite_udata(L, 1);
+    key = spr->sprite;
+    spr->sprite = 0;
+  }
+
+  if (key != 0) {
+    asset_release(key, true);
+  }
+  return 0;
+}
+
+static void push_asset_usage(const Asset *asset, void *udata) {
+  lua_State *L = (lua_State *)udata;
+
+  const char *kind = "";
+  switch (asset->kind) {
+  case AssetKind_LuaRef: kind = "script"; break;
+  case AssetKind_Image: kind = "image"; break;
+  case AssetKind_Sprite: kind = "sprite"; break;
+  case AssetKind_Tilemap: kind = "tilemap"; break;
+  default: break;
+  }
+
+  lua_createtable(L, 0, 5);
+  luax_set_string_field(L, "name", asset->name.data);
+  luax_set_string_field(L, "kind", kind);
+  luax_set_int_field(L, "refs", asset->refs);
+  luax_set_int_field(L, "cpu_bytes", (lua_Integer)asset->cpu_bytes);
+  luax_set_int_field(L, "gpu_bytes", (lua_Integer)asset->gpu_bytes);
+  lua_rawseti(L, -2, luaL_len(L, -2) + 1);
+}
+
+static int spry_asset_stats(lua_State *L) {
+  AssetStats stats = assets_stats();
+
+  lua_createtable(L, 0, 6);
+  luax_set_int_field(L, "count", (lua_Integer)stats.count);
+  luax_set_int_field(L, "cpu_bytes", (lua_Integer)stats.cpu_bytes);
+  luax_set_int_field(L, "gpu_bytes", (lua_Integer)stats.gpu_bytes);
+  luax_set_int_field(L, "budget", (lua_Integer)stats.budget);
+  luax_set_int_field(L, "unloaded", (lua_Integer)stats.unloaded);
+
+  if (lua_toboolean(L, 1)) {
+    lua_createtable(L, (i32)stats.count, 0);
+    assets_each(push_asset_usage, L);
+    lua_setfield(L, -2, "assets");
+  }
+  return 1;
+}
+
+static int spry_make_batch(lua_State *L) {
+  lua_Integer capacity = luaL_optinteger(L, 2, 1024);
+  if (capacity <= 0) {
+    return luaL_error(L, "batch capacity must be positive");
+  }
+
+  SpriteBatch *batch = (SpriteBatch *)mem_alloc(sizeof(SpriteBatch));
+  *batch = {};
+  batch->u1 = 1;
+  batch->v1 = 1;
+
+  AtlasImage *atlas_img =
+      (AtlasImage *)luaL_testudata(L, 1, "mt_atlas_image");
+  if (atlas_img != nullptr) {
+    batch->img = atlas_img->img;
+    batch->u0 = atlas_img->u0;
+    batch->v0 = atlas_img->v0;
+    batch->u1 = atlas_img->u1;
+    batch->v1 = atlas_img->v1;
+  } else {
+    Asset asset = check_asset_mt(L, 1, "mt_image");
+    asset_retain(asset.hash);
+    batch->image = asset.hash;
+    batch->img = asset.image.texture();
+    asset.image.uvs(&batch->u0, &batch->v0, &batch->u1, &batch->v1);
+  }
+
+  batch->make((u64)capacity);
+
+  luax_ptr_userdata(L, batch, "mt_batch");
+  return 1;
+}
+
+static int spry_make_canvas(lua_State *L) {
+  lua_Integer width = luaL_checkinteger(L, 1);
+  lua_Integer height = luaL_checkinteger(L, 2);
+  if (width <= 0 || height <= 0) {
+    return luaL_error(L, "canvas size must be positive");
+  }
+
+  Canvas *canvas = (Canvas *)mem_alloc(sizeof(Canvas));
+  bool ok = canvas->make((i32)width, (i32)height);
+  if (!ok) {
+    mem_free(canvas);
+    return 0;
+  }
+
+  luax_ptr_userdata(L, canvas, "mt_canvas");
+  return 1;
+}
+
+static int spry_make_instances(lua_State *L) {
+  lua_Integer capacity = luaL_optinteger(L, 1, 1024);
+  if (capacity <= 0) {
+    return luaL_error(L, "instance capacity must be positive");
+  }
+
+  InstanceBuffer *buf = (InstanceBuffer *)mem_alloc(sizeof(InstanceBuffer));
+  *buf = {};
+  buf->make((u64)capacity);
+
+  luax_ptr_userdata(L, buf, "mt_instances");
+  return 1;
+}
+
+// color from a {r, g, b, a} table field
+static Color opt_color_field(lua_State *L, i32 arg, const char *key,
+                             Color fallback) {
+  i32 type = lua_getfield(L, arg, key);
+  if (type != LUA_TTABLE) {
+    lua_pop(L, 1);
+    return fallback;
+  }
+
+  u8 rgba[4] = {};
+  for (i32 i = 0; i < 4; i++) {
+    luax_geti(L, -1, i + 1);
+    rgba[i] = (u8)luaL_optnumber(L, -1, 255);
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+
+  return {rgba[0], rgba[1], rgba[2], rgba[3]};
+}
+
+static int spry_make_emitter(lua_State *L) {
+  lua_Integer capacity = luax_opt_int_field(L, 2, "capacity", 1024);
+  if (capacity <= 0) {
+    return luaL_error(L, "emitter capacity must be positive");
+  }
+
+  ParticleEmitter *emitter =
+      (ParticleEmitter *)mem_alloc(sizeof(ParticleEmitter));
+  *emitter = {};
+  emitter->u1 = 1;
+  emitter->v1 = 1;
+
+  AtlasImage *atlas_img =
+      (AtlasImage *)luaL_testudata(L, 1, "mt_atlas_image");
+  if (atlas_img != nullptr) {
+    emitter->img = atlas_img->img;
+    emitter->u0 = atlas_img->u0;
+    emitter->v0 = atlas_img->v0;
+    emitter->u1 = atlas_img->u1;
+    emitter->v1 = atlas_img->v1;
+  } else {
+    Asset asset = check_asset_mt(L, 1, "mt_image");
+    asset_retain(asset.hash);
+    emitter->image = asset.hash;
+    emitter->img = asset.image.texture();
+    asset.image.uvs(&emitter->u0, &emitter->v0, &emitter->u1, &emitter->v1);
+  }
+
+  auto number = [L](const char *key, lua_Number fallback) {
+    return (float)luax_opt_number_field(L, 2, key, fallback);
+  };
+
+  emitter->x = number("x", 0);
+  emitter->y = number("y", 0);
+  emitter->rate = number("rate", 0);
+  emitter->direction = number("direction", 0);
+  emitter->spread = number("spread", MATH_PI);
+  emitter->speed_min = number("speed_min", 0);
+  emitter->speed_max = number("speed_max", emitter->speed_min);
+  emitter->life_min = number("life_min", 1);
+  emitter->life_max = number("life_max", emitter->life_min);
+  emitter->spin_min = number("spin_min", 0);
+  emitter->spin_max = number("spin_max", emitter->spin_min);
+  emitter->ax = number("ax", 0);
+  emitter->ay = number("ay", 0);
+  emitter->scale_start = number("scale_start", 1);
+  emitter->scale_end = number("scale_end", emitter->scale_start);
+
+  Color white = {255, 255, 255, 255};
+  emitter->color_start = opt_color_field(L, 2, "color_start", white);
+  emitter->color_end =
+      opt_color_field(L, 2, "color_end", emitter->color_start);
+
+  emitter->make((u64)capacity);
+
+  luax_ptr_userdata(L, emitter, "mt_emitter");
+  return 1;
+}
+
+static int spry_make_draw_list(lua_State *L) {
+  lua_Integer order = luaL_optinteger(L, 1, 0);
+
+  LuaDrawList *ldl = (LuaDrawList *)mem_alloc(sizeof(LuaDrawList));
+  ldl->list.make((i32)order);
+  new (&ldl->refs) std::atomic<i32>(1);
+  new (&ldl->use) std::atomic<i32>(DrawListUse_Idle);
+
+  luax_ptr_userdata(L, ldl, "mt_draw_list");
+  return 1;
+}
+
 static int spry_b2_world(lua_State *L) {
   lua_Number gx = luax_opt_number_field(L, 1, "gx", 0);
   lua_Number gy = luax_opt_number_field(L, 1, "gy", 9.81);
@@ -2731,12 +3802,17 @@ static int open_spry(lua_State *L) {
       {"clear_color", spry_clear_color},
       {"push_color", spry_push_color},
       {"pop_color", spry_pop_color},
+      {"deferred_draw", spry_deferred_draw},
+      {"draw_layer", spry_draw_layer},
+      {"draw_stats", spry_draw_stats},
       {"default_font", spry_default_font},
       {"default_sampler", spry_default_sampler},
       {"draw_filled_rect", spry_draw_filled_rect},
       {"draw_line_rect", spry_draw_line_rect},
       {"draw_line_circle", spry_draw_line_circle},
       {"draw_line", spry_draw_line},
+      {"draw_instances", spry_draw_instances},
+      {"draw_lists", spry_draw_lists},
 
       // audio
       {"set_master_volume", spry_set_master_volume},
@@ -2752,6 +3828,7 @@ static int open_spry(lua_State *L) {
       {"is_fused", spry_is_fused},
       {"file_exists", spry_file_exists},
       {"file_read", spry_file_read},
+      {"file_open", spry_file_open},
       {"file_write", spry_file_write},
 
       // construct types
@@ -2759,11 +3836,21 @@ static int open_spry(lua_State *L) {
       {"make_thread", spry_make_thread},
       {"make_channel", spry_make_channel},
       {"image_load", spry_image_load},
+      {"image_load_async", spry_image_load_async},
       {"font_load", spry_font_load},
       {"sound_load", spry_sound_load},
       {"sprite_load", spry_sprite_load},
+      {"sprite_load_async", spry_sprite_load_async},
       {"atlas_load", spry_atlas_load},
       {"tilemap_load", spry_tilemap_load},
+      {"tilemap_load_async", spry_tilemap_load_async},
+      {"unload", spry_unload},
+      {"asset_stats", spry_asset_stats},
+      {"make_batch", spry_make_batch},
+      {"make_canvas", spry_make_canvas},
+      {"make_instances", spry_make_instances},
+      {"make_emitter", spry_make_emitter},
+      {"make_draw_list", spry_make_draw_list},
       {"b2_world", spry_b2_world},
       {nullptr, nullptr},
   };
@@ -2774,12 +3861,14 @@ static int open_spry(lua_State *L) {
 
 void open_spry_api(lua_State *L) {
   lua_CFunction mt_funcs[] = {
-      open_mt_sampler,  open_mt_thread,       open_mt_channel,
-      open_mt_image,    open_mt_font,         open_mt_sound,
-      open_mt_sprite,   open_mt_atlas_image,  open_mt_atlas,
-      open_mt_tilemap,  open_mt_b2_fixture,   open_mt_b2_body,
-      open_mt_b2_world, open_mt_mu_container, open_mt_mu_style,
-      open_mt_mu_ref,
+      open_mt_sampler,      open_mt_thread,       open_mt_channel,
+      open_mt_image,        open_mt_canvas,       open_mt_font,
+      open_mt_text,         open_mt_sound,        open_mt_sprite,
+      open_mt_atlas_image,  open_mt_atlas,        open_mt_tilemap,
+      open_mt_batch,        open_mt_instances,    open_mt_emitter,
+      open_mt_draw_list,    open_mt_asset_future, open_mt_file,
+      open_mt_b2_fixture,   open_mt_b2_body,      open_mt_b2_world,
+      open_mt_mu_container, open_mt_mu_style,     open_mt_mu_ref,
   };
 
   for (u32 i = 0; i < array_size(mt_funcs); i++) {
@@ -1,5 +1,13 @@
 #pragma once
 
+#include "prelude.h"
+
 struct lua_State;
 void open_spry_api(lua_State *L);
-void open_luasocket(lua_State *L);
\ No newline at end of file
+void open_luasocket(lua_State *L);
+
+// userdata that lua states share by reference count, like draw lists and
+// asset futures. a copy waiting in a channel holds a reference too. other
+// types are ignored.
+void lua_shared_udata_retain(String tname, void *ptr);
+void lua_shared_udata_release(String tname, void *ptr);
\ No newline at end of file
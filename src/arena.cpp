@@ -37,6 +37,28 @@ void Arena::trash() {
   }
 }
 
+// free everything, keeping one block big enough to hold all of it so that
+// an arena reused every frame stops allocating once it warms up
+void Arena::reset() {
+  if (head == nullptr) {
+    return;
+  }
+
+  if (head->next == nullptr) {
+    head->allocd = 0;
+    head->prev = 0;
+    return;
+  }
+
+  u64 capacity = 0;
+  for (ArenaNode *a = head; a != nullptr; a = a->next) {
+    capacity += a->capacity;
+  }
+
+  trash();
+  head = arena_block_make(capacity);
+}
+
 void *Arena::bump(u64 size) {
   if (head == nullptr) {
     head = arena_block_make(size);
@@ -92,3 +114,11 @@ String Arena::bump_string(String s) {
     return {};
   }
 }
+
+u64 Arena::size() const {
+  u64 bytes = 0;
+  for (ArenaNode *a = head; a != nullptr; a = a->next) {
+    bytes += offsetof(ArenaNode, buf) + a->capacity;
+  }
+  return bytes;
+}
@@ -7,7 +7,9 @@ struct Arena {
   ArenaNode *head;
 
   void trash();
+  void reset();
   void *bump(u64 size);
   void *rebump(void *ptr, u64 old, u64 size);
   String bump_string(String s);
+  u64 size() const; // bytes held by every block
 };
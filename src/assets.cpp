@@ -1,9 +1,12 @@
 #include "assets.h"
 #include "app.h"
+#include "draw.h"
+#include "jobs.h"
 #include "luax.h"
 #include "os.h"
 #include "profile.h"
 #include "sync.h"
+#include <new>
 
 struct FileChange {
   u64 key;
@@ -14,11 +17,20 @@ struct Assets {
   HashMap<Asset> table;
   RWLock rw_lock;
 
+  // guarded by rw_lock
+  u64 frame;
+  u64 budget;
+  u64 cpu_bytes;
+  u64 gpu_bytes;
+  u64 unloaded;
+  Array<Asset> retired; // unloaded, but draws queued this frame can use them
+
   Mutex shutdown_mtx;
   Cond shutdown_notify;
   bool shutdown;
 
   Thread reload_thread;
+  OSWatch *watch; // null when polling modtimes
 
   Mutex changes_mtx;
   Array<FileChange> changes;
@@ -27,6 +39,101 @@ struct Assets {
 
 static Assets g_assets = {};
 
+struct AssetFuture {
+  std::atomic<i32> refs; // one for the caller, one for the job
+  std::atomic<bool> done;
+  bool ok;
+  AssetLoadData desc;
+  String filepath;
+  Asset asset;
+};
+
+static void trash_asset(Asset *a) {
+  mem_free(a->name.data);
+
+  switch (a->kind) {
+  case AssetKind_Image: a->image.trash(); break;
+  case AssetKind_Sprite: a->sprite.trash(); break;
+  case AssetKind_Tilemap: a->tilemap.trash(); break;
+  default: break;
+  }
+}
+
+static void measure_asset(Asset *a) {
+  a->cpu_bytes = 0;
+  a->gpu_bytes = 0;
+
+  switch (a->kind) {
+  case AssetKind_Image: a->gpu_bytes = a->image.memory_size(); break;
+  case AssetKind_Sprite: {
+    a->cpu_bytes = a->sprite.arena.size();
+    a->gpu_bytes = a->sprite.img.memory_size();
+    break;
+  }
+  case AssetKind_Tilemap: {
+    Tilemap *tm = &a->tilemap;
+
+    u64 tiles = 0;
+    for (TilemapLevel &level : tm->levels) {
+      for (TilemapLayer &layer : level.layers) {
+        tiles += layer.tiles.len;
+      }
+    }
+
+    a->cpu_bytes = tm->arena.size();
+    a->gpu_bytes = tiles * (sizeof(SpriteVertex) * 4 + sizeof(u32) * 6);
+    for (auto [k, v] : tm->images) {
+      a->gpu_bytes += v->memory_size();
+    }
+    break;
+  }
+  default: break;
+  }
+}
+
+// the caller holds the unique lock
+static void count_bytes(const Asset *a, bool add) {
+  if (add) {
+    g_assets.cpu_bytes += a->cpu_bytes;
+    g_assets.gpu_bytes += a->gpu_bytes;
+  } else {
+    g_assets.cpu_bytes -= a->cpu_bytes;
+    g_assets.gpu_bytes -= a->gpu_bytes;
+  }
+}
+
+// false if an asset with the same key is in the table already
+static bool asset_insert(Asset asset, Asset *existing) {
+  g_assets.rw_lock.unique_lock();
+  defer(g_assets.rw_lock.unique_unlock());
+
+  const Asset *found = g_assets.table.get(asset.hash);
+  if (found != nullptr) {
+    *existing = *found;
+    return false;
+  }
+
+  asset.refs = 0;
+  asset.last_used = g_assets.frame;
+  count_bytes(&asset, true);
+  g_assets.table[asset.hash] = asset;
+  return true;
+}
+
+// false if the asset was unloaded
+static bool touch_asset(u64 key) {
+  g_assets.rw_lock.unique_lock();
+  defer(g_assets.rw_lock.unique_unlock());
+
+  Asset *found = g_assets.table.get(key);
+  if (found == nullptr) {
+    return false;
+  }
+
+  found->last_used = g_assets.frame;
+  return true;
+}
+
 static void hot_reload_thread(void *) {
   u32 reload_interval = g_app->reload_interval.load();
 
@@ -77,6 +184,60 @@ static void hot_reload_thread(void *) {
   }
 }
 
+static void push_change(FileChange change) {
+  LockGuard lock{&g_assets.changes_mtx};
+
+  // a file can be written several times before the next frame
+  for (FileChange &c : g_assets.changes) {
+    if (c.key == change.key) {
+      c.modtime = change.modtime;
+      return;
+    }
+  }
+
+  g_assets.changes.push(change);
+}
+
+static void on_file_changed(String filepath, void *) {
+  Asset a = {};
+  bool found = asset_read(fnv1a(filepath), &a);
+  if (!found) {
+    // scripts can load files with a leading ./
+    char buf[1024];
+    i32 n = snprintf(buf, sizeof(buf), "./%s", filepath.data);
+    if (n > 0 && n < (i32)sizeof(buf)) {
+      found = asset_read(fnv1a({buf, (u64)n}), &a);
+    }
+  }
+
+  if (!found) {
+    return;
+  }
+
+  FileChange change = {};
+  change.key = a.hash;
+  change.modtime = os_file_modtime(a.name.data);
+  push_change(change);
+}
+
+// waits for file system events instead of polling, so nothing runs until a
+// file actually changes
+static void watch_thread(void *) {
+  while (os_watch_wait(g_assets.watch, on_file_changed, nullptr)) {
+  }
+
+  {
+    LockGuard lock{&g_assets.shutdown_mtx};
+    if (g_assets.shutdown) {
+      return;
+    }
+  }
+
+  // the watch broke without being stopped
+  fprintf(stderr, "watching files failed, polling for changes instead\n");
+  hot_reload_thread(nullptr);
+}
+
 void assets_perform_hot_reload_changes() {
   LockGuard lock{&g_assets.changes_mtx};
 
@@ -89,7 +250,9 @@ void assets_perform_hot_reload_changes() {
   for (FileChange change : g_assets.changes) {
     Asset a = {};
     bool exists = asset_read(change.key, &a);
-    assert(exists);
+    if (!exists) {
+      continue; // unloaded since the change was seen
+    }
 
     a.modtime = change.modtime;
 
@@ -104,7 +267,7 @@ void assets_perform_hot_reload_changes() {
     case AssetKind_Image: {
       bool generate_mips = a.image.has_mips;
       a.image.trash();
-      ok = a.image.load(a.name, generate_mips);
+      ok = a.image.load(a.name, generate_mips, true);
       break;
     }
     case AssetKind_Sprite: {
@@ -125,6 +288,7 @@ void assets_perform_hot_reload_changes() {
       return;
     }
 
+    measure_asset(&a);
     asset_write(a);
     printf("reloaded: %s\n", a.name.data);
   }
@@ -139,24 +303,30 @@ void assets_shutdown() {
       g_assets.shutdown = true;
     }
 
+    if (g_assets.watch != nullptr) {
+      os_watch_stop(g_assets.watch);
+    }
+
     g_assets.shutdown_notify.signal();
     g_assets.reload_thread.join();
+
+    if (g_assets.watch != nullptr) {
+      os_watch_trash(g_assets.watch);
+    }
     g_assets.changes.trash();
     g_assets.tmp_changes.trash();
   }
 
   for (auto [k, v] : g_assets.table) {
-    mem_free(v->name.data);
-
-    switch (v->kind) {
-    case AssetKind_Image: v->image.trash(); break;
-    case AssetKind_Sprite: v->sprite.trash(); break;
-    case AssetKind_Tilemap: v->tilemap.trash(); break;
-    default: break;
-    }
+    trash_asset(v);
   }
   g_assets.table.trash();
 
+  for (Asset &a : g_assets.retired) {
+    trash_asset(&a);
+  }
+  g_assets.retired.trash();
+
   g_assets.shutdown_notify.trash();
   g_assets.changes_mtx.trash();
   g_assets.shutdown_mtx.trash();
@@ -170,7 +340,13 @@ void assets_start_hot_reload() {
   g_assets.rw_lock.make();
 
   if (g_app->hot_reload_enabled.load()) {
-    g_assets.reload_thread.make(hot_reload_thread, nullptr);
+    // the mounted directory is the working directory
+    g_assets.watch = os_watch_dir(".");
+    if (g_assets.watch != nullptr) {
+      g_assets.reload_thread.make(watch_thread, nullptr);
+    } else {
+      g_assets.reload_thread.make(hot_reload_thread, nullptr);
+    }
   }
 }
 
@@ -187,8 +363,10 @@ bool asset_load(AssetLoadData desc, String filepath, Asset *out) {
   u64 key = fnv1a(filepath);
 
   {
+    // an unreferenced asset is marked as used, so it isn't unloaded before
+    // the caller gets a chance to take a reference
     Asset asset = {};
-    if (asset_read(key, &asset)) {
+    if (asset_read(key, &asset) && (asset.refs > 0 || touch_asset(key))) {
       if (out != nullptr) {
         *out = asset;
       }
@@ -218,7 +396,7 @@ bool asset_load(AssetLoadData desc, String filepath, Asset *out) {
       break;
     }
     case AssetKind_Image:
-      ok = asset.image.load(filepath, desc.generate_mips);
+      ok = asset.image.load(filepath, desc.generate_mips, true);
       break;
     case AssetKind_Sprite: ok = asset.sprite.load(filepath); break;
     case AssetKind_Tilemap: ok = asset.tilemap.load(filepath); break;
@@ -230,7 +408,19 @@ bool asset_load(AssetLoadData desc, String filepath, Asset *out) {
       return false;
     }
 
-    asset_write(asset);
+    measure_asset(&asset);
+
+    if (desc.kind == AssetKind_LuaRef) {
+      asset_write(asset);
+    } else {
+      // with async loads, another thread can load the same file at the
+      // same time. the first one in the table wins.
+      Asset existing = {};
+      if (!asset_insert(asset, &existing)) {
+        trash_asset(&asset);
+        asset = existing;
+      }
+    }
 
     if (out != nullptr) {
       *out = asset;
@@ -239,6 +429,68 @@ bool asset_load(AssetLoadData desc, String filepath, Asset *out) {
   }
 }
 
+static void load_async(void *udata) {
+  AssetFuture *f = (AssetFuture *)udata;
+
+  f->ok = asset_load(f->desc, f->filepath, &f->asset);
+  if (f->ok) {
+    asset_retain(f->asset.hash);
+  }
+  f->done.store(true);
+  asset_future_release(f);
+}
+
+AssetFuture *asset_load_async(AssetLoadData desc, String filepath) {
+  PROFILE_FUNC();
+
+  assert(desc.kind == AssetKind_Image || desc.kind == AssetKind_Sprite ||
+         desc.kind == AssetKind_Tilemap);
+
+  AssetFuture *f = (AssetFuture *)mem_alloc(sizeof(AssetFuture));
+  new (&f->refs) std::atomic<i32>(1);
+  new (&f->done) std::atomic<bool>(false);
+  f->ok = false;
+  f->desc = desc;
+  f->filepath = to_cstr(filepath);
+  f->asset = {};
+
+  // already loaded, nothing to wait for
+  u64 key = fnv1a(filepath);
+  if (asset_retain(key) && asset_read(key, &f->asset)) {
+    f->ok = true;
+    f->done.store(true);
+    return f;
+  }
+
+  f->refs.fetch_add(1);
+  jobs_run(load_async, f, nullptr);
+  return f;
+}
+
+bool asset_future_done(AssetFuture *f) { return f->done.load(); }
+
+bool asset_future_get(AssetFuture *f, Asset *out) {
+  if (!f->done.load() || !f->ok) {
+    return false;
+  }
+
+  // the asset could have been hot reloaded since
+  if (!asset_read(f->asset.hash, out)) {
+    return false;
+  }
+  return true;
+}
+
+void asset_future_release(AssetFuture *f) {
+  if (f->refs.fetch_sub(1) == 1) {
+    if (f->ok) {
+      asset_release(f->asset.hash);
+    }
+    mem_free(f->filepath.data);
+    mem_free(f);
+  }
+}
+
 bool asset_read(u64 key, Asset *out) {
   g_assets.rw_lock.shared_lock();
   defer(g_assets.rw_lock.shared_unlock());
@@ -256,9 +508,142 @@ void asset_write(Asset asset) {
   g_assets.rw_lock.unique_lock();
   defer(g_assets.rw_lock.unique_unlock());
 
+  const Asset *found = g_assets.table.get(asset.hash);
+  if (found != nullptr) {
+    asset.refs = found->refs;
+    asset.last_used = found->last_used;
+    count_bytes(found, false);
+  } else {
+    asset.refs = 0;
+    asset.last_used = g_assets.frame;
+  }
+
+  count_bytes(&asset, true);
   g_assets.table[asset.hash] = asset;
 }
 
+bool asset_retain(u64 key) {
+  g_assets.rw_lock.unique_lock();
+  defer(g_assets.rw_lock.unique_unlock());
+
+  Asset *found = g_assets.table.get(key);
+  if (found == nullptr) {
+    return false;
+  }
+
+  found->refs++;
+  return true;
+}
+
+void asset_release(u64 key, bool unload) {
+  g_assets.rw_lock.unique_lock();
+  defer(g_assets.rw_lock.unique_unlock());
+
+  Asset *found = g_assets.table.get(key);
+  if (found == nullptr) {
+    return;
+  }
+
+  if (found->refs > 0) {
+    found->refs--;
+  }
+
+  if (found->refs != 0) {
+    return;
+  }
+
+  found->last_used = g_assets.frame;
+  if (!unload) {
+    return;
+  }
+
+  // trashed by assets_collect, after the frame is flushed
+  g_assets.retired.push(*found);
+  count_bytes(found, false);
+  g_assets.table.unset(key);
+}
+
+void assets_set_budget(u64 bytes) {
+  g_assets.rw_lock.unique_lock();
+  defer(g_assets.rw_lock.unique_unlock());
+
+  g_assets.budget = bytes;
+}
+
+void assets_collect() {
+  PROFILE_FUNC();
+
+  Array<Asset> unload = {};
+  defer(unload.trash());
+
+  {
+    g_assets.rw_lock.unique_lock();
+    defer(g_assets.rw_lock.unique_unlock());
+
+    g_assets.frame++;
+
+    for (Asset &a : g_assets.retired) {
+      unload.push(a);
+    }
+    g_assets.retired.len = 0;
+
+    u64 budget = g_assets.budget;
+    while (budget != 0 && g_assets.cpu_bytes + g_assets.gpu_bytes > budget) {
+      Asset *lru = nullptr;
+      for (auto [k, v] : g_assets.table) {
+        bool kind = v->kind == AssetKind_Image ||
+                    v->kind == AssetKind_Sprite ||
+                    v->kind == AssetKind_Tilemap;
+
+        // assets used in the last frame might be about to get a reference
+        if (!kind || v->refs != 0 || v->last_used + 1 >= g_assets.frame) {
+          continue;
+        }
+
+        if (lru == nullptr || v->last_used < lru->last_used) {
+          lru = v;
+        }
+      }
+
+      if (lru == nullptr) {
+        break;
+      }
+
+      unload.push(*lru);
+      count_bytes(lru, false);
+      g_assets.table.unset(lru->hash);
+      g_assets.unloaded++;
+    }
+  }
+
+  for (Asset &a : unload) {
+    printf("unloaded: %s\n", a.name.data);
+    trash_asset(&a);
+  }
+}
+
+AssetStats assets_stats() {
+  g_assets.rw_lock.shared_lock();
+  defer(g_assets.rw_lock.shared_unlock());
+
+  AssetStats stats = {};
+  stats.count = g_assets.table.load;
+  stats.cpu_bytes = g_assets.cpu_bytes;
+  stats.gpu_bytes = g_assets.gpu_bytes;
+  stats.budget = g_assets.budget;
+  stats.unloaded = g_assets.unloaded;
+  return stats;
+}
+
+void assets_each(AssetProc fn, void *udata) {
+  g_assets.rw_lock.shared_lock();
+  defer(g_assets.rw_lock.shared_unlock());
+
+  for (auto [k, v] : g_assets.table) {
+    fn(v, udata);
+  }
+}
+
 Asset check_asset(lua_State *L, u64 key) {
   Asset asset = {};
   if (!asset_read(key, &asset)) {
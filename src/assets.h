@@ -22,6 +22,13 @@ struct Asset {
   u64 hash;
   u64 modtime;
   AssetKind kind;
+
+  // lua objects and others holding on to the asset. assets without any can
+  // be unloaded when over the memory budget.
+  i32 refs;
+  u64 last_used; // frame the asset was loaded or last released
+  u64 cpu_bytes;
+  u64 gpu_bytes;
   union {
     i32 lua_ref;
     Image image;
@@ -34,11 +41,49 @@ void assets_shutdown();
 void assets_start_hot_reload();
 void assets_perform_hot_reload_changes();
 
+// bytes of cpu and gpu memory that images, sprites and tilemaps can use
+// together, or 0 for no limit
+void assets_set_budget(u64 bytes);
+
+// unloads unreferenced assets, least recently used first, until assets fit
+// the budget. called once per frame on the main thread.
+void assets_collect();
+
+struct AssetStats {
+  u64 count;
+  u64 cpu_bytes;
+  u64 gpu_bytes;
+  u64 budget;
+  u64 unloaded; // assets unloaded to stay under budget so far
+};
+
+AssetStats assets_stats();
+
+// calls fn for every loaded asset, with the table locked for reading
+typedef void (*AssetProc)(const Asset *asset, void *udata);
+void assets_each(AssetProc fn, void *udata);
+
 bool asset_load_kind(AssetKind kind, String filepath, Asset *out);
 bool asset_load(AssetLoadData desc, String filepath, Asset *out);
 
+// loads on the job workers. poll asset_future_done, then take the result
+// with asset_future_get. only images, sprites and tilemaps can be loaded
+// this way.
+struct AssetFuture;
+AssetFuture *asset_load_async(AssetLoadData desc, String filepath);
+bool asset_future_done(AssetFuture *f);
+bool asset_future_get(AssetFuture *f, Asset *out); // false if the load failed
+void asset_future_release(AssetFuture *f);
+
 bool asset_read(u64 key, Asset *out);
-void asset_write(Asset asset);
+void asset_write(Asset asset); // keeps the reference count of the old asset
+
+// references to images, sprites and tilemaps. with unload, the asset is
+// unloaded as soon as the last reference is dropped, budget or not, and
+// freed by the next assets_collect, once draws queued before now are done.
+// retain returns false if the asset isn't loaded.
+bool asset_retain(u64 key);
+void asset_release(u64 key, bool unload = false);
 
 struct lua_State;
 Asset check_asset(lua_State *L, u64 key);
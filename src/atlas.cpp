@@ -7,12 +7,13 @@
 bool Atlas::load(String filepath, bool generate_mips) {
   PROFILE_FUNC();
 
-  String contents = {};
-  bool ok = vfs_read_entire_file(&contents, filepath);
+  FileView view = {};
+  bool ok = vfs_view_file(&view, filepath);
   if (!ok) {
     return false;
   }
-  defer(mem_free(contents.data));
+  defer(vfs_release_view(&view));
+  String contents = view.contents;
 
   Image img = {};
   HashMap<AtlasImage> by_name = {};
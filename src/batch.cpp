@@ -0,0 +1,283 @@
+#include "batch.h"
+#include "app.h"
+#include "assets.h"
+#include "profile.h"
+#include <math.h>
+
+void SpriteBatch::make(u64 cap) {
+  PROFILE_FUNC();
+
+  vertices = {};
+  vertices.resize(cap * 4);
+  len = 0;
+  capacity = cap;
+  dirty = false;
+  uploaded_frame = (u64)-1;
+  uploaded_len = 0;
+
+  Array<u32> indices = {};
+  defer(indices.trash());
+  indices.resize(cap * 6);
+  for (u64 i = 0; i < cap; i++) {
+    u32 v = (u32)(i * 4);
+    indices[i * 6 + 0] = v + 0;
+    indices[i * 6 + 1] = v + 1;
+    indices[i * 6 + 2] = v + 2;
+    indices[i * 6 + 3] = v + 0;
+    indices[i * 6 + 4] = v + 2;
+    indices[i * 6 + 5] = v + 3;
+  }
+
+  sg_buffer_desc vdesc = {};
+  vdesc.size = sizeof(SpriteVertex) * vertices.len;
+  vdesc.type = SG_BUFFERTYPE_VERTEXBUFFER;
+  vdesc.usage = SG_USAGE_STREAM;
+
+  sg_buffer_desc idesc = {};
+  idesc.type = SG_BUFFERTYPE_INDEXBUFFER;
+  idesc.data.ptr = indices.data;
+  idesc.data.size = sizeof(u32) * indices.len;
+
+  LockGuard lock{&g_app->gpu_mtx};
+  vbuf = sg_make_buffer(vdesc).id;
+  ibuf = sg_make_buffer(idesc).id;
+}
+
+void SpriteBatch::trash() {
+  {
+    // a draw of the batch can still be queued
+    LockGuard lock{&g_app->gpu_mtx};
+    renderer_retire_buffer(vbuf);
+    renderer_retire_buffer(ibuf);
+  }
+
+  mem_free(vertices.data);
+}
+
+void SpriteBatch::clear() {
+  len = 0;
+  dirty = true;
+}
+
+static void batch_write_quad(SpriteBatch *batch, SpriteVertex *v,
+                             DrawDescription *desc) {
+  float du = batch->u1 - batch->u0;
+  float dv = batch->v1 - batch->v0;
+
+  float u0 = batch->u0 + desc->u0 * du;
+  float v0 = batch->v0 + desc->v0 * dv;
+  float u1 = batch->u0 + desc->u1 * du;
+  float v1 = batch->v0 + desc->v1 * dv;
+
+  float x0 = -desc->ox;
+  float y0 = -desc->oy;
+  float x1 = (u1 - u0) * batch->img.width - desc->ox;
+  float y1 = (v1 - v0) * batch->img.height - desc->oy;
+
+  float c = cosf(desc->rotation);
+  float s = sinf(desc->rotation);
+
+  Color color = renderer_peek_color();
+  auto transform = [&](SpriteVertex *out, float x, float y, float u, float v) {
+    x *= desc->sx;
+    y *= desc->sy;
+    out->x = desc->x + x * c - y * s;
+    out->y = desc->y + x * s + y * c;
+    out->u = u;
+    out->v = v;
+    out->color = color;
+  };
+
+  transform(&v[0], x0, y0, u0, v0);
+  transform(&v[1], x0, y1, u0, v1);
+  transform(&v[2], x1, y1, u1, v1);
+  transform(&v[3], x1, y0, u1, v0);
+
+  batch->dirty = true;
+}
+
+bool SpriteBatch::add(DrawDescription *desc) {
+  if (len == capacity) {
+    return false;
+  }
+
+  batch_write_quad(this, &vertices[len * 4], desc);
+  len++;
+  return true;
+}
+
+bool SpriteBatch::set(u64 index, DrawDescription *desc) {
+  if (index >= len) {
+    return false;
+  }
+
+  batch_write_quad(this, &vertices[index * 4], desc);
+  return true;
+}
+
+void SpriteBatch::draw() {
+  PROFILE_FUNC();
+
+  // buffers can't be uploaded from a thread recording a draw list
+  if (renderer_recording()) {
+    return;
+  }
+
+  if (image != 0) {
+    Asset a = {};
+    if (asset_read(image, &a)) {
+      img = a.image.texture();
+      a.image.uvs(&u0, &v0, &u1, &v1);
+    }
+  }
+
+  // sokol allows one buffer update per frame. changes made after the first
+  // draw in a frame are uploaded on the next one.
+  if (dirty && len == 0) {
+    dirty = false;
+    uploaded_len = 0;
+  } else if (dirty && uploaded_frame != renderer_frame()) {
+    sg_range range = {};
+    range.ptr = vertices.data;
+    range.size = sizeof(SpriteVertex) * len * 4;
+
+    LockGuard lock{&g_app->gpu_mtx};
+    sg_update_buffer({vbuf}, range);
+
+    dirty = false;
+    uploaded_frame = renderer_frame();
+    uploaded_len = len;
+  }
+
+  if (uploaded_len == 0) {
+    return;
+  }
+
+  RendererDraw rd = {};
+  rd.pip = renderer_sprite_pipeline();
+  rd.bind.vertex_buffers[0] = {vbuf};
+  rd.bind.index_buffer = {ibuf};
+  rd.bind.fs.images[0] = {img.id};
+  rd.bind.fs.samplers[0] = renderer_sampler();
+  rd.base_element = 0;
+  rd.num_elements = (i32)(uploaded_len * 6);
+  renderer_push_draw(&rd);
+}
+
+void InstanceBuffer::make(u64 cap) {
+  PROFILE_FUNC();
+
+  instances = {};
+  instances.resize(cap);
+  len = 0;
+  capacity = cap;
+  dirty = false;
+  uploaded_frame = (u64)-1;
+  uploaded_len = 0;
+
+  sg_buffer_desc desc = {};
+  desc.size = sizeof(SpriteInstance) * cap;
+  desc.type = SG_BUFFERTYPE_VERTEXBUFFER;
+  desc.usage = SG_USAGE_STREAM;
+
+  LockGuard lock{&g_app->gpu_mtx};
+  vbuf = sg_make_buffer(desc).id;
+}
+
+void InstanceBuffer::trash() {
+  {
+    // a draw of the instances can still be queued
+    LockGuard lock{&g_app->gpu_mtx};
+    renderer_retire_buffer(vbuf);
+  }
+
+  mem_free(instances.data);
+}
+
+void InstanceBuffer::clear() {
+  len = 0;
+  dirty = true;
+}
+
+static void write_instance(SpriteInstance *inst, DrawDescription *desc) {
+  inst->x = desc->x;
+  inst->y = desc->y;
+  inst->sx = desc->sx;
+  inst->sy = desc->sy;
+  inst->ox = desc->ox;
+  inst->oy = desc->oy;
+  inst->rotation = desc->rotation;
+  inst->u0 = desc->u0;
+  inst->v0 = desc->v0;
+  inst->u1 = desc->u1;
+  inst->v1 = desc->v1;
+  inst->color = renderer_peek_color();
+}
+
+bool InstanceBuffer::add(DrawDescription *desc) {
+  if (len == capacity) {
+    return false;
+  }
+
+  write_instance(&instances[len], desc);
+  len++;
+  dirty = true;
+  return true;
+}
+
+bool InstanceBuffer::set(u64 index, DrawDescription *desc) {
+  if (index >= len) {
+    return false;
+  }
+
+  write_instance(&instances[index], desc);
+  dirty = true;
+  return true;
+}
+
+void InstanceBuffer::draw(Image img, float u0, float v0, float u1, float v1) {
+  PROFILE_FUNC();
+
+  if (renderer_recording()) {
+    return;
+  }
+
+  // same as SpriteBatch::draw, one upload per frame
+  if (dirty && len == 0) {
+    dirty = false;
+    uploaded_len = 0;
+  } else if (dirty && uploaded_frame != renderer_frame()) {
+    sg_range range = {};
+    range.ptr = instances.data;
+    range.size = sizeof(SpriteInstance) * len;
+
+    LockGuard lock{&g_app->gpu_mtx};
+    sg_update_buffer({vbuf}, range);
+
+    dirty = false;
+    uploaded_frame = renderer_frame();
+    uploaded_len = len;
+  }
+
+  if (uploaded_len == 0) {
+    return;
+  }
+
+  RendererDraw rd = {};
+  rd.pip = renderer_instance_pipeline();
+  renderer_bind_quad(&rd.bind);
+  rd.bind.vertex_buffers[1] = {vbuf};
+  rd.bind.fs.images[0] = {img.id};
+  rd.bind.fs.samplers[0] = renderer_sampler();
+  rd.base_element = 0;
+  rd.num_elements = 6;
+  rd.num_instances = (i32)uploaded_len;
+
+  rd.params[0] = u0;
+  rd.params[1] = v0;
+  rd.params[2] = u1 - u0;
+  rd.params[3] = v1 - v0;
+  rd.params[4] = (u1 - u0) * img.width;
+  rd.params[5] = (v1 - v0) * img.height;
+  renderer_push_draw(&rd);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "draw.h"
+#include "image.h"
+#include "slice.h"
+
+// a fixed capacity list of textured quads that lives in its own vertex
+// buffer, drawn with one draw call.
+struct SpriteBatch {
+  u64 image; // index into assets, 0 if img is used as is
+  Image img;
+
+  // region of img that quad texture coords are relative to
+  float u0;
+  float v0;
+  float u1;
+  float v1;
+
+  Slice<SpriteVertex> vertices;
+  u64 len;
+  u64 capacity;
+
+  u32 vbuf;
+  u32 ibuf;
+  bool dirty;
+  u64 uploaded_frame;
+  u64 uploaded_len;
+
+  void make(u64 cap);
+  void trash();
+  void clear();
+  bool add(DrawDescription *desc);
+  bool set(u64 index, DrawDescription *desc);
+  void draw();
+};
+
+// one instanced quad. 48 bytes, laid out to match the instance shader.
+struct SpriteInstance {
+  float x, y;
+  float sx, sy;
+  float ox, oy;
+  float rotation;
+  float u0, v0, u1, v1;
+  Color color;
+};
+
+// quads drawn with gpu instancing. unlike SpriteBatch, positions are
+// transformed in the vertex shader, and the texture is chosen when drawn.
+struct InstanceBuffer {
+  Slice<SpriteInstance> instances;
+  u64 len;
+  u64 capacity;
+
+  u32 vbuf;
+  bool dirty;
+  u64 uploaded_frame;
+  u64 uploaded_len;
+
+  void make(u64 cap);
+  void trash();
+  void clear();
+  bool add(DrawDescription *desc);
+  bool set(u64 index, DrawDescription *desc);
+
+  // u0, v0, u1, v1 is the region of img that instance uv coords are relative
+  // to, for atlas images
+  void draw(Image img, float u0, float v0, float u1, float v1);
+};
@@ -25,6 +25,10 @@ function spry._define_default_callbacks()
     --help, -h                  show this usage
     --version, -v               show spry version
     --console                   windows only. use console output
+    --pack [directory] [file]   write the files in directory to a .spk
+                                pack file, which can be run like a zip
+    --bench-startup [runs]      time each phase of startup over a number
+                                of runs, 10 by default
     [directory or zip archive]  run the game using the given directory
   ]]):format(spry.program_path())
 
@@ -649,6 +653,14 @@ function sleep(secs)
   return spry.dt()
 end
 
+function await(future)
+  while not future:ready() do
+    coroutine.yield()
+  end
+
+  return future:get()
+end
+
 unsafe_require = require
 
 function require(name)
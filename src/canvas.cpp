@@ -0,0 +1,76 @@
+#include "canvas.h"
+#include "app.h"
+#include "deps/sokol_gfx.h"
+#include "profile.h"
+
+bool Canvas::make(i32 width, i32 height) {
+  PROFILE_FUNC();
+
+  sg_image_desc desc = {};
+  desc.render_target = true;
+  desc.width = width;
+  desc.height = height;
+  desc.label = "canvas";
+
+  sg_image_desc depth_desc = desc;
+  depth_desc.pixel_format = SG_PIXELFORMAT_DEPTH_STENCIL;
+  depth_desc.label = "canvas-depth";
+
+  LockGuard lock{&g_app->gpu_mtx};
+
+  sg_image color = sg_make_image(desc);
+  if (sg_query_image_state(color) != SG_RESOURCESTATE_VALID) {
+    sg_destroy_image(color);
+    return false;
+  }
+
+  sg_image ds = sg_make_image(depth_desc);
+
+  sg_pass_desc pass_desc = {};
+  pass_desc.color_attachments[0].image = color;
+  pass_desc.depth_stencil_attachment.image = ds;
+  pass_desc.label = "canvas-pass";
+  sg_pass p = sg_make_pass(pass_desc);
+
+  if (sg_query_pass_state(p) != SG_RESOURCESTATE_VALID) {
+    sg_destroy_pass(p);
+    sg_destroy_image(ds);
+    sg_destroy_image(color);
+    return false;
+  }
+
+  Canvas c = {};
+  c.img.id = color.id;
+  c.img.width = width;
+  c.img.height = height;
+  c.depth = ds.id;
+  c.pass = p.id;
+  *this = c;
+  return true;
+}
+
+void Canvas::trash() {
+  // the canvas pass or a draw of img can still be queued
+  LockGuard lock{&g_app->gpu_mtx};
+  renderer_retire_pass(pass);
+  renderer_retire_image(depth);
+  renderer_retire_image(img.id);
+}
+
+bool Canvas::begin(const Color *clear) {
+  sg_pass_action action = {};
+  if (clear != nullptr) {
+    action.colors[0].load_action = SG_LOADACTION_CLEAR;
+    action.colors[0].clear_value.r = clear->r / 255.0f;
+    action.colors[0].clear_value.g = clear->g / 255.0f;
+    action.colors[0].clear_value.b = clear->b / 255.0f;
+    action.colors[0].clear_value.a = clear->a / 255.0f;
+  } else {
+    action.colors[0].load_action = SG_LOADACTION_LOAD;
+  }
+  action.depth.load_action = SG_LOADACTION_CLEAR;
+
+  return renderer_begin_canvas(pass, img.width, img.height, action);
+}
+
+void Canvas::finish() { renderer_end_canvas(); }
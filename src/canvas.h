@@ -0,0 +1,20 @@
+#pragma once
+
+#include "draw.h"
+#include "image.h"
+
+// an image that can be drawn into. draws between begin and finish go to the
+// canvas instead of the screen.
+struct Canvas {
+  Image img;
+  u32 depth;
+  u32 pass;
+
+  bool make(i32 width, i32 height);
+  void trash();
+
+  // clear is the color to fill the canvas with, or nullptr to draw on top of
+  // what's already there
+  bool begin(const Color *clear);
+  void finish();
+};
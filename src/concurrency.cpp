@@ -1,10 +1,12 @@
 #include "concurrency.h"
 #include "api.h"
+#include "assets.h"
 #include "deps/luaalloc.h"
 #include "hash_map.h"
 #include "luax.h"
 #include "prelude.h"
 #include "profile.h"
+#include "script_cache.h"
 #include "sync.h"
 #include <new>
 
@@ -49,8 +51,7 @@ static void lua_thread_proc(void *udata) {
 
   {
     PROFILE_BLOCK("load chunk");
-    if (luaL_loadbuffer(L, contents.data, contents.len, lt->name.data) !=
-        LUA_OK) {
+    if (script_cache_load(L, contents, lt->name.data) != LUA_OK) {
       String err = luax_check_string(L, -1);
       fprintf(stderr, "%s\n", err.data);
 
@@ -144,6 +145,13 @@ void LuaVariant::make(lua_State *L, i32 arg) {
     udata.ptr = *(void **)lua_touserdata(L, arg);
     udata.tname = to_cstr(tname);
 
+    // the variant holds a reference while it waits in a channel, so the
+    // asset can't be collected before it's received
+    if (udata.tname == "mt_image" || udata.tname == "mt_tilemap") {
+      asset_retain((u64)udata.ptr);
+    }
+    lua_shared_udata_retain(udata.tname, udata.ptr);
+
     break;
   }
   default: break;
@@ -162,9 +170,15 @@ void LuaVariant::trash() {
       e.value.trash();
     }
     mem_free(table.data);
+    break;
   }
   case LUA_TUSERDATA: {
+    if (udata.tname == "mt_image" || udata.tname == "mt_tilemap") {
+      asset_release((u64)udata.ptr);
+    }
+    lua_shared_udata_release(udata.tname, udata.ptr);
     mem_free(udata.tname.data);
+    break;
   }
   default: break;
   }
@@ -185,6 +199,12 @@ void LuaVariant::push(lua_State *L) {
     break;
   }
   case LUA_TUSERDATA: {
+    // the copy holds its own reference to the asset, dropped by its __gc
+    if (udata.tname == "mt_image" || udata.tname == "mt_tilemap") {
+      asset_retain((u64)udata.ptr);
+    }
+    lua_shared_udata_retain(udata.tname, udata.ptr);
+
     luax_ptr_userdata(L, udata.ptr, udata.tname.data);
     break;
   }
@@ -1,54 +1,1147 @@
 #include "draw.h"
 #include "algebra.h"
+#include "app.h"
 #include "deps/sokol_gfx.h"
 #include "deps/sokol_gl.h"
+#include "deps/sokol_log.h"
 #include "font.h"
 #include "prelude.h"
 #include "profile.h"
-#include "scanner.h"
+#include "shaders.h"
 #include "strings.h"
+#include "text.h"
+#include <float.h>
 #include <math.h>
 
 extern "C" {
 #include <lauxlib.h>
 }
 
-struct Renderer2D {
-  Matrix4 matrices[32];
-  u64 matrices_len;
+// a deferred sokol_gl draw. key sorts by layer, then texture, then shader
+// and sampler. seq keeps draws with the same key in submission order.
+struct QueueCmd {
+  u64 key;
+  u32 seq;
+  u32 image;
+  u32 sampler;
+  RendererPrim prim;
+  RendererShader shader;
+  DrawVertex *vertices;
+  u32 len;
+  u32 cap;
+};
+
+struct RendererDrawCmd {
+  RendererDraw draw;
+  i32 layer;
+  float vs_params[28]; // mvp, color, params
+};
+
+// a range of layers drawn into one sokol_gfx pass. pass is SG_INVALID_ID for
+// the screen.
+struct RendererPass {
+  u32 pass;
+  sg_pass_action action;
+  i32 first_layer;
+  i32 last_layer;
+};
+
+enum RetiredKind : i32 {
+  RetiredKind_Image,
+  RetiredKind_Buffer,
+  RetiredKind_Pass,
+};
 
+struct RetiredGpu {
+  RetiredKind kind;
+  u32 id;
+};
+
+struct Renderer2D {
+  DrawState state;
   float clear_color[4];
-  Color draw_colors[32];
-  u64 draw_colors_len;
 
-  u32 sampler;
+  // size and orientation of the current render target
+  Matrix4 projection;
+  float width;
+  float height;
+  bool flip_y;
+
+  float screen_width;
+  float screen_height;
+  Array<RendererPass> passes;
+  bool in_canvas;
+  sgl_pipeline sgl_default_pipeline;
+  sg_shader sgl_sdf_shader;
+  sgl_pipeline sgl_sdf_pipeline;
+  sg_shader sprite_shader;
+  sg_pipeline sprite_pipeline;
+  sg_shader sdf_shader;
+  sg_pipeline sdf_pipeline;
+  sg_shader instance_shader;
+  sg_pipeline instance_pipeline;
+  sg_buffer quad_vbuf;
+  sg_buffer quad_ibuf;
+  sg_sampler default_sampler;
+  sg_sampler linear_sampler;
+
+  // sokol_gl layer for everything drawn after the last custom draw
+  i32 layer;
+  Array<RendererDrawCmd> draws;
+  u64 frame;
+  Array<RetiredGpu> retired; // destroyed once the frame is flushed
+
+  // primitive between renderer_begin_prim and renderer_end_prim
+  RendererPrim prim;
+  RendererShader prim_shader;
+  Color prim_color;
+  u32 prim_image;
+  u32 prim_sampler;
+  bool in_prim;
+
+  bool deferred;
+  i32 sort_layer;
+  Arena queue_arena;
+  Array<QueueCmd> queue;
+
+  // sokol_gl contexts. the default context is filled first, then overflow
+  // contexts are made when needed and kept for later frames
+  Array<sgl_context> overflow_contexts;
+  u64 overflow_used;
+  i32 sgl_max_vertices = 1 << 16;
+  i32 sgl_max_commands = 1 << 14;
+  i32 sgl_vertices; // used in the current context
+  i32 sgl_commands;
+  bool sgl_dropping; // every context is full, skip the current primitive
+  bool flushing;     // in renderer_flush, so the gpu lock is already held
+
+  // open sokol_gl primitive, so it can be continued in another context
+  RendererPrim sgl_prim;
+  u32 sgl_image;
+  u32 sgl_sampler;
+  RendererShader sgl_shader;
+  u32 sgl_prim_len;
+  DrawVertex sgl_last;
+
+  bool scissor;
+  float scissor_rect[4];
+
+  u64 sgl_vertices_peak;
+  u64 sgl_commands_peak;
+
+  RendererStats stats;
+  RendererStats last_stats;
 };
 
 static Renderer2D g_renderer;
 
+// list that draws on this thread are recorded into, if any
+static thread_local DrawList *t_recording;
+
+static DrawState *draw_state() {
+  if (t_recording != nullptr) {
+    return &t_recording->state;
+  }
+  return &g_renderer.state;
+}
+
+static void blend_alpha(sg_color_target_state *color) {
+  color->blend.enabled = true;
+  color->blend.src_factor_rgb = SG_BLENDFACTOR_SRC_ALPHA;
+  color->blend.dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
+}
+
+struct ShaderSource {
+  const char *glsl330;
+  const char *glsl300es;
+  const char *hlsl4;
+};
+
+static const char *shader_source(ShaderSource src) {
+  switch (sg_query_backend()) {
+  case SG_BACKEND_GLCORE33: return src.glsl330;
+  case SG_BACKEND_GLES3: return src.glsl300es;
+  case SG_BACKEND_D3D11: return src.hlsl4;
+  default: return nullptr;
+  }
+}
+
+// vertex attribute names, ending with nullptr. hlsl semantics are
+// TEXCOORD0, TEXCOORD1, ... in the same order.
+static const char *g_sprite_attrs[] = {"position", "texcoord0", "color0",
+                                       nullptr};
+static const char *g_sgl_attrs[] = {"position", "texcoord0", "color0",
+                                    "psize", nullptr};
+static const char *g_instance_attrs[] = {
+    "corner", "inst_xform", "inst_origin", "inst_uv", "inst_color", nullptr,
+};
+
+// vs_params is the only vertex uniform, and the fragment shader samples one
+// texture.
+static sg_shader make_shader(const char *label, ShaderSource vs,
+                             ShaderSource fs, i32 vs_params_len,
+                             const char **attrs) {
+  sg_shader_desc desc = {};
+  desc.label = label;
+  for (i32 i = 0; attrs[i] != nullptr; i++) {
+    desc.attrs[i].name = attrs[i];
+    desc.attrs[i].sem_name = "TEXCOORD";
+    desc.attrs[i].sem_index = i;
+  }
+
+  sg_shader_uniform_block_desc *ub = &desc.vs.uniform_blocks[0];
+  ub->size = sizeof(float) * 4 * vs_params_len;
+  ub->uniforms[0].name = "vs_params";
+  ub->uniforms[0].type = SG_UNIFORMTYPE_FLOAT4;
+  ub->uniforms[0].array_count = vs_params_len;
+
+  desc.fs.images[0].used = true;
+  desc.fs.images[0].image_type = SG_IMAGETYPE_2D;
+  desc.fs.images[0].sample_type = SG_IMAGESAMPLETYPE_FLOAT;
+  desc.fs.samplers[0].used = true;
+  desc.fs.samplers[0].sampler_type = SG_SAMPLERTYPE_FILTERING;
+  desc.fs.image_sampler_pairs[0].used = true;
+  desc.fs.image_sampler_pairs[0].image_slot = 0;
+  desc.fs.image_sampler_pairs[0].sampler_slot = 0;
+  desc.fs.image_sampler_pairs[0].glsl_name = "tex_smp";
+
+  desc.vs.source = shader_source(vs);
+  desc.fs.source = shader_source(fs);
+
+  return sg_make_shader(desc);
+}
+
+static sg_pipeline make_sprite_pipeline(const char *label, sg_shader shader) {
+  sg_pipeline_desc desc = {};
+  desc.label = label;
+  desc.shader = shader;
+  desc.layout.attrs[0].format = SG_VERTEXFORMAT_FLOAT2;
+  desc.layout.attrs[1].format = SG_VERTEXFORMAT_FLOAT2;
+  desc.layout.attrs[2].format = SG_VERTEXFORMAT_UBYTE4N;
+  desc.index_type = SG_INDEXTYPE_UINT32;
+  desc.depth.write_enabled = true;
+  blend_alpha(&desc.colors[0]);
+  return sg_make_pipeline(desc);
+}
+
+static sg_pipeline make_instance_pipeline(sg_shader shader) {
+  sg_pipeline_desc desc = {};
+  desc.label = "instance-pipeline";
+  desc.shader = shader;
+  desc.layout.buffers[1].step_func = SG_VERTEXSTEP_PER_INSTANCE;
+  desc.layout.attrs[0].format = SG_VERTEXFORMAT_FLOAT2;
+  for (i32 i = 1; i <= 4; i++) {
+    desc.layout.attrs[i].buffer_index = 1;
+  }
+  desc.layout.attrs[1].format = SG_VERTEXFORMAT_FLOAT4;
+  desc.layout.attrs[2].format = SG_VERTEXFORMAT_FLOAT3;
+  desc.layout.attrs[3].format = SG_VERTEXFORMAT_FLOAT4;
+  desc.layout.attrs[4].format = SG_VERTEXFORMAT_UBYTE4N;
+  desc.index_type = SG_INDEXTYPE_UINT16;
+  desc.depth.write_enabled = true;
+  blend_alpha(&desc.colors[0]);
+  return sg_make_pipeline(desc);
+}
+
+void renderer_set_sgl_budget(i32 vertices, i32 commands) {
+  g_renderer.sgl_max_vertices = vertices;
+  g_renderer.sgl_max_commands = commands;
+}
+
+void renderer_setup() {
+  PROFILE_FUNC();
+
+  sgl_desc_t sgl = {};
+  sgl.logger.func = slog_func;
+  sgl.max_vertices = g_renderer.sgl_max_vertices;
+  sgl.max_commands = g_renderer.sgl_max_commands;
+  sgl.context_pool_size = RENDERER_MAX_SGL_CONTEXTS;
+  sgl_setup(sgl);
+
+  ShaderSource sprite_vs = {
+      g_sprite_vs_glsl330,
+      g_sprite_vs_glsl300es,
+      g_sprite_vs_hlsl4,
+  };
+  ShaderSource sprite_fs = {
+      g_sprite_fs_glsl330,
+      g_sprite_fs_glsl300es,
+      g_sprite_fs_hlsl4,
+  };
+  ShaderSource sgl_vs = {
+      g_sgl_vs_glsl330,
+      g_sgl_vs_glsl300es,
+      g_sgl_vs_hlsl4,
+  };
+  ShaderSource sdf_fs = {
+      g_sdf_fs_glsl330,
+      g_sdf_fs_glsl300es,
+      g_sdf_fs_hlsl4,
+  };
+  ShaderSource instance_vs = {
+      g_instance_vs_glsl330,
+      g_instance_vs_glsl300es,
+      g_instance_vs_hlsl4,
+  };
+
+  sg_pipeline_desc sgl_desc = {};
+  sgl_desc.depth.write_enabled = true;
+  blend_alpha(&sgl_desc.colors[0]);
+  g_renderer.sgl_default_pipeline = sgl_make_pipeline(sgl_desc);
+
+  g_renderer.sgl_sdf_shader =
+      make_shader("sgl-sdf-shader", sgl_vs, sdf_fs, 8, g_sgl_attrs);
+  sgl_desc.shader = g_renderer.sgl_sdf_shader;
+  g_renderer.sgl_sdf_pipeline = sgl_make_pipeline(sgl_desc);
+
+  i32 vs_params_len = sizeof(RendererDrawCmd::vs_params) / (sizeof(float) * 4);
+
+  g_renderer.sprite_shader = make_shader("sprite-shader", sprite_vs, sprite_fs,
+                                         vs_params_len, g_sprite_attrs);
+  g_renderer.sprite_pipeline =
+      make_sprite_pipeline("sprite-pipeline", g_renderer.sprite_shader);
+
+  g_renderer.sdf_shader = make_shader("sdf-shader", sprite_vs, sdf_fs,
+                                      vs_params_len, g_sprite_attrs);
+  g_renderer.sdf_pipeline =
+      make_sprite_pipeline("sdf-pipeline", g_renderer.sdf_shader);
+
+  g_renderer.instance_shader =
+      make_shader("instance-shader", instance_vs, sprite_fs, vs_params_len,
+                  g_instance_attrs);
+  g_renderer.instance_pipeline =
+      make_instance_pipeline(g_renderer.instance_shader);
+
+  float corners[] = {0, 0, 0, 1, 1, 1, 1, 0};
+  u16 indices[] = {0, 1, 2, 0, 2, 3};
+
+  sg_buffer_desc vdesc = {};
+  vdesc.type = SG_BUFFERTYPE_VERTEXBUFFER;
+  vdesc.data = SG_RANGE(corners);
+  g_renderer.quad_vbuf = sg_make_buffer(vdesc);
+
+  sg_buffer_desc idesc = {};
+  idesc.type = SG_BUFFERTYPE_INDEXBUFFER;
+  idesc.data = SG_RANGE(indices);
+  g_renderer.quad_ibuf = sg_make_buffer(idesc);
+
+  sg_sampler_desc smp = {};
+  smp.min_filter = SG_FILTER_NEAREST;
+  smp.mag_filter = SG_FILTER_NEAREST;
+  g_renderer.default_sampler = sg_make_sampler(smp);
+
+  smp.min_filter = SG_FILTER_LINEAR;
+  smp.mag_filter = SG_FILTER_LINEAR;
+  smp.wrap_u = SG_WRAP_CLAMP_TO_EDGE;
+  smp.wrap_v = SG_WRAP_CLAMP_TO_EDGE;
+  g_renderer.linear_sampler = sg_make_sampler(smp);
+}
+
+static void destroy_retired() {
+  for (RetiredGpu r : g_renderer.retired) {
+    switch (r.kind) {
+    case RetiredKind_Image: sg_destroy_image({r.id}); break;
+    case RetiredKind_Buffer: sg_destroy_buffer({r.id}); break;
+    case RetiredKind_Pass: sg_destroy_pass({r.id}); break;
+    }
+  }
+  g_renderer.retired.len = 0;
+}
+
+void renderer_retire_image(u32 id) {
+  g_renderer.retired.push({RetiredKind_Image, id});
+}
+
+void renderer_retire_buffer(u32 id) {
+  g_renderer.retired.push({RetiredKind_Buffer, id});
+}
+
+void renderer_retire_pass(u32 id) {
+  g_renderer.retired.push({RetiredKind_Pass, id});
+}
+
+void renderer_shutdown() {
+  destroy_retired();
+  g_renderer.retired.trash();
+  g_renderer.queue.trash();
+  g_renderer.queue_arena.trash();
+  g_renderer.draws.trash();
+  g_renderer.passes.trash();
+  sg_destroy_sampler(g_renderer.linear_sampler);
+  sg_destroy_sampler(g_renderer.default_sampler);
+  sg_destroy_buffer(g_renderer.quad_ibuf);
+  sg_destroy_buffer(g_renderer.quad_vbuf);
+  sg_destroy_pipeline(g_renderer.instance_pipeline);
+  sg_destroy_shader(g_renderer.instance_shader);
+  sg_destroy_pipeline(g_renderer.sdf_pipeline);
+  sg_destroy_shader(g_renderer.sdf_shader);
+  sg_destroy_pipeline(g_renderer.sprite_pipeline);
+  sg_destroy_shader(g_renderer.sprite_shader);
+  sgl_destroy_pipeline(g_renderer.sgl_sdf_pipeline);
+  sg_destroy_shader(g_renderer.sgl_sdf_shader);
+  sgl_destroy_pipeline(g_renderer.sgl_default_pipeline);
+  for (sgl_context ctx : g_renderer.overflow_contexts) {
+    sgl_destroy_context(ctx);
+  }
+  g_renderer.overflow_contexts.trash();
+  sgl_shutdown();
+}
+
+static void set_view(float width, float height, bool flip_y) {
+  g_renderer.width = width;
+  g_renderer.height = height;
+  g_renderer.flip_y = flip_y;
+
+  float sy = flip_y ? 1.0f : -1.0f;
+
+  Matrix4 ortho = {};
+  ortho.cols[0][0] = 2.0f / width;
+  ortho.cols[1][1] = sy * 2.0f / height;
+  ortho.cols[2][2] = -1.0f;
+  ortho.cols[3][0] = -1.0f;
+  ortho.cols[3][1] = -sy;
+  ortho.cols[3][3] = 1.0f;
+  g_renderer.projection = ortho;
+}
+
+// layer, viewport and scissor of the current render target
+static void apply_sgl_view() {
+  float w = g_renderer.width;
+  float h = g_renderer.height;
+
+  sgl_layer(g_renderer.layer);
+  sgl_viewport(0, 0, (i32)w, (i32)h, true);
+  if (g_renderer.flip_y) {
+    sgl_ortho(0, w, 0, h, -1, 1);
+  } else {
+    sgl_ortho(0, w, h, 0, -1, 1);
+  }
+  g_renderer.sgl_commands++;
+
+  if (g_renderer.scissor) {
+    float *r = g_renderer.scissor_rect;
+    sgl_scissor_rectf(r[0], r[1], r[2], r[3], !g_renderer.flip_y);
+    g_renderer.sgl_commands++;
+  }
+}
+
+// put the current sokol_gl context in the state a frame starts with, plus
+// anything set since then that later draws depend on
+static void setup_sgl_context() {
+  sgl_defaults();
+  sgl_load_pipeline(g_renderer.sgl_default_pipeline);
+  apply_sgl_view();
+}
+
+static void add_sgl_usage() {
+  g_renderer.stats.sgl_vertices += g_renderer.sgl_vertices;
+  g_renderer.stats.sgl_commands += g_renderer.sgl_commands;
+  g_renderer.sgl_vertices = 0;
+  g_renderer.sgl_commands = 0;
+}
+
+// switch to an overflow context, making one if every context made so far is
+// in use. returns false when the context pool is exhausted.
+static bool next_sgl_context() {
+  if (g_renderer.overflow_used == g_renderer.overflow_contexts.len) {
+    if (g_renderer.overflow_used + 1 >= RENDERER_MAX_SGL_CONTEXTS) {
+      return false;
+    }
+
+    sgl_context_desc_t desc = {};
+    desc.max_vertices = g_renderer.sgl_max_vertices;
+    desc.max_commands = g_renderer.sgl_max_commands;
+
+    // a flush overflows with the gpu lock held, and the lock isn't
+    // recursive
+    sgl_context ctx = {};
+    if (g_renderer.flushing) {
+      ctx = sgl_make_context(&desc);
+    } else {
+      LockGuard lock{&g_app->gpu_mtx};
+      ctx = sgl_make_context(&desc);
+    }
+    if (ctx.id == SG_INVALID_ID) {
+      return false;
+    }
+
+    g_renderer.overflow_contexts.push(ctx);
+    printf("made sokol_gl overflow context %llu\n",
+           (unsigned long long)g_renderer.overflow_contexts.len);
+  }
+
+  add_sgl_usage();
+  sgl_set_context(g_renderer.overflow_contexts[g_renderer.overflow_used++]);
+  setup_sgl_context();
+  return true;
+}
+
+// make sure the current context has room, moving to the next one if not
+static bool sgl_reserve(i32 vertices, i32 commands) {
+  bool fits =
+      g_renderer.sgl_vertices + vertices <= g_renderer.sgl_max_vertices &&
+      g_renderer.sgl_commands + commands <= g_renderer.sgl_max_commands;
+  if (fits) {
+    return true;
+  }
+
+  return next_sgl_context() &&
+         g_renderer.sgl_vertices + vertices <= g_renderer.sgl_max_vertices &&
+         g_renderer.sgl_commands + commands <= g_renderer.sgl_max_commands;
+}
+
+bool renderer_sgl_reserve(i32 vertices, i32 commands) {
+  bool ok = sgl_reserve(vertices, commands);
+  if (ok) {
+    g_renderer.sgl_vertices += vertices;
+    g_renderer.sgl_commands += commands;
+  } else {
+    g_renderer.stats.sgl_dropped += vertices;
+  }
+  return ok;
+}
+
+void renderer_scissor_rect(float x, float y, float w, float h) {
+  renderer_flush_queue();
+
+  g_renderer.scissor = true;
+  g_renderer.scissor_rect[0] = x;
+  g_renderer.scissor_rect[1] = y;
+  g_renderer.scissor_rect[2] = w;
+  g_renderer.scissor_rect[3] = h;
+
+  if (renderer_sgl_reserve(0, 1)) {
+    sgl_scissor_rectf(x, y, w, h, !g_renderer.flip_y);
+  }
+}
+
+void renderer_begin(i32 width, i32 height) {
+  set_view((float)width, (float)height, false);
+  g_renderer.screen_width = (float)width;
+  g_renderer.screen_height = (float)height;
+  g_renderer.scissor = false;
+  g_renderer.overflow_used = 0;
+  g_renderer.sgl_vertices = 0;
+  g_renderer.sgl_commands = 0;
+
+  g_renderer.passes.len = 0;
+  g_renderer.passes.push({SG_INVALID_ID, {}, 0, 0});
+
+  sgl_set_context(SGL_DEFAULT_CONTEXT);
+  setup_sgl_context();
+}
+
+// end the current pass at the current layer, and start a new one in the
+// next layer
+static void next_pass(u32 pass, sg_pass_action action, float width,
+                      float height, bool flip_y) {
+  renderer_flush_queue();
+
+  RendererPass *last = &g_renderer.passes[g_renderer.passes.len - 1];
+  last->last_layer = g_renderer.layer;
+
+  g_renderer.layer++;
+  g_renderer.passes.push({pass, action, g_renderer.layer, g_renderer.layer});
+
+  g_renderer.scissor = false;
+  set_view(width, height, flip_y);
+
+  // a context switch applies the view on its own
+  u64 used = g_renderer.overflow_used;
+  if (sgl_reserve(0, 2) && used == g_renderer.overflow_used) {
+    apply_sgl_view();
+  }
+}
+
+bool renderer_begin_canvas(u32 pass, i32 width, i32 height,
+                           sg_pass_action action) {
+  if (g_renderer.in_canvas) {
+    return false;
+  }
+
+  bool ok = renderer_push_matrix();
+  if (!ok) {
+    return false;
+  }
+
+  Matrix4 identity = {};
+  for (i32 i = 0; i < 4; i++) {
+    identity.cols[i][i] = 1.0f;
+  }
+  renderer_set_top_matrix(identity);
+
+  // textures are upside down on backends with a bottom left origin, so
+  // render flipped to make the canvas read like any other image
+  bool flip_y = !sg_query_features().origin_top_left;
+  next_pass(pass, action, (float)width, (float)height, flip_y);
+
+  g_renderer.in_canvas = true;
+  return true;
+}
+
+void renderer_end_canvas() {
+  if (!g_renderer.in_canvas) {
+    return;
+  }
+
+  next_pass(SG_INVALID_ID, {}, g_renderer.screen_width,
+            g_renderer.screen_height, false);
+  renderer_pop_matrix();
+
+  g_renderer.in_canvas = false;
+}
+
+static void draw_layers(i32 first, i32 last) {
+  u64 next = 0;
+  while (next < g_renderer.draws.len &&
+         g_renderer.draws[next].layer < first) {
+    next++;
+  }
+
+  for (i32 layer = first; layer <= last; layer++) {
+    sgl_context_draw_layer(SGL_DEFAULT_CONTEXT, layer);
+    for (u64 i = 0; i < g_renderer.overflow_used; i++) {
+      sgl_context_draw_layer(g_renderer.overflow_contexts[i], layer);
+    }
+
+    for (; next < g_renderer.draws.len; next++) {
+      RendererDrawCmd *cmd = &g_renderer.draws[next];
+      if (cmd->layer != layer) {
+        break;
+      }
+
+      sg_apply_pipeline(cmd->draw.pip);
+      sg_apply_bindings(cmd->draw.bind);
+      sg_apply_uniforms(SG_SHADERSTAGE_VS, 0, SG_RANGE(cmd->vs_params));
+      sg_draw(cmd->draw.base_element, cmd->draw.num_elements,
+              cmd->draw.num_instances);
+    }
+  }
+}
+
+void renderer_flush(const sg_pass_action *screen) {
+  PROFILE_FUNC();
+
+  g_renderer.flushing = true;
+  defer(g_renderer.flushing = false);
+
+  renderer_end_canvas();
+  renderer_flush_queue();
+  font_upload_atlases();
+  image_pack_upload();
+
+  RendererPass *last = &g_renderer.passes[g_renderer.passes.len - 1];
+  last->last_layer = g_renderer.layer;
+
+  // canvases are rendered first, so the screen can use them
+  for (RendererPass &p : g_renderer.passes) {
+    if (p.pass != SG_INVALID_ID) {
+      sg_begin_pass({p.pass}, p.action);
+      draw_layers(p.first_layer, p.last_layer);
+      sg_end_pass();
+    }
+  }
+
+  sg_begin_default_pass(screen, (i32)g_renderer.screen_width,
+                        (i32)g_renderer.screen_height);
+  for (RendererPass &p : g_renderer.passes) {
+    if (p.pass == SG_INVALID_ID) {
+      draw_layers(p.first_layer, p.last_layer);
+    }
+  }
+  sg_end_pass();
+
+  g_renderer.draws.len = 0;
+  g_renderer.layer = 0;
+  g_renderer.frame++;
+  destroy_retired();
+
+  add_sgl_usage();
+  RendererStats *stats = &g_renderer.stats;
+  stats->sgl_contexts = g_renderer.overflow_used + 1;
+  if (stats->sgl_vertices > g_renderer.sgl_vertices_peak) {
+    g_renderer.sgl_vertices_peak = stats->sgl_vertices;
+  }
+  if (stats->sgl_commands > g_renderer.sgl_commands_peak) {
+    g_renderer.sgl_commands_peak = stats->sgl_commands;
+  }
+  stats->sgl_vertices_peak = g_renderer.sgl_vertices_peak;
+  stats->sgl_commands_peak = g_renderer.sgl_commands_peak;
+
+  g_renderer.last_stats = g_renderer.stats;
+  g_renderer.stats = {};
+  g_renderer.prim_image = SG_INVALID_ID;
+  g_renderer.prim_sampler = SG_INVALID_ID;
+}
+
+u64 renderer_frame() { return g_renderer.frame; }
+
+sg_pipeline renderer_sprite_pipeline() { return g_renderer.sprite_pipeline; }
+
+sg_pipeline renderer_sdf_pipeline() { return g_renderer.sdf_pipeline; }
+
+sg_pipeline renderer_instance_pipeline() {
+  return g_renderer.instance_pipeline;
+}
+
+void renderer_bind_quad(sg_bindings *bind) {
+  bind->vertex_buffers[0] = g_renderer.quad_vbuf;
+  bind->index_buffer = g_renderer.quad_ibuf;
+}
+
+sg_sampler renderer_linear_sampler() { return g_renderer.linear_sampler; }
+
+sg_sampler renderer_sampler() {
+  if (g_renderer.state.sampler == SG_INVALID_ID) {
+    return g_renderer.default_sampler;
+  }
+  return {g_renderer.state.sampler};
+}
+
+i32 renderer_sgl_error() {
+  sgl_error_t err = sgl_context_error(SGL_DEFAULT_CONTEXT);
+  for (u64 i = 0; i < g_renderer.overflow_used && err == SGL_NO_ERROR; i++) {
+    err = sgl_context_error(g_renderer.overflow_contexts[i]);
+  }
+  return err;
+}
+
+void renderer_push_draw(RendererDraw *draw) {
+  if (t_recording != nullptr) {
+    return;
+  }
+
+  renderer_flush_queue();
+
+  RendererDrawCmd cmd = {};
+  cmd.draw = *draw;
+  cmd.layer = g_renderer.layer;
+
+  if (cmd.draw.num_instances == 0) {
+    cmd.draw.num_instances = 1;
+  }
+
+  Matrix4 mvp = mat4_mul_mat4(g_renderer.projection, renderer_peek_matrix());
+  memcpy(cmd.vs_params, mvp.cols, sizeof(mvp.cols));
+
+  Color c = renderer_peek_color();
+  cmd.vs_params[16] = c.r / 255.0f;
+  cmd.vs_params[17] = c.g / 255.0f;
+  cmd.vs_params[18] = c.b / 255.0f;
+  cmd.vs_params[19] = c.a / 255.0f;
+
+  memcpy(&cmd.vs_params[20], draw->params, sizeof(draw->params));
+
+  g_renderer.draws.push(cmd);
+
+  // sokol_gl commands issued after this draw go in the next layer, so they
+  // are drawn on top of it
+  g_renderer.layer++;
+  sgl_layer(g_renderer.layer);
+}
+
+static void count_state_change(u32 *image, u32 *sampler, u32 next_image,
+                               u32 next_sampler, u64 *changes) {
+  if (*image != next_image || *sampler != next_sampler) {
+    *image = next_image;
+    *sampler = next_sampler;
+    (*changes)++;
+  }
+}
+
+// vertices that make up one line or quad
+static i32 prim_group_size(RendererPrim prim) {
+  switch (prim) {
+  case RendererPrim_Quads: return 4;
+  case RendererPrim_Lines: return 2;
+  case RendererPrim_LineStrip: return 1;
+  }
+  return 1;
+}
+
+static void sgl_begin_state() {
+  if (g_renderer.sgl_shader == RendererShader_SDF) {
+    sgl_load_pipeline(g_renderer.sgl_sdf_pipeline);
+  }
+
+  if (g_renderer.sgl_image == SG_INVALID_ID) {
+    sgl_disable_texture();
+  } else {
+    sgl_enable_texture();
+    sgl_texture({g_renderer.sgl_image}, {g_renderer.sgl_sampler});
+  }
+
+  switch (g_renderer.sgl_prim) {
+  case RendererPrim_Quads: sgl_begin_quads(); break;
+  case RendererPrim_Lines: sgl_begin_lines(); break;
+  case RendererPrim_LineStrip: sgl_begin_line_strip(); break;
+  }
+
+  g_renderer.sgl_commands++;
+  g_renderer.sgl_prim_len = 0;
+}
+
+static void begin_sgl_prim(RendererPrim prim, u32 image, u32 sampler,
+                           RendererShader shader) {
+  g_renderer.sgl_prim = prim;
+  g_renderer.sgl_image = image;
+  g_renderer.sgl_sampler = sampler;
+  g_renderer.sgl_shader = shader;
+
+  // line strips need two vertices, so make room for at least that
+  i32 group = prim == RendererPrim_LineStrip ? 2 : prim_group_size(prim);
+  g_renderer.sgl_dropping = !sgl_reserve(group, 1);
+  if (g_renderer.sgl_dropping) {
+    return;
+  }
+
+  sgl_begin_state();
+}
+
+static void end_sgl_prim() {
+  if (g_renderer.sgl_dropping) {
+    g_renderer.sgl_dropping = false;
+    return;
+  }
+
+  sgl_end();
+
+  if (g_renderer.sgl_shader == RendererShader_SDF) {
+    sgl_load_pipeline(g_renderer.sgl_default_pipeline);
+  }
+}
+
+static void sgl_vertex(DrawVertex v) {
+  if (g_renderer.sgl_dropping) {
+    g_renderer.stats.sgl_dropped++;
+    return;
+  }
+
+  // when the context is full, end the primitive at a line or quad boundary
+  // and carry on in the next context. line strips repeat the last vertex.
+  i32 group = prim_group_size(g_renderer.sgl_prim);
+  bool boundary = g_renderer.sgl_prim_len % group == 0;
+  if (boundary &&
+      g_renderer.sgl_vertices + group > g_renderer.sgl_max_vertices) {
+    sgl_end();
+    if (!next_sgl_context()) {
+      g_renderer.sgl_dropping = true;
+      g_renderer.stats.sgl_dropped++;
+      return;
+    }
+
+    bool strip = g_renderer.sgl_prim == RendererPrim_LineStrip &&
+                 g_renderer.sgl_prim_len > 0;
+    sgl_begin_state();
+
+    if (strip) {
+      DrawVertex l = g_renderer.sgl_last;
+      sgl_v2f_t2f_c4b(l.x, l.y, l.u, l.v, l.color.r, l.color.g, l.color.b,
+                      l.color.a);
+      g_renderer.sgl_vertices++;
+      g_renderer.sgl_prim_len++;
+    }
+  }
+
+  sgl_v2f_t2f_c4b(v.x, v.y, v.u, v.v, v.color.r, v.color.g, v.color.b,
+                  v.color.a);
+  g_renderer.sgl_vertices++;
+  g_renderer.sgl_prim_len++;
+  g_renderer.sgl_last = v;
+}
+
+static int queue_cmd_cmp(const void *a, const void *b) {
+  const QueueCmd *lhs = (const QueueCmd *)a;
+  const QueueCmd *rhs = (const QueueCmd *)b;
+
+  if (lhs->key != rhs->key) {
+    return lhs->key < rhs->key ? -1 : 1;
+  }
+  return lhs->seq < rhs->seq ? -1 : (lhs->seq > rhs->seq ? 1 : 0);
+}
+
+void renderer_flush_queue() {
+  if (g_renderer.queue.len == 0) {
+    return;
+  }
+
+  PROFILE_FUNC();
+
+  Array<QueueCmd> &queue = g_renderer.queue;
+
+  u64 unsorted_changes = 0;
+  {
+    u32 image = g_renderer.prim_image;
+    u32 sampler = g_renderer.prim_sampler;
+    for (QueueCmd &cmd : queue) {
+      count_state_change(&image, &sampler, cmd.image, cmd.sampler,
+                         &unsorted_changes);
+    }
+  }
+
+  qsort(queue.data, queue.len, sizeof(QueueCmd), queue_cmd_cmp);
+
+  u64 sorted_changes = 0;
+  for (u64 i = 0; i < queue.len;) {
+    QueueCmd &first = queue[i];
+    count_state_change(&g_renderer.prim_image, &g_renderer.prim_sampler,
+                       first.image, first.sampler, &sorted_changes);
+
+    // line strips can't be joined, everything else shares one sgl_begin for
+    // the whole run of commands with the same state
+    u64 end = i + 1;
+    if (first.prim != RendererPrim_LineStrip) {
+      while (end < queue.len && queue[end].key == first.key &&
+             queue[end].prim == first.prim) {
+        end++;
+      }
+    }
+
+    begin_sgl_prim(first.prim, first.image, first.sampler, first.shader);
+    for (u64 j = i; j < end; j++) {
+      QueueCmd &cmd = queue[j];
+      for (u32 k = 0; k < cmd.len; k++) {
+        sgl_vertex(cmd.vertices[k]);
+      }
+    }
+    end_sgl_prim();
+
+    i = end;
+  }
+
+  g_renderer.stats.state_changes += sorted_changes;
+  if (unsorted_changes > sorted_changes) {
+    g_renderer.stats.state_changes_saved += unsorted_changes - sorted_changes;
+  }
+
+  queue.len = 0;
+  g_renderer.queue_arena.reset();
+}
+
+void renderer_set_deferred(bool deferred) {
+  if (!deferred) {
+    renderer_flush_queue();
+  }
+  g_renderer.deferred = deferred;
+}
+
+bool renderer_deferred() { return g_renderer.deferred; }
+
+void renderer_set_layer(i32 layer) { g_renderer.sort_layer = layer; }
+
+i32 renderer_get_layer() { return g_renderer.sort_layer; }
+
+RendererStats renderer_stats() { return g_renderer.last_stats; }
+
+static void reset_state(DrawState *state) {
+  state->colors[0].r = 255;
+  state->colors[0].g = 255;
+  state->colors[0].b = 255;
+  state->colors[0].a = 255;
+  state->colors_len = 1;
+
+  state->matrices[0] = {};
+  state->matrices[0].cols[0][0] = 1.0f;
+  state->matrices[0].cols[1][1] = 1.0f;
+  state->matrices[0].cols[2][2] = 1.0f;
+  state->matrices[0].cols[3][3] = 1.0f;
+  state->matrices_len = 1;
+
+  state->sampler = SG_INVALID_ID;
+}
+
+// sampler is already resolved, so recorded draws keep the sampler they were
+// recorded with
+static void begin_prim(RendererPrim prim, u32 image, u32 sampler,
+                       RendererShader shader, Color color) {
+  assert(!g_renderer.in_prim);
+
+  g_renderer.in_prim = true;
+  g_renderer.prim = prim;
+  g_renderer.prim_shader = shader;
+  g_renderer.prim_color = color;
+  g_renderer.stats.commands++;
+
+  if (g_renderer.deferred) {
+    i32 layer = g_renderer.sort_layer;
+    if (layer < INT16_MIN) {
+      layer = INT16_MIN;
+    } else if (layer > INT16_MAX) {
+      layer = INT16_MAX;
+    }
+
+    QueueCmd cmd = {};
+    cmd.key = ((u64)(layer - INT16_MIN) << 48) | ((u64)image << 16) |
+              ((u64)shader << 14) | (u64)(sampler & 0x3fff);
+    cmd.seq = (u32)g_renderer.queue.len;
+    cmd.image = image;
+    cmd.sampler = sampler;
+    cmd.prim = prim;
+    cmd.shader = shader;
+    g_renderer.queue.push(cmd);
+  } else {
+    count_state_change(&g_renderer.prim_image, &g_renderer.prim_sampler, image,
+                       sampler, &g_renderer.stats.state_changes);
+
+    begin_sgl_prim(prim, image, sampler, shader);
+  }
+}
+
+static void end_prim() {
+  assert(g_renderer.in_prim);
+  g_renderer.in_prim = false;
+
+  if (!g_renderer.deferred) {
+    end_sgl_prim();
+  }
+}
+
+static void push_vertex(DrawVertex v) {
+  g_renderer.stats.vertices++;
+
+  if (!g_renderer.deferred) {
+    sgl_vertex(v);
+    return;
+  }
+
+  QueueCmd &cmd = g_renderer.queue[g_renderer.queue.len - 1];
+  if (cmd.len == cmd.cap) {
+    u32 cap = cmd.cap * 2;
+    if (cap < 4) {
+      cap = 4;
+    }
+
+    cmd.vertices = (DrawVertex *)g_renderer.queue_arena.rebump(
+        cmd.vertices, sizeof(DrawVertex) * cmd.len, sizeof(DrawVertex) * cap);
+    cmd.cap = cap;
+  }
+
+  cmd.vertices[cmd.len++] = v;
+}
+
+void renderer_begin_prim(RendererPrim prim, u32 image, RendererShader shader) {
+  DrawState *state = draw_state();
+
+  u32 sampler = image == SG_INVALID_ID ? 0u : state->sampler;
+  if (shader == RendererShader_SDF) {
+    sampler = g_renderer.linear_sampler.id;
+  }
+
+  if (t_recording != nullptr) {
+    DrawListCmd cmd = {};
+    cmd.image = image;
+    cmd.sampler = sampler;
+    cmd.prim = prim;
+    cmd.shader = shader;
+    cmd.first = (u32)t_recording->vertices.len;
+    t_recording->commands.push(cmd);
+    return;
+  }
+
+  begin_prim(prim, image, sampler, shader, renderer_peek_color());
+}
+
+void renderer_end_prim() {
+  if (t_recording == nullptr) {
+    end_prim();
+  }
+}
+
+static void renderer_push_vertex(float x, float y, float u, float v) {
+  if (t_recording != nullptr) {
+    DrawList *list = t_recording;
+    list->vertices.push({x, y, u, v, renderer_peek_color()});
+    list->commands[list->commands.len - 1].len++;
+    return;
+  }
+
+  push_vertex({x, y, u, v, g_renderer.prim_color});
+}
+
+void DrawList::make(i32 draw_order) {
+  vertices = {};
+  commands = {};
+  order = draw_order;
+  recording = false;
+  reset_state(&state);
+}
+
+void DrawList::trash() {
+  vertices.trash();
+  commands.trash();
+}
+
+void DrawList::clear() {
+  vertices.len = 0;
+  commands.len = 0;
+  reset_state(&state);
+}
+
+bool renderer_record(DrawList *list) {
+  if (t_recording != nullptr || list->recording) {
+    return false;
+  }
+
+  list->recording = true;
+  t_recording = list;
+  return true;
+}
+
+void renderer_stop_recording() {
+  if (t_recording != nullptr) {
+    t_recording->recording = false;
+    t_recording = nullptr;
+  }
+}
+
+bool renderer_recording() { return t_recording != nullptr; }
+
+void renderer_draw_list(DrawList *list) {
+  PROFILE_FUNC();
+
+  Matrix4 top = renderer_peek_matrix();
+
+  for (DrawListCmd &cmd : list->commands) {
+    begin_prim(cmd.prim, cmd.image, cmd.sampler, cmd.shader,
+               renderer_peek_color());
+    for (u32 i = cmd.first; i < cmd.first + cmd.len; i++) {
+      DrawVertex v = list->vertices[i];
+      Vector4 p = vec4_mul_mat4(vec4_xy(v.x, v.y), top);
+      v.x = p.x;
+      v.y = p.y;
+      push_vertex(v);
+    }
+    end_prim();
+  }
+}
+
+void renderer_draw_lists(Slice<DrawList *> lists) {
+  // insertion sort, so lists with the same order stay in the given order
+  for (u64 i = 1; i < lists.len; i++) {
+    DrawList *list = lists[i];
+    u64 j = i;
+    for (; j > 0 && lists[j - 1]->order > list->order; j--) {
+      lists[j] = lists[j - 1];
+    }
+    lists[j] = list;
+  }
+
+  for (DrawList *list : lists) {
+    renderer_draw_list(list);
+  }
+}
+
 void renderer_reset() {
   g_renderer.clear_color[0] = 0.0f;
   g_renderer.clear_color[1] = 0.0f;
   g_renderer.clear_color[2] = 0.0f;
   g_renderer.clear_color[3] = 1.0f;
 
-  g_renderer.draw_colors[0].r = 255;
-  g_renderer.draw_colors[0].g = 255;
-  g_renderer.draw_colors[0].b = 255;
-  g_renderer.draw_colors[0].a = 255;
-  g_renderer.draw_colors_len = 1;
-
-  g_renderer.matrices[0] = {};
-  g_renderer.matrices[0].cols[0][0] = 1.0f;
-  g_renderer.matrices[0].cols[1][1] = 1.0f;
-  g_renderer.matrices[0].cols[2][2] = 1.0f;
-  g_renderer.matrices[0].cols[3][3] = 1.0f;
-  g_renderer.matrices_len = 1;
-
-  g_renderer.sampler = SG_INVALID_ID;
+  reset_state(&g_renderer.state);
+  g_renderer.sort_layer = 0;
 }
 
-void renderer_use_sampler(u32 sampler) { g_renderer.sampler = sampler; }
+void renderer_use_sampler(u32 sampler) { draw_state()->sampler = sampler; }
 
 void renderer_get_clear_color(float *rgba) {
   memcpy(rgba, g_renderer.clear_color, sizeof(float) * 4);
@@ -58,55 +1151,66 @@ void renderer_set_clear_color(float *rgba) {
   memcpy(g_renderer.clear_color, rgba, sizeof(float) * 4);
 }
 
+Color renderer_peek_color() {
+  DrawState *state = draw_state();
+  return state->colors[state->colors_len - 1];
+}
+
 void renderer_apply_color() {
-  Color c = g_renderer.draw_colors[g_renderer.draw_colors_len - 1];
+  Color c = renderer_peek_color();
   sgl_c4b(c.r, c.g, c.b, c.a);
 }
 
 bool renderer_push_color(Color c) {
-  if (g_renderer.draw_colors_len == array_size(g_renderer.draw_colors)) {
+  DrawState *state = draw_state();
+  if (state->colors_len == array_size(state->colors)) {
     return false;
   }
 
-  g_renderer.draw_colors[g_renderer.draw_colors_len++] = c;
+  state->colors[state->colors_len++] = c;
   return true;
 }
 
 bool renderer_pop_color() {
-  if (g_renderer.draw_colors_len == 1) {
+  DrawState *state = draw_state();
+  if (state->colors_len == 1) {
     return false;
   }
 
-  g_renderer.draw_colors_len--;
+  state->colors_len--;
   return true;
 }
 
 bool renderer_push_matrix() {
-  if (g_renderer.matrices_len == array_size(g_renderer.matrices)) {
+  DrawState *state = draw_state();
+  if (state->matrices_len == array_size(state->matrices)) {
     return false;
   }
 
-  g_renderer.matrices[g_renderer.matrices_len] =
-      g_renderer.matrices[g_renderer.matrices_len - 1];
-  g_renderer.matrices_len++;
+  state->matrices[state->matrices_len] =
+      state->matrices[state->matrices_len - 1];
+  state->matrices_len++;
   return true;
 }
 
 bool renderer_pop_matrix() {
-  if (g_renderer.matrices_len == 1) {
+  DrawState *state = draw_state();
+  if (state->matrices_len == 1) {
     return false;
   }
 
-  g_renderer.matrices_len--;
+  state->matrices_len--;
   return true;
 }
 
 Matrix4 renderer_peek_matrix() {
-  return g_renderer.matrices[g_renderer.matrices_len - 1];
+  DrawState *state = draw_state();
+  return state->matrices[state->matrices_len - 1];
 }
 
 void renderer_set_top_matrix(Matrix4 mat) {
-  g_renderer.matrices[g_renderer.matrices_len - 1] = mat;
+  DrawState *state = draw_state();
+  state->matrices[state->matrices_len - 1] = mat;
 }
 
 void renderer_translate(float x, float y) {
@@ -176,16 +1280,16 @@ void renderer_push_quad(Vector4 pos, Vector4 tex) {
   Vector4 c = vec4_mul_mat4(vec4_xy(pos.z, pos.w), top);
   Vector4 d = vec4_mul_mat4(vec4_xy(pos.z, pos.y), top);
 
-  sgl_v2f_t2f(a.x, a.y, tex.x, tex.y);
-  sgl_v2f_t2f(b.x, b.y, tex.x, tex.w);
-  sgl_v2f_t2f(c.x, c.y, tex.z, tex.w);
-  sgl_v2f_t2f(d.x, d.y, tex.z, tex.y);
+  renderer_push_vertex(a.x, a.y, tex.x, tex.y);
+  renderer_push_vertex(b.x, b.y, tex.x, tex.w);
+  renderer_push_vertex(c.x, c.y, tex.z, tex.w);
+  renderer_push_vertex(d.x, d.y, tex.z, tex.y);
 }
 
 void renderer_push_xy(float x, float y) {
   Matrix4 top = renderer_peek_matrix();
   Vector4 v = vec4_mul_mat4(vec4_xy(x, y), top);
-  sgl_v2f(v.x, v.y);
+  renderer_push_vertex(v.x, v.y, 0, 0);
 }
 
 void draw_image(const Image *img, DrawDescription *desc) {
@@ -198,20 +1302,25 @@ void draw_image(const Image *img, DrawDescription *desc) {
   renderer_rotate(desc->rotation);
   renderer_scale(desc->sx, desc->sy);
 
-  sgl_enable_texture();
-  sgl_texture({img->id}, {g_renderer.sampler});
-  sgl_begin_quads();
+  renderer_begin_prim(RendererPrim_Quads, img->id);
 
   float x0 = -desc->ox;
   float y0 = -desc->oy;
   float x1 = (desc->u1 - desc->u0) * img->width - desc->ox;
   float y1 = (desc->v1 - desc->v0) * img->height - desc->oy;
 
-  renderer_apply_color();
-  renderer_push_quad(vec4(x0, y0, x1, y1),
-                     vec4(desc->u0, desc->v0, desc->u1, desc->v1));
+  Vector4 tex = vec4(desc->u0, desc->v0, desc->u1, desc->v1);
+  if (img->packed) {
+    // texture coords are relative to the image's part of its page
+    float du = img->u1 - img->u0;
+    float dv = img->v1 - img->v0;
+    tex = vec4(img->u0 + tex.x * du, img->v0 + tex.y * dv,
+               img->u0 + tex.z * du, img->v0 + tex.w * dv);
+  }
 
-  sgl_end();
+  renderer_push_quad(vec4(x0, y0, x1, y1), tex);
+
+  renderer_end_prim();
   renderer_pop_matrix();
 }
 
@@ -226,6 +1335,7 @@ void draw_sprite(Sprite *spr, DrawDescription *desc) {
   SpriteView view = {};
   ok = view.make(spr);
   if (!ok) {
+    renderer_pop_matrix();
     return;
   }
 
@@ -233,9 +1343,7 @@ void draw_sprite(Sprite *spr, DrawDescription *desc) {
   renderer_rotate(desc->rotation);
   renderer_scale(desc->sx, desc->sy);
 
-  sgl_enable_texture();
-  sgl_texture({view.data.img.id}, {g_renderer.sampler});
-  sgl_begin_quads();
+  renderer_begin_prim(RendererPrim_Quads, view.data.img.id);
 
   float x0 = -desc->ox;
   float y0 = -desc->oy;
@@ -244,114 +1352,159 @@ void draw_sprite(Sprite *spr, DrawDescription *desc) {
 
   SpriteFrame f = view.data.frames[view.frame()];
 
-  renderer_apply_color();
   renderer_push_quad(vec4(x0, y0, x1, y1), vec4(f.u0, f.v0, f.u1, f.v1));
 
-  sgl_end();
+  renderer_end_prim();
   renderer_pop_matrix();
 }
 
-static void draw_font_line(FontFamily *font, float size, float *start_x,
-                           float *start_y, String line) {
-  float x = *start_x;
-  float y = *start_y;
-  for (Rune r : UTF8(line)) {
-    u32 atlas = 0;
-    float xx = x;
-    float yy = y;
-    stbtt_aligned_quad q = font->quad(&atlas, &xx, &yy, size, r.charcode());
-
-    sgl_texture({atlas}, {g_renderer.sampler});
-    sgl_begin_quads();
-    renderer_push_quad(vec4(x + q.x0, y + q.y0, x + q.x1, y + q.y1),
-                       vec4(q.s0, q.t0, q.s1, q.t1));
-    sgl_end();
+static float draw_text_mesh(TextMesh *mesh, float x, float y) {
+  RendererShader shader =
+      mesh->sdf ? RendererShader_SDF : RendererShader_Default;
 
-    x = xx;
-    y = yy;
+  for (TextRun run : mesh->runs) {
+    renderer_begin_prim(RendererPrim_Quads, run.image, shader);
+    for (u32 i = run.first; i < run.first + run.count; i++) {
+      TextGlyph g = mesh->glyphs[i];
+      renderer_push_quad(vec4(x + g.x0, y + g.y0, x + g.x1, y + g.y1),
+                         vec4(g.u0, g.v0, g.u1, g.v1));
+    }
+    renderer_end_prim();
   }
 
-  *start_y += size;
+  return y + mesh->advance_y;
 }
 
 float draw_font(FontFamily *font, float size, float x, float y, String text) {
   PROFILE_FUNC();
 
-  y += size;
-  sgl_enable_texture();
-  renderer_apply_color();
-
-  for (String line : SplitLines(text)) {
-    draw_font_line(font, size, &x, &y, line);
+  // the text cache belongs to the main thread
+  if (t_recording != nullptr) {
+    return y;
   }
 
-  return y - size;
+  TextMesh *mesh = text_cache_get(font, size, text, -1);
+  return draw_text_mesh(mesh, x, y);
 }
 
 float draw_font_wrapped(FontFamily *font, float size, float x, float y,
                         String text, float limit) {
   PROFILE_FUNC();
 
-  y += size;
-  sgl_enable_texture();
-  renderer_apply_color();
-
-  for (String line : SplitLines(text)) {
-    font->sb.clear();
-    Scanner scan = line;
-
-    for (String word = scan.next_string(); word != "";
-         word = scan.next_string()) {
-
-      font->sb << word;
+  if (t_recording != nullptr) {
+    return y;
+  }
 
-      float width = font->width(size, String(font->sb));
-      if (width < limit) {
-        font->sb << " ";
-        continue;
-      }
+  TextMesh *mesh = text_cache_get(font, size, text, limit);
+  return draw_text_mesh(mesh, x, y);
+}
 
-      font->sb.len -= word.len;
-      font->sb.data[font->sb.len] = '\0';
+Vector4 renderer_view_rect() {
+  Matrix4 top = renderer_peek_matrix();
 
-      draw_font_line(font, size, &x, &y, String(font->sb));
+  // invert the 2d part of the top matrix to bring the screen corners back
+  // into the current coordinate space
+  float a = top.cols[0][0];
+  float b = top.cols[0][1];
+  float c = top.cols[1][0];
+  float d = top.cols[1][1];
+  float tx = top.cols[3][0];
+  float ty = top.cols[3][1];
+
+  float det = a * d - b * c;
+  if (det == 0) {
+    return vec4(0, 0, 0, 0);
+  }
 
-      font->sb.clear();
-      font->sb << word << " ";
-    }
+  float corners[4][2] = {
+      {0, 0},
+      {g_renderer.width, 0},
+      {0, g_renderer.height},
+      {g_renderer.width, g_renderer.height},
+  };
 
-    draw_font_line(font, size, &x, &y, String(font->sb));
+  Vector4 rect = vec4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+  for (i32 i = 0; i < 4; i++) {
+    float sx = corners[i][0] - tx;
+    float sy = corners[i][1] - ty;
+    float x = (d * sx - c * sy) / det;
+    float y = (a * sy - b * sx) / det;
+
+    rect.x = x < rect.x ? x : rect.x;
+    rect.y = y < rect.y ? y : rect.y;
+    rect.z = x > rect.z ? x : rect.z;
+    rect.w = y > rect.w ? y : rect.w;
   }
 
-  return y - size;
+  return rect;
+}
+
+static bool rect_overlaps(Vector4 view, float x0, float y0, float x1,
+                          float y1) {
+  return x0 < view.z && x1 > view.x && y0 < view.w && y1 > view.y;
 }
 
-void draw_tilemap(const Tilemap *tm) {
+void draw_tilemap(const Tilemap *tm, Vector4 view) {
   PROFILE_FUNC();
 
-  sgl_enable_texture();
-  renderer_apply_color();
+  if (tm->vbuf == SG_INVALID_ID) {
+    return;
+  }
+
+  RendererDraw rd = {};
+  rd.pip = g_renderer.sprite_pipeline;
+  rd.bind.vertex_buffers[0] = {tm->vbuf};
+  rd.bind.index_buffer = {tm->ibuf};
+  rd.bind.fs.samplers[0] = renderer_sampler();
+
   for (const TilemapLevel &level : tm->levels) {
+    float lx0 = level.world_x;
+    float ly0 = level.world_y;
+    float lx1 = level.world_x + level.px_width;
+    float ly1 = level.world_y + level.px_height;
+    if (!rect_overlaps(view, lx0, ly0, lx1, ly1)) {
+      continue;
+    }
+
     bool ok = renderer_push_matrix();
     if (!ok) {
       return;
     }
 
     renderer_translate(level.world_x, level.world_y);
+
+    Vector4 local = vec4(view.x - level.world_x, view.y - level.world_y,
+                         view.z - level.world_x, view.w - level.world_y);
+
     for (i32 i = level.layers.len - 1; i >= 0; i--) {
       const TilemapLayer &layer = level.layers[i];
-      sgl_texture({layer.image.id}, {g_renderer.sampler});
-      sgl_begin_quads();
-      for (Tile tile : layer.tiles) {
-        float x0 = tile.x;
-        float y0 = tile.y;
-        float x1 = tile.x + layer.grid_size;
-        float y1 = tile.y + layer.grid_size;
-
-        renderer_push_quad(vec4(x0, y0, x1, y1),
-                           vec4(tile.u0, tile.v0, tile.u1, tile.v1));
+      rd.bind.fs.images[0] = {layer.image.id};
+      rd.num_elements = 0;
+
+      // chunks are stored back to back, so visible neighbours are merged
+      // into one draw
+      for (const TilemapChunk &chunk : layer.chunks) {
+        if (!rect_overlaps(local, chunk.x0, chunk.y0, chunk.x1, chunk.y1)) {
+          continue;
+        }
+
+        if (rd.num_elements != 0 &&
+            rd.base_element + rd.num_elements == chunk.base_element) {
+          rd.num_elements += chunk.num_elements;
+          continue;
+        }
+
+        if (rd.num_elements != 0) {
+          renderer_push_draw(&rd);
+        }
+
+        rd.base_element = chunk.base_element;
+        rd.num_elements = chunk.num_elements;
+      }
+
+      if (rd.num_elements != 0) {
+        renderer_push_draw(&rd);
       }
-      sgl_end();
     }
     renderer_pop_matrix();
   }
@@ -369,18 +1522,16 @@ void draw_filled_rect(RectDescription *desc) {
   renderer_rotate(desc->rotation);
   renderer_scale(desc->sx, desc->sy);
 
-  sgl_disable_texture();
-  sgl_begin_quads();
+  renderer_begin_prim(RendererPrim_Quads, SG_INVALID_ID);
 
   float x0 = -desc->ox;
   float y0 = -desc->oy;
   float x1 = desc->w - desc->ox;
   float y1 = desc->h - desc->oy;
 
-  renderer_apply_color();
   renderer_push_quad(vec4(x0, y0, x1, y1), vec4(0, 0, 0, 0));
 
-  sgl_end();
+  renderer_end_prim();
   renderer_pop_matrix();
 }
 
@@ -396,38 +1547,28 @@ void draw_line_rect(RectDescription *desc) {
   renderer_rotate(desc->rotation);
   renderer_scale(desc->sx, desc->sy);
 
-  sgl_disable_texture();
-  sgl_begin_line_strip();
+  renderer_begin_prim(RendererPrim_LineStrip, SG_INVALID_ID);
 
   float x0 = -desc->ox;
   float y0 = -desc->oy;
   float x1 = desc->w - desc->ox;
   float y1 = desc->h - desc->oy;
 
-  Matrix4 top = renderer_peek_matrix();
-  Vector4 a = vec4_mul_mat4(vec4_xy(x0, y0), top);
-  Vector4 b = vec4_mul_mat4(vec4_xy(x0, y1), top);
-  Vector4 c = vec4_mul_mat4(vec4_xy(x1, y1), top);
-  Vector4 d = vec4_mul_mat4(vec4_xy(x1, y0), top);
-
-  renderer_apply_color();
-  sgl_v2f(a.x, a.y);
-  sgl_v2f(b.x, b.y);
-  sgl_v2f(c.x, c.y);
-  sgl_v2f(d.x, d.y);
-  sgl_v2f(a.x, a.y);
+  renderer_push_xy(x0, y0);
+  renderer_push_xy(x0, y1);
+  renderer_push_xy(x1, y1);
+  renderer_push_xy(x1, y0);
+  renderer_push_xy(x0, y0);
 
-  sgl_end();
+  renderer_end_prim();
   renderer_pop_matrix();
 }
 
 void draw_line_circle(float x, float y, float radius) {
   PROFILE_FUNC();
 
-  sgl_disable_texture();
-  sgl_begin_line_strip();
+  renderer_begin_prim(RendererPrim_LineStrip, SG_INVALID_ID);
 
-  renderer_apply_color();
   constexpr float tau = MATH_PI * 2.0f;
   for (float i = 0; i <= tau + 0.001f; i += tau / 36.0f) {
     float c = cosf(i) * radius;
@@ -435,21 +1576,18 @@ void draw_line_circle(float x, float y, float radius) {
     renderer_push_xy(x + c, y + s);
   }
 
-  sgl_end();
+  renderer_end_prim();
 }
 
 void draw_line(float x0, float y0, float x1, float y1) {
   PROFILE_FUNC();
 
-  sgl_disable_texture();
-  sgl_begin_lines();
-
-  renderer_apply_color();
+  renderer_begin_prim(RendererPrim_Lines, SG_INVALID_ID);
 
   renderer_push_xy(x0, y0);
   renderer_push_xy(x1, y1);
 
-  sgl_end();
+  renderer_end_prim();
 }
 
 DrawDescription draw_description_args(lua_State *L, i32 arg_start) {
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "algebra.h"
+#include "deps/sokol_gfx.h"
 #include "font.h"
 #include "image.h"
+#include "slice.h"
 #include "sprite.h"
 #include "tilemap.h"
 
@@ -42,16 +44,176 @@ struct Color {
   u8 r, g, b, a;
 };
 
+// vertex layout used by renderer_sprite_pipeline
+struct SpriteVertex {
+  float x, y;
+  float u, v;
+  Color color;
+};
+
+// a draw call that goes straight to sokol_gfx instead of through sokol_gl.
+// the renderer fills in the matrix and color uniforms, and keeps the draw in
+// order with everything else drawn this frame.
+struct RendererDraw {
+  sg_pipeline pip;
+  sg_bindings bind;
+  i32 base_element;
+  i32 num_elements;
+  i32 num_instances;
+  float params[8]; // vs_params[5..6], for shaders that use them
+};
+
+enum RendererPrim : u8 {
+  RendererPrim_Quads,
+  RendererPrim_Lines,
+  RendererPrim_LineStrip,
+};
+
+enum RendererShader : u8 {
+  RendererShader_Default,
+  RendererShader_SDF, // signed distance field glyphs, always linear filtered
+};
+
+// matrix and color stacks that draws are transformed and tinted by
+struct DrawState {
+  Matrix4 matrices[32];
+  u64 matrices_len;
+  Color colors[32];
+  u64 colors_len;
+  u32 sampler;
+};
+
+struct DrawVertex {
+  float x, y;
+  float u, v;
+  Color color;
+};
+
+struct DrawListCmd {
+  u32 image;
+  u32 sampler;
+  RendererPrim prim;
+  RendererShader shader;
+  Color color;
+  u32 first; // index into DrawList::vertices
+  u32 len;
+};
+
+// draws recorded into plain arrays instead of going to sokol_gl, so a list
+// can be filled on any thread. the main thread plays it back with
+// renderer_draw_list. each list has its own matrix and color stacks.
+struct DrawList {
+  Array<DrawVertex> vertices;
+  Array<DrawListCmd> commands;
+  DrawState state;
+  i32 order; // lists given to renderer_draw_lists are drawn by this
+  bool recording;
+
+  void make(i32 draw_order);
+  void trash();
+  void clear();
+};
+
+// counters for the previous frame
+struct RendererStats {
+  u64 commands;
+  u64 vertices;
+  u64 state_changes;       // texture or sampler switches
+  u64 state_changes_saved; // switches avoided by sorting deferred draws
+
+  // sokol_gl usage, for sizing the vertex and command budgets
+  u64 sgl_vertices;
+  u64 sgl_commands;
+  u64 sgl_contexts; // more than 1 when a budget overflowed
+  u64 sgl_dropped;  // vertices skipped because every context was full
+  u64 sgl_vertices_peak; // highest sgl_vertices of any frame so far
+  u64 sgl_commands_peak;
+};
+
+// when the sokol_gl vertex or command budget runs out, the rest of the frame
+// goes to another context with the same budget, up to this many contexts
+constexpr i32 RENDERER_MAX_SGL_CONTEXTS = 16;
+
+// budget per sokol_gl context. call before renderer_setup.
+void renderer_set_sgl_budget(i32 vertices, i32 commands);
+void renderer_setup();
+void renderer_shutdown();
+void renderer_begin(i32 width, i32 height);
+
+// draws the frame's canvases, then the screen with the given pass action.
+// the caller holds the gpu lock.
+void renderer_flush(const sg_pass_action *screen);
+u64 renderer_frame();
+
+// destroys a gpu object at the end of renderer_flush, since draws queued
+// earlier in the frame can still use it. the caller holds the gpu lock.
+void renderer_retire_image(u32 id);
+void renderer_retire_buffer(u32 id);
+void renderer_retire_pass(u32 id);
+
+sg_pipeline renderer_sprite_pipeline();
+sg_pipeline renderer_sdf_pipeline();
+sg_pipeline renderer_instance_pipeline();
+sg_sampler renderer_sampler();
+sg_sampler renderer_linear_sampler();
+void renderer_push_draw(RendererDraw *draw);
+
+// binds the unit quad that instanced draws use as vertex buffer 0
+void renderer_bind_quad(sg_bindings *bind);
+
+// in deferred mode, draws are queued and sorted by layer, then texture,
+// instead of going to sokol_gl right away. anything that talks to sokol_gl
+// directly must call renderer_flush_queue first.
+void renderer_set_deferred(bool deferred);
+bool renderer_deferred();
+void renderer_set_layer(i32 layer);
+i32 renderer_get_layer();
+void renderer_flush_queue();
+RendererStats renderer_stats();
+
+// for code that talks to sokol_gl directly. makes room for the given number
+// of vertices and commands, switching contexts if needed. returns false if
+// there's no room left this frame.
+bool renderer_sgl_reserve(i32 vertices, i32 commands);
+void renderer_scissor_rect(float x, float y, float w, float h);
+
+// draws until renderer_end_canvas go to the given pass, which is rendered
+// before the screen. returns false if a canvas is already active.
+bool renderer_begin_canvas(u32 pass, i32 width, i32 height,
+                           sg_pass_action action);
+void renderer_end_canvas();
+i32 renderer_sgl_error(); // SGL_NO_ERROR if every context is fine
+
+// image is SG_INVALID_ID for untextured draws
+void renderer_begin_prim(RendererPrim prim, u32 image,
+                         RendererShader shader = RendererShader_Default);
+void renderer_end_prim();
+
+// until renderer_stop_recording, draws made on the calling thread go to the
+// list. only images, sprites, rects and lines can be recorded, other draws
+// are skipped. returns false if the list is being recorded already.
+bool renderer_record(DrawList *list);
+void renderer_stop_recording();
+bool renderer_recording();
+
+// plays back lists on the main thread, transformed by the current matrix.
+// renderer_draw_lists sorts by DrawList::order first, so lists received from
+// several threads are merged in the same order every frame.
+void renderer_draw_list(DrawList *list);
+void renderer_draw_lists(Slice<DrawList *> lists);
+
 void renderer_reset();
 void renderer_use_sampler(u32 sampler);
 void renderer_get_clear_color(float *rgba);
 void renderer_set_clear_color(float *rgba);
 void renderer_apply_color();
+Color renderer_peek_color();
 bool renderer_push_color(Color c);
 bool renderer_pop_color();
 bool renderer_push_matrix();
 bool renderer_pop_matrix();
 Matrix4 renderer_peek_matrix();
+Vector4 renderer_view_rect(); // x0, y0, x1, y1 of the visible area
 void renderer_set_top_matrix(Matrix4 mat);
 void renderer_translate(float x, float y);
 void renderer_rotate(float angle);
@@ -64,7 +226,7 @@ void draw_sprite(Sprite *spr, DrawDescription *desc);
 float draw_font(FontFamily *font, float size, float x, float y, String text);
 float draw_font_wrapped(FontFamily *font, float size, float x, float y,
                         String text, float limit);
-void draw_tilemap(const Tilemap *tm);
+void draw_tilemap(const Tilemap *tm, Vector4 view);
 void draw_filled_rect(RectDescription *desc);
 void draw_line_rect(RectDescription *desc);
 void draw_line_circle(float x, float y, float radius);
@@ -1,26 +1,94 @@
 #include "font.h"
 #include "app.h"
 #include "deps/sokol_gfx.h"
+#include "draw.h"
 #include "embed/cousine_compressed.h"
 #include "prelude.h"
 #include "profile.h"
 #include "stb_decompress.h"
 #include "strings.h"
+#include "text.h"
 #include "vfs.h"
+#include <math.h>
 #include <stdio.h>
 
-bool FontFamily::load(String filepath) {
+static Array<FontFamily *> g_dirty_fonts;
+
+struct FontImageUse {
+  i32 refs;
+  bool retired;
+};
+
+struct RetiredFontImage {
+  u32 id;
+  u64 frame;
+};
+
+static HashMap<FontImageUse> g_image_use; // key: image id
+static Array<RetiredFontImage> g_retired; // destroyed once no frame uses them
+
+constexpr i32 FONT_ATLAS_MAX_SIZE = 4096;
+constexpr i32 FONT_BAND_HEIGHT = 256;
+
+// draws made this frame can still use the image, so it's destroyed in the
+// next one
+static void retire_image(u32 id) {
+  FontImageUse *use = g_image_use.get(id);
+  if (use != nullptr) {
+    use->retired = true;
+    return;
+  }
+
+  g_retired.push({id, renderer_frame()});
+}
+
+void font_retain_image(u32 id) { g_image_use[id].refs++; }
+
+void font_release_image(u32 id) {
+  FontImageUse *use = g_image_use.get(id);
+  if (use == nullptr || --use->refs > 0) {
+    return;
+  }
+
+  bool retired = use->retired;
+  g_image_use.unset(id);
+  if (retired) {
+    g_retired.push({id, renderer_frame()});
+  }
+}
+
+static bool font_init(FontFamily *f, FileView ttf) {
+  const u8 *data = (const u8 *)ttf.contents.data;
+  i32 offset = stbtt_GetFontOffsetForIndex(data, 0);
+  if (offset < 0 || !stbtt_InitFont(&f->info, data, offset)) {
+    return false;
+  }
+
+  f->ttf = ttf;
+  f->sb = {};
+  return true;
+}
+
+bool FontFamily::load(String filepath, bool sdf) {
   PROFILE_FUNC();
 
-  String contents = {};
-  bool ok = vfs_read_entire_file(&contents, filepath);
+  // copied instead of viewed, since the font keeps it. a mapping would
+  // fault if the file is rewritten while hot reloading.
+  FileView view = {};
+  view.owned = true;
+  bool ok = vfs_read_entire_file(&view.contents, filepath);
   if (!ok) {
     return false;
   }
 
   FontFamily f = {};
-  f.ttf = contents;
-  f.sb = {};
+  ok = font_init(&f, view);
+  if (!ok) {
+    vfs_release_view(&view);
+    return false;
+  }
+  f.sdf = sdf;
+
   *this = f;
   return true;
 }
@@ -28,137 +96,403 @@ bool FontFamily::load(String filepath) {
 void FontFamily::load_default() {
   PROFILE_FUNC();
 
-  String contents =
+  FileView view = {};
+  view.contents =
       stb_decompress_data(cousine_compressed_data, cousine_compressed_size);
+  view.owned = true;
 
   FontFamily f = {};
-  f.ttf = contents;
-  f.sb = {};
+  font_init(&f, view);
   *this = f;
 }
 
 void FontFamily::trash() {
-  for (auto [k, v] : ranges) {
-    v->image.trash();
+  text_cache_evict_font(this);
+
+  for (u64 i = 0; i < g_dirty_fonts.len; i++) {
+    if (g_dirty_fonts[i] == this) {
+      g_dirty_fonts[i] = g_dirty_fonts[g_dirty_fonts.len - 1];
+      g_dirty_fonts.len--;
+      break;
+    }
+  }
+
+  for (FontBand &band : atlas.bands) {
+    retire_image(band.image);
   }
+
+  atlas.bands.trash();
+  atlas.shelves.trash();
+  mem_free(atlas.pixels);
+
+  glyphs.trash();
   sb.trash();
-  ranges.trash();
-  mem_free(ttf.data);
+  vfs_release_view(&ttf);
 }
 
-struct FontKey {
-  float size;
-  i32 ch;
-};
+static u32 make_atlas_image(i32 width, i32 height) {
+  sg_image_desc desc = {};
+  desc.width = width;
+  desc.height = height;
+  desc.usage = SG_USAGE_DYNAMIC;
+
+  LockGuard lock{&g_app->gpu_mtx};
+  return sg_make_image(desc).id;
+}
+
+static void upload_band(FontAtlas *atlas, FontBand *band) {
+  sg_image_data data = {};
+  data.subimage[0][0].ptr = &atlas->pixels[band->y * atlas->width * 4];
+  data.subimage[0][0].size = atlas->width * band->height * 4;
+  sg_update_image({band->image}, data);
+  band->dirty = false;
+}
+
+static void mark_dirty(FontFamily *font, FontBand *band) {
+  band->dirty = true;
+  if (!font->atlas.dirty) {
+    font->atlas.dirty = true;
+    g_dirty_fonts.push(font);
+  }
+}
+
+static void clear_pixels(u8 *pixels, i32 len) {
+  for (i32 i = 0; i < len; i += 4) {
+    pixels[i + 0] = 255;
+    pixels[i + 1] = 255;
+    pixels[i + 2] = 255;
+    pixels[i + 3] = 0;
+  }
+}
+
+// add rows to the bottom of the atlas. glyphs already packed stay where
+// they are, in textures that stay the same.
+static bool add_band(FontFamily *font, i32 height) {
+  FontAtlas *atlas = &font->atlas;
+  if (atlas->height + height > FONT_ATLAS_MAX_SIZE) {
+    return false;
+  }
+
+  i32 width = atlas->width;
+  u8 *pixels = (u8 *)mem_alloc(width * (atlas->height + height) * 4);
+  if (atlas->pixels != nullptr) {
+    memcpy(pixels, atlas->pixels, width * atlas->height * 4);
+    mem_free(atlas->pixels);
+  }
+  clear_pixels(&pixels[width * atlas->height * 4], width * height * 4);
+  atlas->pixels = pixels;
+
+  FontBand band = {};
+  band.image = make_atlas_image(width, height);
+  band.y = atlas->height;
+  band.height = height;
+  atlas->bands.push(band);
+  atlas->height += height;
 
-static FontKey font_key(float size, i32 charcode) {
-  FontKey fk = {};
-  fk.size = size;
-  fk.ch =
-      (charcode / array_size(FontRange::chars)) * array_size(FontRange::chars);
-  return fk;
+  mark_dirty(font, &atlas->bands[atlas->bands.len - 1]);
+  return true;
 }
 
-static void make_font_range(FontRange *out, FontFamily *font, FontKey key) {
+// replace every band's texture with one of the given width. the old
+// textures are retired, since text meshes made before now still use them.
+static void remake_atlas(FontFamily *font, i32 width, bool keep_pixels) {
   PROFILE_FUNC();
 
-  i32 width = 256;
-  i32 height = 256;
+  FontAtlas *atlas = &font->atlas;
 
-  u8 *bitmap = nullptr;
-  while (bitmap == nullptr) {
-    PROFILE_BLOCK("try bake");
-
-    bitmap = (u8 *)mem_alloc(width * height);
-    i32 res = stbtt_BakeFontBitmap((u8 *)font->ttf.data, 0, key.size, bitmap,
-                                   width, height, key.ch,
-                                   array_size(out->chars), out->chars);
-    if (res < 0) {
-      mem_free(bitmap);
-      bitmap = nullptr;
-      width *= 2;
-      height *= 2;
+  for (FontBand &band : atlas->bands) {
+    if (band.dirty) {
+      // bands are uploaded at the end of a frame, so this one hasn't been
+      // updated yet this frame
+      LockGuard lock{&g_app->gpu_mtx};
+      upload_band(atlas, &band);
     }
+    retire_image(band.image);
   }
-  defer(mem_free(bitmap));
 
-  u8 *image = (u8 *)mem_alloc(width * height * 4);
-  defer(mem_free(image));
-
-  {
-    PROFILE_BLOCK("convert rgba");
+  if (keep_pixels) {
+    u8 *pixels = (u8 *)mem_alloc(width * atlas->height * 4);
+    clear_pixels(pixels, width * atlas->height * 4);
+    for (i32 y = 0; y < atlas->height; y++) {
+      memcpy(&pixels[y * width * 4], &atlas->pixels[y * atlas->width * 4],
+             atlas->width * 4);
+    }
+    mem_free(atlas->pixels);
+    atlas->pixels = pixels;
+    atlas->width = width;
 
-    for (i32 i = 0; i < width * height * 4; i += 4) {
-      image[i + 0] = 255;
-      image[i + 1] = 255;
-      image[i + 2] = 255;
-      image[i + 3] = bitmap[i / 4];
+    for (FontBand &band : atlas->bands) {
+      band.image = make_atlas_image(width, band.height);
+      mark_dirty(font, &band);
     }
+  } else {
+    mem_free(atlas->pixels);
+    atlas->pixels = nullptr;
+    atlas->width = width;
+    atlas->height = 0;
+    atlas->bands.len = 0;
+    atlas->shelves.len = 0;
+    atlas->next_y = 0;
+    font->glyphs.clear();
   }
 
-  u32 id = 0;
-  {
-    PROFILE_BLOCK("make image");
+  atlas->generation++;
 
-    sg_image_desc sg_image = {};
-    sg_image.width = width;
-    sg_image.height = height;
-    sg_image.data.subimage[0][0].ptr = image;
-    sg_image.data.subimage[0][0].size = width * height * 4;
+  // cached text holds texture coords for the old size
+  text_cache_evict_font(font);
 
-    {
-      LockGuard lock{&g_app->gpu_mtx};
-      id = sg_make_image(sg_image).id;
+  printf("resized font atlas to %dx%d\n", atlas->width, atlas->height);
+}
+
+static bool shelf_pack(FontFamily *font, i32 w, i32 h, i32 *x, i32 *y) {
+  FontAtlas *atlas = &font->atlas;
+  if (w > atlas->width) {
+    return false;
+  }
+
+  for (FontShelf &shelf : atlas->shelves) {
+    if (h <= shelf.height && h * 4 >= shelf.height * 3 &&
+        shelf.x + w <= atlas->width) {
+      *x = shelf.x;
+      *y = shelf.y;
+      shelf.x += w;
+      return true;
+    }
+  }
+
+  // shelves don't cross bands. the rest of the last band is left empty if
+  // the shelf doesn't fit in it.
+  if (atlas->next_y + h > atlas->height) {
+    i32 height = h > FONT_BAND_HEIGHT ? h : FONT_BAND_HEIGHT;
+    if (atlas->height + height > FONT_ATLAS_MAX_SIZE) {
+      height = FONT_ATLAS_MAX_SIZE - atlas->height;
     }
+
+    if (height < h || !add_band(font, height)) {
+      return false;
+    }
+    atlas->next_y = atlas->bands[atlas->bands.len - 1].y;
   }
 
-  out->image.id = id;
-  out->image.width = width;
-  out->image.height = height;
+  FontShelf shelf = {};
+  shelf.x = w;
+  shelf.y = atlas->next_y;
+  shelf.height = h;
+  atlas->shelves.push(shelf);
+  atlas->next_y += h;
 
-  printf("created font range with id %d\n", id);
+  *x = 0;
+  *y = shelf.y;
+  return true;
 }
 
-static FontRange *get_range(FontFamily *font, FontKey key) {
-  u64 hash = *(u64 *)&key;
-  FontRange *range = font->ranges.get(hash);
-  if (range == nullptr) {
-    range = &font->ranges[hash];
-    make_font_range(range, font, key);
+static u16 band_at(FontAtlas *atlas, i32 y) {
+  for (u64 i = 0; i < atlas->bands.len; i++) {
+    FontBand band = atlas->bands[i];
+    if (y >= band.y && y < band.y + band.height) {
+      return (u16)i;
+    }
+  }
+  return 0;
+}
+
+static FontGlyph *get_glyph(FontFamily *font, float size, i32 charcode) {
+  if (font->sdf) {
+    size = FONT_SDF_BASE_SIZE;
+  }
+
+  u32 size_bits = 0;
+  memcpy(&size_bits, &size, sizeof(size_bits));
+  u64 key = ((u64)size_bits << 32) | (u32)charcode;
+
+  FontGlyph *glyph = font->glyphs.get(key);
+  if (glyph != nullptr) {
+    return glyph;
+  }
+
+  PROFILE_FUNC();
+
+  constexpr i32 padding = 1;
+
+  // distance field spread, in pixels outside the glyph outline
+  constexpr i32 sdf_spread = 6;
+  constexpr u8 sdf_onedge = 128;
+  constexpr float sdf_dist_scale = (float)sdf_onedge / sdf_spread;
+
+  stbtt_fontinfo *info = &font->info;
+  float scale = stbtt_ScaleForPixelHeight(info, size);
+  i32 g = stbtt_FindGlyphIndex(info, charcode);
+
+  i32 advance = 0;
+  i32 lsb = 0;
+  stbtt_GetGlyphHMetrics(info, g, &advance, &lsb);
+
+  i32 x0 = 0;
+  i32 y0 = 0;
+  i32 w = 0;
+  i32 h = 0;
+  u8 *bitmap = nullptr;
+
+  if (font->sdf) {
+    bitmap = stbtt_GetGlyphSDF(info, scale, g, sdf_spread, sdf_onedge,
+                               sdf_dist_scale, &w, &h, &x0, &y0);
+  } else {
+    i32 x1 = 0;
+    i32 y1 = 0;
+    stbtt_GetGlyphBitmapBox(info, g, scale, scale, &x0, &y0, &x1, &y1);
+    w = x1 - x0;
+    h = y1 - y0;
+
+    if (w > 0 && h > 0) {
+      bitmap = (u8 *)mem_alloc(w * h);
+      stbtt_MakeGlyphBitmap(info, bitmap, w, h, w, scale, scale, g);
+    }
+  }
+
+  defer({
+    if (font->sdf) {
+      stbtt_FreeSDF(bitmap, nullptr);
+    } else {
+      mem_free(bitmap);
+    }
+  });
+
+  // too big for any atlas, so it's drawn as empty space
+  if (w + padding > FONT_ATLAS_MAX_SIZE || h + padding > FONT_ATLAS_MAX_SIZE) {
+    w = 0;
+    h = 0;
+  }
+
+  FontAtlas *atlas = &font->atlas;
+  if (atlas->width == 0) {
+    atlas->width = 256;
+  }
+
+  i32 px = 0;
+  i32 py = 0;
+  while (!shelf_pack(font, w + padding, h + padding, &px, &py)) {
+    if (atlas->width < FONT_ATLAS_MAX_SIZE) {
+      remake_atlas(font, atlas->width * 2, true);
+    } else {
+      remake_atlas(font, atlas->width, false);
+    }
   }
 
-  return range;
+  u16 band = band_at(atlas, py);
+  if (bitmap != nullptr && w > 0 && h > 0) {
+    for (i32 y = 0; y < h; y++) {
+      u8 *row = &atlas->pixels[((py + y) * atlas->width + px) * 4];
+      for (i32 x = 0; x < w; x++) {
+        row[x * 4 + 3] = bitmap[y * w + x];
+      }
+    }
+    mark_dirty(font, &atlas->bands[band]);
+  }
+
+  FontGlyph fg = {};
+  fg.x0 = (u16)px;
+  fg.y0 = (u16)py;
+  fg.x1 = (u16)(px + w);
+  fg.y1 = (u16)(py + h);
+  fg.band = band;
+  fg.xoff = (float)x0;
+  fg.yoff = (float)y0;
+  fg.xadvance = scale * advance;
+
+  glyph = &font->glyphs[key];
+  *glyph = fg;
+  return glyph;
 }
 
 stbtt_aligned_quad FontFamily::quad(u32 *img, float *x, float *y, float size,
                                     i32 ch) {
-  FontRange *range = get_range(this, font_key(size, ch));
-  assert(range != nullptr);
+  FontGlyph *g = get_glyph(this, size, ch);
+  FontBand band = atlas.bands[g->band];
 
-  ch = ch % array_size(FontRange::chars);
+  float ipw = 1.0f / atlas.width;
+  float iph = 1.0f / band.height;
 
-  float xpos = 0;
-  float ypos = 0;
   stbtt_aligned_quad q = {};
-  stbtt_GetBakedQuad(range->chars, (i32)range->image.width,
-                     (i32)range->image.height, ch, &xpos, &ypos, &q, 1);
+  q.s0 = g->x0 * ipw;
+  q.t0 = (g->y0 - band.y) * iph;
+  q.s1 = g->x1 * ipw;
+  q.t1 = (g->y1 - band.y) * iph;
 
-  stbtt_bakedchar *baked = range->chars + ch;
-  *img = range->image.id;
-  *x = *x + baked->xadvance;
+  if (sdf) {
+    // scaled from the base size, so positions aren't snapped to pixels
+    float k = size / FONT_SDF_BASE_SIZE;
+    q.x0 = g->xoff * k;
+    q.y0 = g->yoff * k;
+    q.x1 = (g->xoff + g->x1 - g->x0) * k;
+    q.y1 = (g->yoff + g->y1 - g->y0) * k;
+
+    *img = band.image;
+    *x = *x + g->xadvance * k;
+    return q;
+  }
+
+  // same as stbtt_GetBakedQuad, with opengl fill rule
+  float round_x = floorf(g->xoff + 0.5f);
+  float round_y = floorf(g->yoff + 0.5f);
+  q.x0 = round_x;
+  q.y0 = round_y;
+  q.x1 = round_x + g->x1 - g->x0;
+  q.y1 = round_y + g->y1 - g->y0;
+
+  *img = band.image;
+  *x = *x + g->xadvance;
   return q;
 }
 
 float FontFamily::width(float size, String text) {
   float width = 0;
   for (Rune r : UTF8(text)) {
-    u32 code = r.charcode();
-    FontRange *range = get_range(this, font_key(size, code));
-    assert(range != nullptr);
+    FontGlyph *g = get_glyph(this, size, r.charcode());
+    width += g->xadvance;
+  }
 
-    const stbtt_bakedchar *baked =
-        range->chars + (code % array_size(FontRange::chars));
-    width += baked->xadvance;
+  if (sdf) {
+    width *= size / FONT_SDF_BASE_SIZE;
   }
   return width;
 }
+
+void font_upload_atlases() {
+  PROFILE_FUNC();
+
+  for (FontFamily *font : g_dirty_fonts) {
+    for (FontBand &band : font->atlas.bands) {
+      if (band.dirty) {
+        upload_band(&font->atlas, &band);
+      }
+    }
+    font->atlas.dirty = false;
+  }
+  g_dirty_fonts.len = 0;
+
+  u64 frame = renderer_frame();
+  for (u64 i = 0; i < g_retired.len;) {
+    if (g_retired[i].frame < frame) {
+      sg_destroy_image({g_retired[i].id});
+      g_retired[i] = g_retired[g_retired.len - 1];
+      g_retired.len--;
+    } else {
+      i++;
+    }
+  }
+}
+
+void font_shutdown() {
+  for (RetiredFontImage retired : g_retired) {
+    sg_destroy_image({retired.id});
+  }
+  for (auto [id, use] : g_image_use) {
+    if (use->retired) {
+      sg_destroy_image({(u32)id});
+    }
+  }
+
+  g_retired.trash();
+  g_image_use.trash();
+  g_dirty_fonts.trash();
+}
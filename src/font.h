@@ -1,28 +1,73 @@
 #pragma once
 
+#include "array.h"
 #include "deps/stb_truetype.h"
 #include "hash_map.h"
 #include "image.h"
 #include "strings.h"
+#include "vfs.h"
 
-struct FontRange {
-  stbtt_bakedchar chars[256];
-  Image image;
+struct FontGlyph {
+  u16 x0, y0, x1, y1; // rect in the atlas, in pixels
+  u16 band;           // index into FontAtlas::bands
+  float xoff, yoff;
+  float xadvance;
 };
 
-struct FontQuad {
-  stbtt_aligned_quad quad;
+struct FontShelf {
+  i32 x;
+  i32 y;
+  i32 height;
 };
 
+// rows of the atlas with a texture of their own, so a new glyph only
+// uploads the band it's in
+struct FontBand {
+  u32 image;
+  i32 y; // first row in the atlas
+  i32 height;
+  bool dirty;
+};
+
+// glyphs for every size of a font, packed on demand. the atlas grows down a
+// band at a time, then wider, which replaces every band's texture.
+struct FontAtlas {
+  i32 width;
+  i32 height; // rows covered by bands
+  u8 *pixels; // rgba, dirty bands are copied to the gpu once per frame
+  Array<FontBand> bands;
+  Array<FontShelf> shelves;
+  i32 next_y;
+  bool dirty;
+  u32 generation; // changes when glyph rects and textures are replaced
+};
+
+// size that signed distance field glyphs are rasterized at. they're scaled
+// to the requested size when drawn.
+constexpr float FONT_SDF_BASE_SIZE = 48;
+
 struct FontFamily {
-  String ttf;
-  HashMap<FontRange> ranges;
+  FileView ttf; // stb_truetype reads glyphs from it as needed
+  stbtt_fontinfo info;
+  HashMap<FontGlyph> glyphs; // key: size, codepoint
+  FontAtlas atlas;
   StringBuilder sb;
+  bool sdf; // one distance field glyph per codepoint, drawn at any size
 
-  bool load(String filepath);
+  bool load(String filepath, bool sdf = false);
   void load_default();
   void trash();
 
   stbtt_aligned_quad quad(u32 *img, float *x, float *y, float size, i32 ch);
   float width(float size, String text);
-};
\ No newline at end of file
+};
+
+// upload glyphs rasterized this frame, and destroy replaced textures no
+// longer drawn. the caller holds the gpu lock.
+void font_upload_atlases();
+void font_shutdown();
+
+// retained text holds the atlas textures it draws with, so a texture
+// replaced when the atlas grows is kept until the text is released
+void font_retain_image(u32 id);
+void font_release_image(u32 id);
@@ -1,33 +1,623 @@
 #include "image.h"
+#include "algebra.h"
 #include "app.h"
 #include "deps/sokol_gfx.h"
 #include "deps/stb_image.h"
 #include "deps/stb_image_resize2.h"
+#include "jobs.h"
 #include "profile.h"
+#include "texture_cache.h"
 #include "vfs.h"
+#include <math.h>
 #include <stdio.h>
 
-bool Image::load(String filepath, bool generate_mips) {
+// number of mip levels make_mips creates, including the base level
+static i32 mip_count(i32 width, i32 height) {
+  i32 count = 1;
+  for (i32 w = width / 2, h = height / 2; w > 1 && h > 1; w /= 2, h /= 2) {
+    count++;
+  }
+  return count;
+}
+
+static bool g_srgb_mips;
+static float g_srgb_to_linear[256];
+static u8 g_linear_to_srgb[4096];
+
+void image_set_srgb_mips(bool srgb) {
+  g_srgb_mips = srgb;
+  if (!srgb) {
+    return;
+  }
+
+  for (i32 i = 0; i < 256; i++) {
+    float c = i / 255.0f;
+    g_srgb_to_linear[i] =
+        c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+  }
+
+  for (i32 i = 0; i < 4096; i++) {
+    float l = i / 4095.0f;
+    float c = l <= 0.0031308f ? l * 12.92f
+                              : 1.055f * powf(l, 1 / 2.4f) - 0.055f;
+    g_linear_to_srgb[i] = (u8)(c * 255 + 0.5f);
+  }
+}
+
+// rows y0 to y1 and columns x0 to x1 of a mip level that's half the size
+// of src, for a job
+struct MipBand {
+  const u8 *src;
+  i32 src_width;
+  u8 *dst;
+  i32 dst_width;
+  i32 y0;
+  i32 y1;
+  i32 x0;
+  i32 x1;
+};
+
+static void box_filter_srgb(MipBand *band) {
+  for (i32 y = band->y0; y < band->y1; y++) {
+    const u8 *a = &band->src[(y * 2) * band->src_width * 4];
+    const u8 *b = a + band->src_width * 4;
+    u8 *out = &band->dst[y * band->dst_width * 4];
+
+    for (i32 x = band->x0; x < band->x1; x++) {
+      const u8 *p = &a[x * 8];
+      const u8 *q = &b[x * 8];
+      for (i32 c = 0; c < 3; c++) {
+        float sum = g_srgb_to_linear[p[c]] + g_srgb_to_linear[p[c + 4]] +
+                    g_srgb_to_linear[q[c]] + g_srgb_to_linear[q[c + 4]];
+        out[x * 4 + c] = g_linear_to_srgb[(i32)(sum * (4095 / 4.0f) + 0.5f)];
+      }
+      out[x * 4 + 3] = (u8)((p[3] + p[7] + q[3] + q[7] + 2) >> 2);
+    }
+  }
+}
+
+static void box_filter(MipBand *band) {
+  if (g_srgb_mips) {
+    box_filter_srgb(band);
+    return;
+  }
+
+  for (i32 y = band->y0; y < band->y1; y++) {
+    const u8 *a = &band->src[(y * 2) * band->src_width * 4];
+    const u8 *b = a + band->src_width * 4;
+    u8 *out = &band->dst[y * band->dst_width * 4];
+
+    i32 x = band->x0;
+
+#ifdef SSE_AVAILABLE
+    // four source pixels from each row make two output pixels
+    __m128i zero = _mm_setzero_si128();
+    __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= band->x1; x += 2) {
+      __m128i ra = _mm_loadu_si128((const __m128i *)&a[x * 8]);
+      __m128i rb = _mm_loadu_si128((const __m128i *)&b[x * 8]);
+
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(ra, zero),
+                                 _mm_unpacklo_epi8(rb, zero));
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(ra, zero),
+                                 _mm_unpackhi_epi8(rb, zero));
+
+      lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+      hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+      __m128i sum = _mm_unpacklo_epi64(lo, hi);
+      sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+      _mm_storel_epi64((__m128i *)&out[x * 4], _mm_packus_epi16(sum, sum));
+    }
+#endif
+
+    for (; x < band->x1; x++) {
+      const u8 *p = &a[x * 8];
+      const u8 *q = &b[x * 8];
+      for (i32 c = 0; c < 4; c++) {
+        out[x * 4 + c] = (u8)((p[c] + p[c + 4] + q[c] + q[c + 4] + 2) >> 2);
+      }
+    }
+  }
+}
+
+static void box_filter_job(void *udata) { box_filter((MipBand *)udata); }
+
+// halve an image with even width and height. big levels are split into
+// bands of rows, shared between the calling thread and the job workers.
+static void downsample(const u8 *src, i32 src_width, u8 *dst, i32 dst_width,
+                       i32 dst_height) {
+  constexpr i32 max_bands = 64;
+  constexpr i32 min_band_pixels = 64 * 1024;
+
+  i32 bands = jobs_worker_count() + 1;
+  i32 by_size = (dst_width * dst_height) / min_band_pixels;
+  bands = bands < by_size ? bands : by_size;
+  bands = bands < max_bands ? bands : max_bands;
+  if (bands < 1) {
+    bands = 1;
+  }
+
+  MipBand work[max_bands] = {};
+  i32 rows = (dst_height + bands - 1) / bands;
+  for (i32 i = 0; i < bands; i++) {
+    work[i].src = src;
+    work[i].src_width = src_width;
+    work[i].dst = dst;
+    work[i].dst_width = dst_width;
+    work[i].y0 = i * rows < dst_height ? i * rows : dst_height;
+    work[i].y1 = (i + 1) * rows < dst_height ? (i + 1) * rows : dst_height;
+    work[i].x0 = 0;
+    work[i].x1 = dst_width;
+  }
+
+  JobGroup group = {};
+  for (i32 i = 1; i < bands; i++) {
+    jobs_run(box_filter_job, &work[i], &group);
+  }
+  box_filter(&work[0]);
+  jobs_wait(&group);
+}
+
+// fill data->subimage[0][1..] with a mip chain made from the base level.
+// the mip levels are pushed to mips, for the caller to free.
+static void make_mips(sg_image_data *data, u8 *base, i32 width, i32 height,
+                      Array<u8 *> *mips) {
+  mips->reserve(SG_MAX_MIPMAPS);
+
+  u8 *prev = base;
+  i32 w0 = width;
+  i32 h0 = height;
+  i32 w1 = w0 / 2;
+  i32 h1 = h0 / 2;
+
+  while (w1 > 1 && h1 > 1) {
+    PROFILE_BLOCK("generate mip");
+
+    u8 *mip = (u8 *)mem_alloc(w1 * h1 * 4);
+    if (w0 % 2 == 0 && h0 % 2 == 0) {
+      downsample(prev, w0, mip, w1, h1);
+    } else {
+      stbir_resize_uint8_linear(prev, w0, h0, 0, mip, w1, h1, 0, STBIR_RGBA);
+    }
+    mips->push(mip);
+
+    data->subimage[0][mips->len].ptr = mip;
+    data->subimage[0][mips->len].size = w1 * h1 * 4;
+
+    prev = mip;
+    w0 = w1;
+    h0 = h1;
+    w1 /= 2;
+    h1 /= 2;
+  }
+}
+
+struct PageShelf {
+  i32 x;
+  i32 y;
+  i32 height;
+};
+
+// an image's space in a page. freed slots are reused by images that fit.
+struct PageSlot {
+  i32 x;
+  i32 y;
+  i32 w;
+  i32 h;
+  bool used;
+};
+
+// a texture shared by many small images. pixels are kept on the cpu and
+// copied to the gpu once per frame when dirty. the page is destroyed when
+// the last image in it is.
+struct ImagePage {
+  u32 id;
+  u8 *levels[SG_MAX_MIPMAPS]; // rgba, levels[0] is the page itself
+  i32 num_levels;
+  bool mips;
+  bool dirty;
+  i32 dirty_x0, dirty_y0, dirty_x1, dirty_y1; // changed since the upload
+  Array<PageShelf> shelves;
+  Array<PageSlot> slots;
+  i32 next_y;
+  i32 images; // slots in use
+};
+
+struct ImagePacker {
+  Mutex mtx;
+  i32 max_size; // 0 when packing is off
+  i32 page_size;
+  Array<ImagePage *> pages;
+};
+
+static ImagePacker g_packer;
+
+// space around each packed image, filled with copies of its edge pixels so
+// filtering doesn't pull in neighbours. pages with mipmaps also keep images
+// on multiples of the gutter, so the first few mip levels stay separate.
+constexpr i32 PAGE_GUTTER = 1;
+constexpr i32 PAGE_MIP_GUTTER = 8;
+
+void image_pack_setup(i32 max_size, i32 page_size) {
+  g_packer.mtx.make();
+  g_packer.page_size = page_size;
+  g_packer.max_size = max_size < page_size ? max_size : page_size;
+}
+
+static void free_page(ImagePage *page) {
+  for (i32 i = 0; i < page->num_levels; i++) {
+    mem_free(page->levels[i]);
+  }
+  page->shelves.trash();
+  page->slots.trash();
+  mem_free(page);
+}
+
+void image_pack_shutdown() {
+  {
+    LockGuard lock{&g_app->gpu_mtx};
+    for (ImagePage *page : g_packer.pages) {
+      sg_destroy_image({page->id});
+    }
+  }
+
+  for (ImagePage *page : g_packer.pages) {
+    free_page(page);
+  }
+  g_packer.pages.trash();
+  g_packer.mtx.trash();
+}
+
+struct MakeImage {
+  const sg_image_desc *desc;
+  u32 id;
+};
+
+static void make_image(void *udata) {
+  MakeImage *mi = (MakeImage *)udata;
+
+  LockGuard lock{&g_app->gpu_mtx};
+  mi->id = sg_make_image(mi->desc).id;
+}
+
+u32 image_make_gpu(const sg_image_desc *desc) {
+  MakeImage mi = {};
+  mi.desc = desc;
+  jobs_run_on_main(make_image, &mi);
+  return mi.id;
+}
+
+static ImagePage *make_page(bool mips) {
+  i32 size = g_packer.page_size;
+
+  sg_image_desc desc = {};
+  desc.width = size;
+  desc.height = size;
+  desc.usage = SG_USAGE_DYNAMIC;
+  desc.num_mipmaps = mips ? mip_count(size, size) : 1;
+
+  ImagePage *page = (ImagePage *)mem_alloc(sizeof(ImagePage));
+  *page = {};
+  page->mips = mips;
+  page->num_levels = desc.num_mipmaps;
+  for (i32 i = 0; i < page->num_levels; i++) {
+    i32 level = size >> i;
+    page->levels[i] = (u8 *)mem_alloc(level * level * 4);
+    memset(page->levels[i], 0, level * level * 4);
+  }
+
+  page->id = image_make_gpu(&desc);
+
+  printf("created image page with id %d (%dx%d, mipmaps: %s)\n", page->id,
+         size, size, mips ? "true" : "false");
+  return page;
+}
+
+static bool shelf_pack(ImagePage *page, i32 w, i32 h, i32 *x, i32 *y) {
+  i32 size = g_packer.page_size;
+
+  for (PageShelf &shelf : page->shelves) {
+    if (h <= shelf.height && h * 4 >= shelf.height * 3 &&
+        shelf.x + w <= size) {
+      *x = shelf.x;
+      *y = shelf.y;
+      shelf.x += w;
+      return true;
+    }
+  }
+
+  if (page->next_y + h > size || w > size) {
+    return false;
+  }
+
+  PageShelf shelf = {};
+  shelf.x = w;
+  shelf.y = page->next_y;
+  shelf.height = h;
+  page->shelves.push(shelf);
+  page->next_y += h;
+
+  *x = 0;
+  *y = shelf.y;
+  return true;
+}
+
+// find space for a w by h slot, reusing a freed slot that isn't much bigger
+static bool page_alloc(ImagePage *page, i32 w, i32 h, i32 *slot) {
+  for (u64 i = 0; i < page->slots.len; i++) {
+    PageSlot *s = &page->slots[i];
+    if (!s->used && w <= s->w && h <= s->h && w * h * 2 >= s->w * s->h) {
+      s->used = true;
+      page->images++;
+      *slot = (i32)i;
+      return true;
+    }
+  }
+
+  PageSlot s = {};
+  if (!shelf_pack(page, w, h, &s.x, &s.y)) {
+    return false;
+  }
+  s.w = w;
+  s.h = h;
+  s.used = true;
+  page->slots.push(s);
+  page->images++;
+  *slot = (i32)page->slots.len - 1;
+  return true;
+}
+
+// copy an image into its slot, extruding the edges into the gutter
+static void page_blit(ImagePage *page, i32 x, i32 y, i32 gutter, u8 *data,
+                      i32 width, i32 height) {
+  i32 size = g_packer.page_size;
+
+  for (i32 row = -gutter; row < height + gutter; row++) {
+    i32 sy = row < 0 ? 0 : (row >= height ? height - 1 : row);
+    u8 *dst = &page->levels[0][((y + gutter + row) * size + x + gutter) * 4];
+    u8 *src = &data[sy * width * 4];
+
+    memcpy(dst, src, width * 4);
+    for (i32 col = 1; col <= gutter; col++) {
+      memcpy(&dst[-col * 4], &src[0], 4);
+      memcpy(&dst[(width - 1 + col) * 4], &src[(width - 1) * 4], 4);
+    }
+  }
+
+  i32 x1 = x + width + gutter * 2;
+  i32 y1 = y + height + gutter * 2;
+  if (!page->dirty) {
+    page->dirty = true;
+    page->dirty_x0 = x;
+    page->dirty_y0 = y;
+    page->dirty_x1 = x1;
+    page->dirty_y1 = y1;
+  } else {
+    page->dirty_x0 = x < page->dirty_x0 ? x : page->dirty_x0;
+    page->dirty_y0 = y < page->dirty_y0 ? y : page->dirty_y0;
+    page->dirty_x1 = x1 > page->dirty_x1 ? x1 : page->dirty_x1;
+    page->dirty_y1 = y1 > page->dirty_y1 ? y1 : page->dirty_y1;
+  }
+}
+
+static bool pack_image(Image *img, u8 *data, i32 width, i32 height,
+                       bool mips) {
+  PROFILE_FUNC();
+
+  i32 gutter = mips ? PAGE_MIP_GUTTER : PAGE_GUTTER;
+  i32 w = (width + gutter * 2 + gutter - 1) / gutter * gutter;
+  i32 h = (height + gutter * 2 + gutter - 1) / gutter * gutter;
+  if (w > g_packer.page_size || h > g_packer.page_size) {
+    return false;
+  }
+
+  ImagePage *page = nullptr;
+  i32 slot = 0;
+  i32 x = 0;
+  i32 y = 0;
+
+  {
+    LockGuard lock{&g_packer.mtx};
+    for (ImagePage *p : g_packer.pages) {
+      if (p->mips == mips && page_alloc(p, w, h, &slot)) {
+        page = p;
+        x = page->slots[slot].x;
+        y = page->slots[slot].y;
+        page_blit(page, x, y, gutter, data, width, height);
+        break;
+      }
+    }
+  }
+
+  if (page == nullptr) {
+    // made without the packer lock, since the gpu lock is taken before the
+    // packer lock when pages are uploaded
+    page = make_page(mips);
+
+    LockGuard lock{&g_packer.mtx};
+    g_packer.pages.push(page);
+    page_alloc(page, w, h, &slot);
+    x = page->slots[slot].x;
+    y = page->slots[slot].y;
+    page_blit(page, x, y, gutter, data, width, height);
+  }
+
+  float size = (float)g_packer.page_size;
+
+  Image packed = {};
+  packed.id = page->id;
+  packed.width = width;
+  packed.height = height;
+  packed.has_mips = mips;
+  packed.packed = true;
+  packed.slot = slot;
+  packed.page_width = g_packer.page_size;
+  packed.page_height = g_packer.page_size;
+  packed.u0 = (x + gutter) / size;
+  packed.v0 = (y + gutter) / size;
+  packed.u1 = (x + gutter + width) / size;
+  packed.v1 = (y + gutter + height) / size;
+  *img = packed;
+  return true;
+}
+
+// remake the part of each mip level under the page's dirty rect
+static void update_page_mips(ImagePage *page) {
+  PROFILE_FUNC();
+
+  i32 w0 = g_packer.page_size;
+  i32 h0 = g_packer.page_size;
+  i32 x0 = page->dirty_x0;
+  i32 y0 = page->dirty_y0;
+  i32 x1 = page->dirty_x1;
+  i32 y1 = page->dirty_y1;
+
+  for (i32 i = 1; i < page->num_levels; i++) {
+    i32 w1 = w0 / 2;
+    i32 h1 = h0 / 2;
+
+    if (w0 % 2 != 0 || h0 % 2 != 0) {
+      // odd sizes are resampled whole, and so is every level after
+      stbir_resize_uint8_linear(page->levels[i - 1], w0, h0, 0,
+                                page->levels[i], w1, h1, 0, STBIR_RGBA);
+      x0 = 0;
+      y0 = 0;
+      x1 = w1;
+      y1 = h1;
+    } else {
+      x0 /= 2;
+      y0 /= 2;
+      x1 = (x1 + 1) / 2 < w1 ? (x1 + 1) / 2 : w1;
+      y1 = (y1 + 1) / 2 < h1 ? (y1 + 1) / 2 : h1;
+
+      MipBand band = {};
+      band.src = page->levels[i - 1];
+      band.src_width = w0;
+      band.dst = page->levels[i];
+      band.dst_width = w1;
+      band.y0 = y0;
+      band.y1 = y1;
+      band.x0 = x0;
+      band.x1 = x1;
+      box_filter(&band);
+    }
+
+    w0 = w1;
+    h0 = h1;
+  }
+}
+
+// give back an image's slot, and destroy the page if it was the last one
+static void unpack_image(u32 id, i32 slot) {
+  ImagePage *dead = nullptr;
+
+  {
+    LockGuard lock{&g_packer.mtx};
+    for (u64 i = 0; i < g_packer.pages.len; i++) {
+      ImagePage *page = g_packer.pages[i];
+      if (page->id != id) {
+        continue;
+      }
+
+      page->slots[slot].used = false;
+      page->images--;
+      if (page->images == 0) {
+        dead = page;
+        g_packer.pages[i] = g_packer.pages[g_packer.pages.len - 1];
+        g_packer.pages.len--;
+      }
+      break;
+    }
+  }
+
+  if (dead != nullptr) {
+    {
+      LockGuard lock{&g_app->gpu_mtx};
+      sg_destroy_image({dead->id});
+    }
+    free_page(dead);
+  }
+}
+
+void image_pack_upload() {
+  if (g_packer.max_size == 0) {
+    return;
+  }
+
   PROFILE_FUNC();
 
-  String contents = {};
-  bool ok = vfs_read_entire_file(&contents, filepath);
+  i32 size = g_packer.page_size;
+
+  LockGuard lock{&g_packer.mtx};
+  for (ImagePage *page : g_packer.pages) {
+    if (!page->dirty) {
+      continue;
+    }
+
+    update_page_mips(page);
+
+    sg_image_data data = {};
+    for (i32 i = 0; i < page->num_levels; i++) {
+      i32 level = size >> i;
+      data.subimage[0][i].ptr = page->levels[i];
+      data.subimage[0][i].size = level * level * 4;
+    }
+
+    sg_update_image({page->id}, data);
+    page->dirty = false;
+  }
+}
+
+bool Image::load(String filepath, bool generate_mips, bool pack) {
+  PROFILE_FUNC();
+
+  FileView view = {};
+  bool ok = vfs_view_file(&view, filepath);
   if (!ok) {
     return false;
   }
-  defer(mem_free(contents.data));
+  defer(vfs_release_view(&view));
+  String contents = view.contents;
+
+  u64 key = texture_cache_key(contents, g_srgb_mips ? 1 : 0);
+
+  CachedTexture cached = {};
+  defer(cached.trash());
+  bool hit = texture_cache_read(key, &cached);
 
   i32 width = 0, height = 0, channels = 0;
   stbi_uc *data = nullptr;
-  {
+  if (hit) {
+    width = cached.width;
+    height = cached.height;
+    channels = 4;
+    data = cached.levels[0];
+  } else {
     PROFILE_BLOCK("stb_image load");
     data = stbi_load_from_memory((u8 *)contents.data, (i32)contents.len, &width,
                                  &height, &channels, 4);
+    if (!data) {
+      return false;
+    }
   }
-  if (!data) {
-    return false;
+  defer({
+    if (!hit) {
+      stbi_image_free(data);
+    }
+  });
+
+  if (pack && width <= g_packer.max_size && height <= g_packer.max_size) {
+    if (pack_image(this, data, width, height, generate_mips)) {
+      if (!hit) {
+        texture_cache_write(key, width, height, &data, 1);
+      }
+
+      printf("packed image (%dx%d, %d channels, mipmaps: %s) into page %d\n",
+             width, height, channels, generate_mips ? "true" : "false", id);
+      return true;
+    }
   }
-  defer(stbi_image_free(data));
 
   sg_image_desc desc = {};
   desc.pixel_format = SG_PIXELFORMAT_RGBA8;
@@ -44,40 +634,34 @@ bool Image::load(String filepath, bool generate_mips) {
     mips.trash();
   });
 
-  if (generate_mips) {
-    mips.reserve(SG_MAX_MIPMAPS);
-
-    u8 *prev = data;
-    i32 w0 = width;
-    i32 h0 = height;
-    i32 w1 = w0 / 2;
-    i32 h1 = h0 / 2;
-
-    while (w1 > 1 && h1 > 1) {
-      PROFILE_BLOCK("generate mip");
+  i32 num_levels = generate_mips ? mip_count(width, height) : 1;
+  bool write_cache = !hit;
 
-      u8 *mip = (u8 *)mem_alloc(w1 * h1 * 4);
-      stbir_resize_uint8_linear(prev, w0, h0, 0, mip, w1, h1, 0, STBIR_RGBA);
-      mips.push(mip);
+  if (hit && cached.num_levels >= num_levels) {
+    // the cache has the mip chain already
+    for (i32 i = 1; i < num_levels; i++) {
+      desc.data.subimage[0][i].ptr = cached.levels[i];
+      desc.data.subimage[0][i].size = (width >> i) * (height >> i) * 4;
+    }
+  } else if (generate_mips) {
+    make_mips(&desc.data, data, width, height, &mips);
+    write_cache = true;
+  }
 
-      desc.data.subimage[0][mips.len].ptr = mip;
-      desc.data.subimage[0][mips.len].size = w1 * h1 * 4;
+  desc.num_mipmaps = num_levels;
 
-      prev = mip;
-      w0 = w1;
-      h0 = h1;
-      w1 /= 2;
-      h1 /= 2;
+  if (write_cache) {
+    u8 *levels[SG_MAX_MIPMAPS] = {};
+    for (i32 i = 0; i < num_levels; i++) {
+      levels[i] = (u8 *)desc.data.subimage[0][i].ptr;
     }
+    texture_cache_write(key, width, height, levels, num_levels);
   }
 
-  desc.num_mipmaps = mips.len + 1;
-
   u32 id = 0;
   {
     PROFILE_BLOCK("make image");
-    LockGuard lock{&g_app->gpu_mtx};
-    id = sg_make_image(desc).id;
+    id = image_make_gpu(&desc);
   }
 
   Image img = {};
@@ -87,12 +671,60 @@ bool Image::load(String filepath, bool generate_mips) {
   img.has_mips = generate_mips;
   *this = img;
 
-  printf("created image (%dx%d, %d channels, mipmaps: %s) with id %d\n", width,
-         height, channels, generate_mips ? "true" : "false", id);
+  printf("created image (%dx%d, %d channels, mipmaps: %s%s) with id %d\n",
+         width, height, channels, generate_mips ? "true" : "false",
+         hit ? ", cached" : "", id);
   return true;
 }
 
 void Image::trash() {
+  // the page owns the texture
+  if (packed) {
+    unpack_image(id, slot);
+    return;
+  }
+
   LockGuard lock{&g_app->gpu_mtx};
   sg_destroy_image({id});
 }
+
+u64 Image::memory_size() const {
+  i32 w = width;
+  i32 h = height;
+  if (packed) {
+    i32 gutter = has_mips ? PAGE_MIP_GUTTER : PAGE_GUTTER;
+    w = (width + gutter * 2 + gutter - 1) / gutter * gutter;
+    h = (height + gutter * 2 + gutter - 1) / gutter * gutter;
+  }
+
+  u64 bytes = (u64)w * (u64)h * 4;
+  return has_mips ? bytes * 4 / 3 : bytes;
+}
+
+Image Image::texture() const {
+  if (!packed) {
+    return *this;
+  }
+
+  Image tex = {};
+  tex.id = id;
+  tex.width = page_width;
+  tex.height = page_height;
+  tex.has_mips = has_mips;
+  return tex;
+}
+
+void Image::uvs(float *u0, float *v0, float *u1, float *v1) const {
+  if (!packed) {
+    *u0 = 0;
+    *v0 = 0;
+    *u1 = 1;
+    *v1 = 1;
+    return;
+  }
+
+  *u0 = this->u0;
+  *v0 = this->v0;
+  *u1 = this->u1;
+  *v1 = this->v1;
+}
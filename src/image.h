@@ -2,12 +2,48 @@
 
 #include "prelude.h"
 
+struct sg_image_desc;
+
 struct Image {
   u32 id;
   i32 width;
   i32 height;
   bool has_mips;
 
-  bool load(String filepath, bool generate_mips);
+  // for images packed into a shared page, id is the page texture, which is
+  // page_width by page_height, and u0, v0, u1, v1 is the image's part of it
+  bool packed;
+  i32 slot; // the image's space in the page, given back by trash
+  i32 page_width;
+  i32 page_height;
+  float u0, v0, u1, v1;
+
+  // if pack is true and packing is on, small images go into a shared page
+  bool load(String filepath, bool generate_mips, bool pack = false);
   void trash();
-};
\ No newline at end of file
+
+  // gpu memory used by the image. a packed image counts its slot in the
+  // page, which is given back when it's trashed.
+  u64 memory_size() const;
+
+  // the texture this image is drawn from, and the image's uv rect in it.
+  // for images that aren't packed, that's the image itself and 0, 0, 1, 1.
+  Image texture() const;
+  void uvs(float *u0, float *v0, float *u1, float *v1) const;
+};
+
+// images up to max_size pixels wide and high are packed into pages of
+// page_size pixels. packing is off if max_size is 0.
+void image_pack_setup(i32 max_size, i32 page_size);
+void image_pack_shutdown();
+
+// average mipmap texels in linear space instead of in srgb. off by default.
+void image_set_srgb_mips(bool srgb);
+
+// upload pages that changed this frame. the caller holds the gpu lock.
+void image_pack_upload();
+
+// creates a texture under the gpu lock. on a job worker, the main thread
+// creates it, so decoding can run on the workers while the gpu is only
+// touched from the main thread.
+u32 image_make_gpu(const sg_image_desc *desc);
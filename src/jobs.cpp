@@ -0,0 +1,163 @@
+#include "jobs.h"
+#include "array.h"
+#include "os.h"
+#include "profile.h"
+#include "queue.h"
+#include "sync.h"
+
+struct Job {
+  JobProc fn;
+  void *udata;
+  JobGroup *group;
+};
+
+struct MainCall {
+  JobProc fn;
+  void *udata;
+  bool done;
+};
+
+struct Jobs {
+  Queue<Job> queue;
+  Array<Thread> threads;
+  std::atomic<i32> running;
+
+  Mutex main_mtx;
+  Cond main_done;
+  Array<MainCall *> main_calls;
+};
+
+static Jobs g_jobs;
+static thread_local bool t_worker;
+
+static void run_job(Job job) {
+  job.fn(job.udata);
+  if (job.group != nullptr) {
+    job.group->pending.fetch_sub(1);
+  }
+}
+
+static void job_worker(void *) {
+  PROFILE_FUNC();
+
+  t_worker = true;
+  while (true) {
+    Job job = g_jobs.queue.demand();
+    if (job.fn == nullptr) {
+      g_jobs.running.fetch_sub(1);
+      return;
+    }
+
+    run_job(job);
+  }
+}
+
+void jobs_setup(i32 count) {
+  if (count <= 0) {
+    count = os_cpu_count() - 1;
+  }
+
+  g_jobs.main_mtx.make();
+  g_jobs.main_done.make();
+  g_jobs.queue.make();
+  g_jobs.running.store(count);
+  g_jobs.threads.resize(count);
+  for (Thread &t : g_jobs.threads) {
+    t.make(job_worker, nullptr);
+  }
+}
+
+void jobs_shutdown() {
+  // one empty job per worker, each worker stops at the first it sees
+  for (u64 i = 0; i < g_jobs.threads.len; i++) {
+    g_jobs.queue.enqueue({});
+  }
+
+  // jobs still queued might be waiting on the main thread
+  while (g_jobs.running.load() != 0) {
+    jobs_run_main_calls();
+    os_yield();
+  }
+
+  for (Thread &t : g_jobs.threads) {
+    t.join();
+  }
+
+  g_jobs.threads.trash();
+  g_jobs.queue.trash();
+  g_jobs.main_calls.trash();
+  g_jobs.main_done.trash();
+  g_jobs.main_mtx.trash();
+}
+
+i32 jobs_worker_count() { return (i32)g_jobs.threads.len; }
+
+void jobs_run(JobProc fn, void *udata, JobGroup *group) {
+  Job job = {};
+  job.fn = fn;
+  job.udata = udata;
+  job.group = group;
+
+  if (group != nullptr) {
+    group->pending.fetch_add(1);
+  }
+
+  if (g_jobs.threads.len == 0) {
+    run_job(job);
+    return;
+  }
+
+  g_jobs.queue.enqueue(job);
+}
+
+void jobs_wait(JobGroup *group) {
+  PROFILE_FUNC();
+
+  while (group->pending.load() != 0) {
+    Job job = {};
+    if (g_jobs.queue.try_demand(&job)) {
+      if (job.fn == nullptr) {
+        // shutting down, put it back for a worker
+        g_jobs.queue.enqueue(job);
+        os_yield();
+      } else {
+        run_job(job);
+      }
+    } else {
+      os_yield();
+    }
+  }
+}
+
+void jobs_run_on_main(JobProc fn, void *udata) {
+  if (!t_worker) {
+    fn(udata);
+    return;
+  }
+
+  MainCall call = {};
+  call.fn = fn;
+  call.udata = udata;
+
+  LockGuard lock{&g_jobs.main_mtx};
+  g_jobs.main_calls.push(&call);
+  while (!call.done) {
+    g_jobs.main_done.wait(&g_jobs.main_mtx);
+  }
+}
+
+void jobs_run_main_calls() {
+  PROFILE_FUNC();
+
+  LockGuard lock{&g_jobs.main_mtx};
+  if (g_jobs.main_calls.len == 0) {
+    return;
+  }
+
+  for (MainCall *call : g_jobs.main_calls) {
+    call->fn(call->udata);
+    call->done = true;
+  }
+  g_jobs.main_calls.len = 0;
+  g_jobs.main_done.broadcast();
+}
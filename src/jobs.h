@@ -0,0 +1,37 @@
+#pragma once
+
+#include "prelude.h"
+#include <atomic>
+
+// a pool of worker threads for work that can be split up, like decoding
+// and mipmap generation. jobs run in the order they're queued.
+
+typedef void (*JobProc)(void *udata);
+
+// jobs that can be waited on together
+struct JobGroup {
+  std::atomic<u64> pending;
+};
+
+// count is the number of worker threads, or 0 for one less than the number
+// of cores
+void jobs_setup(i32 count);
+void jobs_shutdown();
+i32 jobs_worker_count();
+
+// queues fn to run on a worker. group can be null. if there are no workers,
+// fn runs right away on the calling thread.
+void jobs_run(JobProc fn, void *udata, JobGroup *group);
+
+// blocks until every job in the group is done. the calling thread runs
+// queued jobs while it waits, so this can be called from a job too.
+void jobs_wait(JobGroup *group);
+
+// runs fn on the main thread and blocks until it's done, for the parts of a
+// job that have to happen there, like creating gpu resources. off the job
+// workers, fn runs right away on the calling thread.
+void jobs_run_on_main(JobProc fn, void *udata);
+
+// runs the calls queued by jobs_run_on_main. called by the main thread once
+// per frame, without the gpu lock held.
+void jobs_run_main_calls();
@@ -1,6 +1,7 @@
 #include "luax.h"
 #include "app.h"
 #include "profile.h"
+#include "script_cache.h"
 #include "strings.h"
 #include "vfs.h"
 
@@ -14,8 +15,9 @@ static const char *g_bootstrap =
     ;
 
 void luax_run_bootstrap(lua_State *L) {
-  if (luaL_loadbuffer(L, g_bootstrap, strlen(g_bootstrap), "bootstrap.lua") !=
-      LUA_OK) {
+  // compiled once, then loaded as bytecode by the states made for threads
+  String contents = {(char *)g_bootstrap, strlen(g_bootstrap)};
+  if (script_cache_load(L, contents, "bootstrap.lua") != LUA_OK) {
     fprintf(stderr, "%s\n", lua_tostring(L, -1));
     panic("failed to load bootstrap");
   }
@@ -35,15 +37,16 @@ i32 luax_require_script(lua_State *L, String filepath) {
   String path = to_cstr(filepath);
   defer(mem_free(path.data));
 
-  String contents;
-  bool ok = vfs_read_entire_file(&contents, filepath);
+  FileView view = {};
+  bool ok = vfs_view_file(&view, filepath);
   if (!ok) {
     StringBuilder sb = {};
     defer(sb.trash());
     fatal_error(String(sb << "failed to read file: " << filepath));
     return LUA_REFNIL;
   }
-  defer(mem_free(contents.data));
+  defer(vfs_release_view(&view));
+  String contents = view.contents;
 
   lua_newtable(L);
   i32 module_table = lua_gettop(L);
@@ -51,7 +54,7 @@ i32 luax_require_script(lua_State *L, String filepath) {
   {
     PROFILE_BLOCK("load lua script");
 
-    if (luaL_loadbuffer(L, contents.data, contents.len, path.data) != LUA_OK) {
+    if (script_cache_load(L, contents, path.data) != LUA_OK) {
       fatal_error(luax_check_string(L, -1));
       return LUA_REFNIL;
     }
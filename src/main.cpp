@@ -11,12 +11,17 @@
 #include "deps/sokol_time.h"
 #include "draw.h"
 #include "font.h"
+#include "jobs.h"
 #include "luax.h"
 #include "microui.h"
 #include "os.h"
 #include "prelude.h"
 #include "profile.h"
+#include "script_cache.h"
+#include "startup_bench.h"
 #include "sync.h"
+#include "text.h"
+#include "texture_cache.h"
 #include "vfs.h"
 
 extern "C" {
@@ -25,12 +30,13 @@ extern "C" {
 }
 
 static Mutex g_init_mtx;
-static sgl_pipeline g_pipeline;
 
 static void init() {
   PROFILE_FUNC();
   LockGuard lock(&g_init_mtx);
 
+  startup_bench_phase("sokol");
+
   {
     PROFILE_BLOCK("sokol");
 
@@ -39,19 +45,11 @@ static void init() {
     sg.context = sapp_sgcontext();
     sg_setup(sg);
 
-    sgl_desc_t sgl = {};
-    sgl.logger.func = slog_func;
-    sgl_setup(sgl);
-
-    sg_pipeline_desc sg_pipline = {};
-    sg_pipline.depth.write_enabled = true;
-    sg_pipline.colors[0].blend.enabled = true;
-    sg_pipline.colors[0].blend.src_factor_rgb = SG_BLENDFACTOR_SRC_ALPHA;
-    sg_pipline.colors[0].blend.dst_factor_rgb =
-        SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
-    g_pipeline = sgl_make_pipeline(sg_pipline);
+    renderer_setup();
   }
 
+  startup_bench_phase("miniaudio");
+
   {
     PROFILE_BLOCK("miniaudio");
 
@@ -67,6 +65,8 @@ static void init() {
     }
   }
 
+  startup_bench_phase("microui");
+
   microui_init();
 
   renderer_reset();
@@ -74,6 +74,8 @@ static void init() {
   g_app->time.startup = stm_now();
   g_app->time.last = stm_now();
 
+  startup_bench_phase("spry.start");
+
   {
     PROFILE_BLOCK("spry.start");
 
@@ -98,6 +100,8 @@ static void init() {
   lua_channels_setup();
   assets_start_hot_reload();
 
+  startup_bench_phase("first_frame");
+
 #ifndef NDEBUG
   printf("end of init\n");
 #endif
@@ -130,10 +134,11 @@ static void event(const sapp_event *e) {
 static void render() {
   PROFILE_FUNC();
 
+  sg_pass_action pass = {};
+
   {
     PROFILE_BLOCK("begin render pass");
 
-    sg_pass_action pass = {};
     pass.colors[0].load_action = SG_LOADACTION_CLEAR;
     pass.colors[0].store_action = SG_STOREACTION_STORE;
     if (g_app->error_mode.load()) {
@@ -147,16 +152,7 @@ static void render() {
       pass.colors[0].clear_value.a = rgba[3];
     }
 
-    {
-      LockGuard lock{&g_app->gpu_mtx};
-      sg_begin_default_pass(pass, sapp_width(), sapp_height());
-    }
-
-    sgl_defaults();
-    sgl_load_pipeline(g_pipeline);
-
-    sgl_viewport(0, 0, sapp_width(), sapp_height(), true);
-    sgl_ortho(0, sapp_widthf(), sapp_heightf(), 0, -1, 1);
+    renderer_begin(sapp_width(), sapp_height());
   }
 
   if (g_app->error_mode.load()) {
@@ -210,14 +206,13 @@ static void render() {
     PROFILE_BLOCK("end render pass");
     LockGuard lock{&g_app->gpu_mtx};
 
-    sgl_draw();
+    renderer_flush(&pass);
 
-    sgl_error_t sgl_err = sgl_error();
+    i32 sgl_err = renderer_sgl_error();
     if (sgl_err != SGL_NO_ERROR) {
       panic("a draw error occurred: %d", sgl_err);
     }
 
-    sg_end_pass();
     sg_commit();
   }
 }
@@ -277,6 +272,8 @@ static void frame() {
   g_app->gpu_mtx.unlock();
   render();
   assets_perform_hot_reload_changes();
+  jobs_run_main_calls();
+  assets_collect();
   g_app->gpu_mtx.lock();
 
   memcpy(g_app->prev_key_state, g_app->key_state, sizeof(g_app->key_state));
@@ -302,6 +299,11 @@ static void frame() {
       i++;
     }
   }
+
+  if (startup_bench_active()) {
+    startup_bench_finish();
+    sapp_request_quit();
+  }
 }
 
 static void actually_cleanup() {
@@ -332,12 +334,14 @@ static void actually_cleanup() {
   {
     PROFILE_BLOCK("destroy assets");
 
+    jobs_shutdown();
     lua_channels_shutdown();
 
     if (g_app->default_font != nullptr) {
       g_app->default_font->trash();
       mem_free(g_app->default_font);
     }
+    text_cache_trash();
 
     for (Sound *sound : g_app->garbage_sounds) {
       sound->trash();
@@ -345,6 +349,10 @@ static void actually_cleanup() {
     g_app->garbage_sounds.trash();
 
     assets_shutdown();
+    font_shutdown();
+    image_pack_shutdown();
+    texture_cache_shutdown();
+    script_cache_shutdown();
   }
 
   {
@@ -355,8 +363,7 @@ static void actually_cleanup() {
 
   {
     PROFILE_BLOCK("destory sokol");
-    sgl_destroy_pipeline(g_pipeline);
-    sgl_shutdown();
+    renderer_shutdown();
     sg_shutdown();
   }
 
@@ -389,7 +396,7 @@ static void cleanup() {
   }
 #endif
 
-  allocator->trash();
+  g_allocator->trash();
   operator delete(g_allocator);
 
 #ifndef NDEBUG
@@ -406,6 +413,8 @@ static void setup_lua() {
   g_app->LA = LA;
   g_app->L = L;
 
+  startup_bench_count_lua(L);
+
   luaL_openlibs(L);
   open_spry_api(L);
   open_luasocket(L);
@@ -418,6 +427,61 @@ static void setup_lua() {
   luax_pcall(L, 0, 0);
 }
 
+struct CompileScripts {
+  Slice<String> files;
+};
+
+// parses scripts on a worker, so the main state only loads their bytecode
+// from the script cache
+static void compile_scripts(void *udata) {
+  PROFILE_FUNC();
+
+  CompileScripts *job = (CompileScripts *)udata;
+
+  LuaAlloc *LA = luaalloc_create(nullptr, nullptr);
+  defer(luaalloc_delete(LA));
+
+  lua_State *L = lua_newstate(luaalloc, LA);
+  defer(lua_close(L));
+
+  for (String file : job->files) {
+    FileView view = {};
+    if (!vfs_view_file(&view, file)) {
+      continue;
+    }
+    defer(vfs_release_view(&view));
+
+    // errors are reported when the main state compiles the script again
+    script_cache_load(L, view.contents, file.data);
+    lua_settop(L, 0);
+  }
+}
+
+static void compile_scripts_in_parallel(Slice<String> files) {
+  PROFILE_FUNC();
+
+  u64 count = jobs_worker_count() + 1;
+  if (count > files.len) {
+    count = files.len;
+  }
+
+  Array<CompileScripts> jobs = {};
+  defer(jobs.trash());
+  jobs.resize(count);
+
+  JobGroup group = {};
+  for (u64 i = 0; i < count; i++) {
+    u64 begin = files.len * i / count;
+    u64 end = files.len * (i + 1) / count;
+
+    jobs[i].files.data = &files.data[begin];
+    jobs[i].files.len = end - begin;
+    jobs_run(compile_scripts, &jobs[i], &group);
+  }
+
+  jobs_wait(&group);
+}
+
 static void load_all_lua_scripts(lua_State *L) {
   PROFILE_FUNC();
 
@@ -440,11 +504,22 @@ static void load_all_lua_scripts(lua_State *L) {
           return strcmp(lhs->data, rhs->data);
         });
 
+  Array<String> scripts = {};
+  defer(scripts.trash());
   for (String file : files) {
     if (file != "main.lua" && file.ends_with(".lua")) {
-      asset_load_kind(AssetKind_LuaRef, file, nullptr);
+      scripts.push(file);
     }
   }
+
+  if (jobs_worker_count() > 0 && scripts.len > 1) {
+    compile_scripts_in_parallel(Slice(scripts));
+  }
+
+  // run in sorted order, same as without the workers
+  for (String file : scripts) {
+    asset_load_kind(AssetKind_LuaRef, file, nullptr);
+  }
 }
 
 /* extern(app.h) */ App *g_app;
@@ -468,6 +543,35 @@ sapp_desc sokol_main(int argc, char **argv) {
   profile_setup();
   PROFILE_FUNC();
 
+  if (argc > 1 && strcmp(argv[1], "--pack") == 0) {
+    if (argc != 4) {
+      fprintf(stderr, "usage: %s --pack [directory] [output.spk]\n",
+              argv[0]);
+      exit(1);
+    }
+
+    bool ok = vfs_write_pack(argv[2], argv[3]);
+    exit(ok ? 0 : 1);
+  }
+
+  for (i32 i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench-startup") == 0) {
+      bool ok = startup_bench_run(argc, argv);
+      exit(ok ? 0 : 1);
+    }
+
+    if (strcmp(argv[i], "--bench-startup-run") == 0) {
+      startup_bench_start();
+
+      // the flag is for the engine. scripts see the args they were run with.
+      for (i32 j = i; j + 1 < argc; j++) {
+        argv[j] = argv[j + 1];
+      }
+      argc--;
+      i--;
+    }
+  }
+
   const char *mount_path = nullptr;
 
   for (i32 i = 1; i < argc; i++) {
@@ -480,22 +584,32 @@ sapp_desc sokol_main(int argc, char **argv) {
   g_app = (App *)mem_alloc(sizeof(App));
   memset(g_app, 0, sizeof(App));
 
+  script_cache_setup();
+
   g_app->args.resize(argc);
   for (i32 i = 0; i < argc; i++) {
     g_app->args[i] = to_cstr(argv[i]);
   }
 
+  startup_bench_phase("setup_lua");
+
   setup_lua();
   lua_State *L = g_app->L;
 
+  startup_bench_phase("vfs_mount");
+
   MountResult mount = vfs_mount(mount_path);
 
   g_app->is_fused.store(mount.is_fused);
 
+  startup_bench_phase("main.lua");
+
   if (!g_app->error_mode.load() && mount.ok) {
     asset_load_kind(AssetKind_LuaRef, "main.lua", nullptr);
   }
 
+  startup_bench_phase("spry.arg");
+
   if (!g_app->error_mode.load()) {
     luax_spry_get(L, "arg");
 
@@ -510,6 +624,8 @@ sapp_desc sokol_main(int argc, char **argv) {
     }
   }
 
+  startup_bench_phase("spry.conf");
+
   lua_newtable(L);
   i32 conf_table = lua_gettop(L);
 
@@ -532,9 +648,42 @@ sapp_desc sokol_main(int argc, char **argv) {
   lua_Number width = luax_opt_number_field(L, -1, "window_width", 800);
   lua_Number height = luax_opt_number_field(L, -1, "window_height", 600);
   String title = luax_opt_string_field(L, -1, "window_title", "Spry");
+  lua_Number text_cache_budget =
+      luax_opt_number_field(L, -1, "text_cache_budget", 1024 * 1024);
+  lua_Number max_vertices =
+      luax_opt_number_field(L, -1, "max_vertices", 1 << 16);
+  lua_Number max_commands =
+      luax_opt_number_field(L, -1, "max_commands", 1 << 14);
+  lua_Number image_pack_size =
+      luax_opt_number_field(L, -1, "image_pack_size", 0);
+  lua_Number image_page_size =
+      luax_opt_number_field(L, -1, "image_page_size", 2048);
+  String texture_cache = luax_opt_string_field(L, -1, "texture_cache", "");
+  lua_Number texture_cache_size = luax_opt_number_field(
+      L, -1, "texture_cache_size", 1024.0 * 1024 * 1024);
+  String script_cache = luax_opt_string_field(L, -1, "script_cache", "");
+  lua_Number script_cache_size =
+      luax_opt_number_field(L, -1, "script_cache_size", 64 * 1024 * 1024);
+  bool srgb_mipmaps = luax_boolean_field(L, -1, "srgb_mipmaps", false);
+  lua_Number worker_threads =
+      luax_opt_number_field(L, -1, "worker_threads", 0);
+  lua_Number asset_budget = luax_opt_number_field(L, -1, "asset_budget", 0);
 
   lua_pop(L, 1); // conf table
 
+  // before scripts load, so images they load at the top level are packed,
+  // cached and mipmapped the way the conf says
+  script_cache_set_dir(script_cache, (u64)script_cache_size);
+  jobs_setup((i32)worker_threads);
+  text_cache_set_budget((u64)text_cache_budget);
+  renderer_set_sgl_budget((i32)max_vertices, (i32)max_commands);
+  image_pack_setup((i32)image_pack_size, (i32)image_page_size);
+  texture_cache_setup(texture_cache, (u64)texture_cache_size);
+  image_set_srgb_mips(srgb_mipmaps);
+  assets_set_budget((u64)asset_budget);
+
+  startup_bench_phase("load_scripts");
+
   if (!g_app->error_mode.load() && startup_load_scripts && mount.ok) {
     load_all_lua_scripts(L);
   }
@@ -547,7 +696,8 @@ sapp_desc sokol_main(int argc, char **argv) {
   }
 
 #ifdef IS_WIN32
-  if (!g_app->win_console) {
+  // a startup run reports its phases on stdout
+  if (!g_app->win_console && !startup_bench_active()) {
     FreeConsole();
   }
 #endif
@@ -564,6 +714,8 @@ sapp_desc sokol_main(int argc, char **argv) {
   sapp.swap_interval = (i32)swap_interval;
   sapp.fullscreen = fullscreen;
 
+  startup_bench_phase("window");
+
 #ifndef NDEBUG
   printf("debug build\n");
 #endif
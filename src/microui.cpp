@@ -4,6 +4,7 @@
 #include "deps/sokol_app.h"
 #include "deps/sokol_gfx.h"
 #include "deps/sokol_gl.h"
+#include "draw.h"
 #include "luax.h"
 #include "prelude.h"
 
@@ -99,6 +100,13 @@ void microui_sokol_event(const sapp_event *e) {
 }
 
 static void mu_push_quad(mu_Rect dst, mu_Rect src, mu_Color color) {
+  if (!renderer_sgl_reserve(4, 1)) {
+    return;
+  }
+
+  // set every time, in case the reserve moved to a new sokol_gl context
+  sgl_enable_texture();
+  sgl_texture({g_mui_state.atlas}, {});
   sgl_begin_quads();
 
   float u0 = (float)src.x / (float)MU_ATLAS_WIDTH;
@@ -142,8 +150,7 @@ void microui_end_and_present() {
 
   mu_end(g_mui_state.ctx);
 
-  sgl_enable_texture();
-  sgl_texture({g_mui_state.atlas}, {});
+  renderer_flush_queue();
 
   {
     mu_Command *cmd = 0;
@@ -176,7 +183,8 @@ void microui_end_and_present() {
       }
       case MU_COMMAND_CLIP: {
         mu_Rect rect = cmd->clip.rect;
-        sgl_scissor_rect(rect.x, rect.y, rect.w, rect.h, true);
+        renderer_scissor_rect((float)rect.x, (float)rect.y, (float)rect.w,
+                              (float)rect.h);
         break;
       }
       default: break;
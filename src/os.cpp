@@ -1,4 +1,8 @@
 #include "os.h"
+#include "array.h"
+#include "strings.h"
+#include <stdio.h>
+#include <stdlib.h>
 
 #if defined(IS_WIN32)
 #include <direct.h>
@@ -9,15 +13,38 @@
 #include <unistd.h>
 
 #elif defined(IS_LINUX)
+#include "hash_map.h"
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
 #include <sched.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
+extern char **environ;
+
 #endif
 
 i32 os_change_dir(const char *path) { return chdir(path); }
 
+struct DirFile {
+  String path; // dir/name
+  u64 size;
+  u64 modtime; // same units as os_file_modtime
+};
+
+// files directly in dir, not in its subdirectories
+static void list_files(const char *dir, Array<DirFile> *out);
+
 String os_program_dir() {
   String str = os_program_path();
   char *buf = str.data;
@@ -72,10 +99,195 @@ u64 os_file_modtime(const char *filename) {
   return time.QuadPart;
 }
 
+i32 os_make_dir(const char *path) { return _mkdir(path); }
+
 void os_high_timer_resolution() { timeBeginPeriod(8); }
 void os_sleep(u32 ms) { Sleep(ms); }
 void os_yield() { YieldProcessor(); }
 
+i32 os_cpu_count() {
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+  return (i32)info.dwNumberOfProcessors;
+}
+
+bool os_map_file(const char *filename, String *out) {
+  // editors can still save over the file while it's mapped
+  DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+  HANDLE file = CreateFile(filename, GENERIC_READ, share, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  defer(CloseHandle(file));
+
+  LARGE_INTEGER size = {};
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    return false;
+  }
+
+  // the view keeps the mapping alive after its handle is closed
+  HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    return false;
+  }
+  defer(CloseHandle(mapping));
+
+  void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (ptr == nullptr) {
+    return false;
+  }
+
+  *out = {(char *)ptr, (u64)size.QuadPart};
+  return true;
+}
+
+void os_unmap_file(String view) { UnmapViewOfFile(view.data); }
+
+void os_touch_file(const char *filename) {
+  HANDLE handle = CreateFile(filename, FILE_WRITE_ATTRIBUTES,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, 0, NULL);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  defer(CloseHandle(handle));
+
+  FILETIME now = {};
+  GetSystemTimeAsFileTime(&now);
+  SetFileTime(handle, nullptr, nullptr, &now);
+}
+
+static void list_files(const char *dir, Array<DirFile> *out) {
+  char pattern[1024] = {};
+  snprintf(pattern, sizeof(pattern), "%s/*", dir);
+
+  WIN32_FIND_DATAA data = {};
+  HANDLE find = FindFirstFileA(pattern, &data);
+  if (find == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  defer(FindClose(find));
+
+  do {
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      continue;
+    }
+
+    char path[1024] = {};
+    snprintf(path, sizeof(path), "%s/%s", dir, data.cFileName);
+
+    ULARGE_INTEGER size = {};
+    size.LowPart = data.nFileSizeLow;
+    size.HighPart = data.nFileSizeHigh;
+
+    ULARGE_INTEGER time = {};
+    time.LowPart = data.ftLastWriteTime.dwLowDateTime;
+    time.HighPart = data.ftLastWriteTime.dwHighDateTime;
+
+    DirFile file = {};
+    file.path = to_cstr(path);
+    file.size = size.QuadPart;
+    file.modtime = time.QuadPart;
+    out->push(file);
+  } while (FindNextFileA(find, &data));
+}
+
+u64 os_page_size() {
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+}
+
+// quotes an argument so CommandLineToArgvW and the CRT read it back as is.
+// backslashes only need doubling when they end up before a quote.
+static void quote_arg(StringBuilder &sb, const char *arg) {
+  sb << "\"";
+  for (const char *c = arg;; c++) {
+    u64 backslashes = 0;
+    while (*c == '\\') {
+      backslashes++;
+      c++;
+    }
+
+    if (*c == 0) {
+      for (u64 i = 0; i < backslashes * 2; i++) {
+        sb << "\\";
+      }
+      break;
+    }
+
+    if (*c == '"') {
+      backslashes = backslashes * 2 + 1;
+    }
+    for (u64 i = 0; i < backslashes; i++) {
+      sb << "\\";
+    }
+    sb << String{(char *)c, 1};
+  }
+  sb << "\"";
+}
+
+bool os_run_capture(const char **argv, String *out) {
+  StringBuilder cmd = {};
+  defer(cmd.trash());
+  for (i32 i = 0; argv[i] != nullptr; i++) {
+    if (i != 0) {
+      cmd << " ";
+    }
+    quote_arg(cmd, argv[i]);
+  }
+
+  SECURITY_ATTRIBUTES sa = {};
+  sa.nLength = sizeof(sa);
+  sa.bInheritHandle = TRUE;
+
+  HANDLE read_pipe = nullptr;
+  HANDLE write_pipe = nullptr;
+  if (!CreatePipe(&read_pipe, &write_pipe, &sa, 0)) {
+    return false;
+  }
+  defer(CloseHandle(read_pipe));
+  SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+
+  STARTUPINFOA si = {};
+  si.cb = sizeof(si);
+  si.dwFlags = STARTF_USESTDHANDLES;
+  si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+  si.hStdOutput = write_pipe;
+  si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+  PROCESS_INFORMATION pi = {};
+  bool ok = CreateProcessA(nullptr, cmd.data, nullptr, nullptr, TRUE, 0,
+                           nullptr, nullptr, &si, &pi);
+  // the child has its own copy. closing this one lets reads see the end.
+  CloseHandle(write_pipe);
+  if (!ok) {
+    return false;
+  }
+  defer(CloseHandle(pi.hProcess));
+  defer(CloseHandle(pi.hThread));
+
+  StringBuilder sb = {};
+  char buf[4096];
+  DWORD n = 0;
+  while (ReadFile(read_pipe, buf, sizeof(buf), &n, nullptr) && n > 0) {
+    sb << String{buf, n};
+  }
+
+  DWORD status = 1;
+  WaitForSingleObject(pi.hProcess, INFINITE);
+  GetExitCodeProcess(pi.hProcess, &status);
+
+  *out = String(sb);
+  return status == 0;
+}
+
+OSWatch *os_watch_dir(const char *path) { return nullptr; }
+void os_watch_trash(OSWatch *w) {}
+bool os_watch_wait(OSWatch *w, OSWatchProc fn, void *udata) { return false; }
+void os_watch_stop(OSWatch *w) {}
+
 #endif // IS_WIN32
 
 #ifdef IS_LINUX
@@ -96,6 +308,8 @@ u64 os_file_modtime(const char *filename) {
   }
 }
 
+i32 os_make_dir(const char *path) { return mkdir(path, 0755); }
+
 void os_high_timer_resolution() {}
 
 void os_sleep(u32 ms) {
@@ -107,14 +321,353 @@ void os_sleep(u32 ms) {
 
 void os_yield() { sched_yield(); }
 
+i32 os_cpu_count() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (i32)n : 1;
+}
+
+bool os_map_file(const char *filename, String *out) {
+  i32 fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  defer(close(fd));
+
+  struct stat st = {};
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    return false;
+  }
+
+  void *ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ptr == MAP_FAILED) {
+    return false;
+  }
+
+  *out = {(char *)ptr, (u64)st.st_size};
+  return true;
+}
+
+void os_unmap_file(String view) { munmap(view.data, view.len); }
+
+void os_touch_file(const char *filename) { utimes(filename, nullptr); }
+
+static void list_files(const char *dir, Array<DirFile> *out) {
+  DIR *d = opendir(dir);
+  if (d == nullptr) {
+    return;
+  }
+  defer(closedir(d));
+
+  while (struct dirent *entry = readdir(d)) {
+    char path[1024] = {};
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+    struct stat st = {};
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+
+    DirFile file = {};
+    file.path = to_cstr(path);
+    file.size = (u64)st.st_size;
+    file.modtime = (u64)st.st_mtime;
+    out->push(file);
+  }
+}
+
+u64 os_page_size() {
+  long n = sysconf(_SC_PAGESIZE);
+  return n > 0 ? (u64)n : 4096;
+}
+
+bool os_run_capture(const char **argv, String *out) {
+  i32 fds[2] = {};
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    return false;
+  }
+  defer(close(fds[0]));
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  defer(posix_spawn_file_actions_destroy(&actions));
+  posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+
+  pid_t pid = 0;
+  i32 err = posix_spawn(&pid, argv[0], &actions, nullptr, (char **)argv,
+                        environ);
+  close(fds[1]);
+  if (err != 0) {
+    return false;
+  }
+
+  StringBuilder sb = {};
+  char buf[4096];
+  ssize_t n = 0;
+  while ((n = read(fds[0], buf, sizeof(buf))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    sb << String{buf, (u64)n};
+  }
+
+  i32 status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+
+  *out = String(sb);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+struct OSWatch {
+  i32 fd;      // inotify
+  i32 stop_fd; // eventfd, written by os_watch_stop
+  HashMap<char *> dirs; // key: watch descriptor. value: "" or "dir/"
+  bool broken;          // a directory couldn't be watched
+};
+
+static constexpr u32 WATCH_MASK =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR;
+
+// inotify isn't recursive, so every directory gets its own watch
+static void watch_tree(OSWatch *w, const char *prefix) {
+  const char *path = prefix[0] == 0 ? "." : prefix;
+
+  i32 wd = inotify_add_watch(w->fd, path, WATCH_MASK);
+  if (wd < 0) {
+    // a directory removed while being walked is fine. anything else, like
+    // running out of watches, means changes would be missed.
+    if (errno != ENOENT) {
+      fprintf(stderr, "can't watch %s: %s\n", path, strerror(errno));
+      w->broken = true;
+    }
+    return;
+  }
+
+  char **existing = w->dirs.get(wd);
+  if (existing != nullptr) {
+    mem_free(*existing);
+  }
+  w->dirs[wd] = to_cstr(prefix).data;
+
+  DIR *dir = opendir(path);
+  if (dir == nullptr) {
+    return;
+  }
+  defer(closedir(dir));
+
+  while (struct dirent *entry = readdir(dir)) {
+    // skips . and .., and hidden directories like .git
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    char child[1024];
+    snprintf(child, sizeof(child), "%s%s/", prefix, entry->d_name);
+
+    bool is_dir = entry->d_type == DT_DIR;
+    if (entry->d_type == DT_UNKNOWN) {
+      struct stat st = {};
+      is_dir = stat(child, &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    if (is_dir) {
+      watch_tree(w, child);
+    }
+  }
+}
+
+OSWatch *os_watch_dir(const char *path) {
+  i32 fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  i32 stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (stop_fd < 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  OSWatch *w = (OSWatch *)mem_alloc(sizeof(OSWatch));
+  *w = {};
+  w->fd = fd;
+  w->stop_fd = stop_fd;
+
+  char prefix[1024] = "";
+  if (strcmp(path, ".") != 0) {
+    snprintf(prefix, sizeof(prefix), "%s/", path);
+  }
+  watch_tree(w, prefix);
+
+  if (w->broken || w->dirs.load == 0) {
+    os_watch_trash(w);
+    return nullptr;
+  }
+
+  return w;
+}
+
+void os_watch_trash(OSWatch *w) {
+  for (auto [k, v] : w->dirs) {
+    mem_free(*v);
+  }
+  w->dirs.trash();
+  close(w->stop_fd);
+  close(w->fd);
+  mem_free(w);
+}
+
+bool os_watch_wait(OSWatch *w, OSWatchProc fn, void *udata) {
+  struct pollfd fds[2] = {};
+  fds[0].fd = w->fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = w->stop_fd;
+  fds[1].events = POLLIN;
+
+  if (poll(fds, 2, -1) < 0) {
+    if (errno == EINTR) {
+      return true;
+    }
+    fprintf(stderr, "can't wait for file changes: %s\n", strerror(errno));
+    return false;
+  }
+
+  if (fds[1].revents != 0) {
+    return false;
+  }
+
+  alignas(struct inotify_event) char buf[4096];
+  ssize_t len = read(w->fd, buf, sizeof(buf));
+  if (len <= 0) {
+    return true;
+  }
+
+  for (char *p = buf; p < buf + len;) {
+    struct inotify_event *e = (struct inotify_event *)p;
+    p += sizeof(struct inotify_event) + e->len;
+
+    // events were dropped, so changes can't be trusted to show up anymore.
+    // polling catches up by comparing modtimes.
+    if (e->mask & IN_Q_OVERFLOW) {
+      fprintf(stderr, "too many file changes to watch\n");
+      return false;
+    }
+
+    if (e->mask & IN_IGNORED) {
+      char **dir = w->dirs.get(e->wd);
+      if (dir != nullptr) {
+        mem_free(*dir);
+        w->dirs.unset(e->wd);
+      }
+      continue;
+    }
+
+    char **dir = w->dirs.get(e->wd);
+    if (dir == nullptr || e->len == 0) {
+      continue;
+    }
+
+    char filepath[1024];
+    i32 n = snprintf(filepath, sizeof(filepath), "%s%s", *dir, e->name);
+    if (n <= 0 || n >= (i32)sizeof(filepath)) {
+      continue;
+    }
+
+    if (e->mask & IN_ISDIR) {
+      if (e->name[0] != '.') {
+        snprintf(filepath, sizeof(filepath), "%s%s/", *dir, e->name);
+        watch_tree(w, filepath);
+        if (w->broken) {
+          return false;
+        }
+      }
+      continue;
+    }
+
+    // files are reported when they're done being written, or when they're
+    // renamed into place. IN_CREATE alone is only for new directories.
+    if (e->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+      fn({filepath, (u64)n}, udata);
+    }
+  }
+
+  return true;
+}
+
+void os_watch_stop(OSWatch *w) {
+  u64 one = 1;
+  ssize_t n = write(w->stop_fd, &one, sizeof(one));
+  (void)n;
+}
+
 #endif // IS_LINUX
 
 #ifdef IS_HTML5
 
 String os_program_path() { return {}; }
 u64 os_file_modtime(const char *filename) { return 0; }
+i32 os_make_dir(const char *path) { return -1; }
 void os_high_timer_resolution() {}
 void os_sleep(u32 ms) {}
 void os_yield() {}
+i32 os_cpu_count() { return 1; }
+bool os_map_file(const char *filename, String *out) { return false; }
+void os_unmap_file(String view) {}
+void os_touch_file(const char *filename) {}
+static void list_files(const char *dir, Array<DirFile> *out) {}
+u64 os_page_size() { return 4096; }
+bool os_run_capture(const char **argv, String *out) { return false; }
+OSWatch *os_watch_dir(const char *path) { return nullptr; }
+void os_watch_trash(OSWatch *w) {}
+bool os_watch_wait(OSWatch *w, OSWatchProc fn, void *udata) { return false; }
+void os_watch_stop(OSWatch *w) {}
 
 #endif // IS_HTML5
+
+void os_prune_dir(const char *dir, const char *ext, u64 max_size) {
+  Array<DirFile> files = {};
+  defer({
+    for (DirFile file : files) {
+      mem_free(file.path.data);
+    }
+    files.trash();
+  });
+
+  Array<DirFile> all = {};
+  defer(all.trash());
+  list_files(dir, &all);
+
+  u64 total = 0;
+  for (DirFile file : all) {
+    if (file.path.ends_with(ext)) {
+      files.push(file);
+      total += file.size;
+    } else {
+      mem_free(file.path.data);
+    }
+  }
+
+  if (total <= max_size) {
+    return;
+  }
+
+  qsort(files.data, files.len, sizeof(DirFile),
+        [](const void *a, const void *b) -> int {
+          u64 lhs = ((DirFile *)a)->modtime;
+          u64 rhs = ((DirFile *)b)->modtime;
+          return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+        });
+
+  for (DirFile file : files) {
+    if (total <= max_size) {
+      break;
+    }
+
+    if (remove(file.path.data) == 0) {
+      total -= file.size;
+    }
+  }
+}
@@ -3,9 +3,50 @@
 #include "prelude.h"
 
 i32 os_change_dir(const char *path);
+i32 os_make_dir(const char *path); // 0 on success
 String os_program_dir();
 String os_program_path();
 u64 os_file_modtime(const char *filename);
 void os_high_timer_resolution();
 void os_sleep(u32 ms);
 void os_yield();
+i32 os_cpu_count();
+
+// maps a whole file into memory, read only. returns false if the file can't
+// be opened or mapped, or if mapping isn't supported.
+bool os_map_file(const char *filename, String *out);
+void os_unmap_file(String view);
+
+// the rest of a mapping's last page reads as zeros
+u64 os_page_size();
+
+// sets a file's modtime to now
+void os_touch_file(const char *filename);
+
+// deletes files in dir ending with ext, least recently modified first,
+// until the ones left take up at most max_size bytes. subdirectories are
+// left alone.
+void os_prune_dir(const char *dir, const char *ext, u64 max_size);
+
+// runs a program without a shell, and reads what it writes to stdout into
+// out. argv[0] is the program's path and argv ends with null. returns false
+// if the program couldn't run or exited with an error.
+bool os_run_capture(const char **argv, String *out);
+
+// watches a directory tree for files that are written, created or moved in.
+// only on linux. elsewhere, os_watch_dir returns null and callers should
+// fall back to polling modtimes.
+struct OSWatch;
+typedef void (*OSWatchProc)(String filepath, void *udata);
+OSWatch *os_watch_dir(const char *path);
+void os_watch_trash(OSWatch *w);
+
+// blocks until something changes, then calls fn with each changed file,
+// relative to the watched directory. returns false after os_watch_stop, or
+// when the watch stops working, like when a new directory can't be
+// watched or events were dropped. callers should fall back to polling
+// modtimes then.
+bool os_watch_wait(OSWatch *w, OSWatchProc fn, void *udata);
+
+// wakes os_watch_wait from another thread
+void os_watch_stop(OSWatch *w);
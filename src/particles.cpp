@@ -0,0 +1,240 @@
+#include "particles.h"
+#include "algebra.h"
+#include "assets.h"
+#include "profile.h"
+#include <math.h>
+#include <string.h>
+
+static constexpr i32 PARTICLE_ARRAYS = 8;
+static constexpr float PARTICLE_MIN_LIFE = 1e-6f;
+
+void ParticleEmitter::make(u64 cap) {
+  PROFILE_FUNC();
+
+  u64 padded = (cap + 3) & ~(u64)3;
+
+  // one allocation for every array
+  u64 bytes = sizeof(float) * padded * PARTICLE_ARRAYS;
+  float *data = (float *)mem_alloc(bytes);
+  memset(data, 0, bytes);
+
+  px = data + padded * 0;
+  py = data + padded * 1;
+  vx = data + padded * 2;
+  vy = data + padded * 3;
+  angle = data + padded * 4;
+  spin = data + padded * 5;
+  age = data + padded * 6;
+  age_rate = data + padded * 7;
+
+  len = 0;
+  capacity = cap;
+  emit_accum = 0;
+  rng = (u64)(uintptr_t)this | 1;
+
+  instances = {};
+  instances.make(cap);
+}
+
+void ParticleEmitter::trash() {
+  instances.trash();
+  mem_free(px);
+}
+
+void ParticleEmitter::clear() {
+  len = 0;
+  emit_accum = 0;
+}
+
+static float random_float(ParticleEmitter *e, float min, float max) {
+  // xorshift64
+  u64 x = e->rng;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  e->rng = x;
+
+  float t = (float)(x >> 40) / (float)(1 << 24);
+  return min + (max - min) * t;
+}
+
+void ParticleEmitter::emit(u64 count) {
+  for (u64 n = 0; n < count && len < capacity; n++) {
+    u64 i = len++;
+
+    float theta = direction + random_float(this, -spread, spread);
+    float speed = random_float(this, speed_min, speed_max);
+    // a zero lifetime would make age 0 / 0 when dt is 0, and NaN is never
+    // old enough to be removed
+    float life = random_float(this, life_min, life_max);
+    life = life > PARTICLE_MIN_LIFE ? life : PARTICLE_MIN_LIFE;
+
+    px[i] = x;
+    py[i] = y;
+    vx[i] = cosf(theta) * speed;
+    vy[i] = sinf(theta) * speed;
+    angle[i] = 0;
+    spin[i] = random_float(this, spin_min, spin_max);
+    age[i] = 0;
+    age_rate[i] = 1 / life;
+  }
+}
+
+static void remove_particle(ParticleEmitter *e, u64 i) {
+  u64 last = e->len - 1;
+  e->px[i] = e->px[last];
+  e->py[i] = e->py[last];
+  e->vx[i] = e->vx[last];
+  e->vy[i] = e->vy[last];
+  e->angle[i] = e->angle[last];
+  e->spin[i] = e->spin[last];
+  e->age[i] = e->age[last];
+  e->age_rate[i] = e->age_rate[last];
+  e->len--;
+}
+
+void ParticleEmitter::update(float dt) {
+  PROFILE_FUNC();
+
+  float dvx = ax * dt;
+  float dvy = ay * dt;
+
+  u64 i = 0;
+
+#ifdef SSE_AVAILABLE
+  __m128 vdt = _mm_set1_ps(dt);
+  __m128 vdvx = _mm_set1_ps(dvx);
+  __m128 vdvy = _mm_set1_ps(dvy);
+
+  // arrays are padded, so the last group can run past len
+  for (; i < len; i += 4) {
+    __m128 nvx = _mm_add_ps(_mm_loadu_ps(&vx[i]), vdvx);
+    __m128 nvy = _mm_add_ps(_mm_loadu_ps(&vy[i]), vdvy);
+    _mm_storeu_ps(&vx[i], nvx);
+    _mm_storeu_ps(&vy[i], nvy);
+
+    __m128 x = _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(nvx, vdt));
+    __m128 y = _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(nvy, vdt));
+    _mm_storeu_ps(&px[i], x);
+    _mm_storeu_ps(&py[i], y);
+
+    __m128 a = _mm_mul_ps(_mm_loadu_ps(&spin[i]), vdt);
+    _mm_storeu_ps(&angle[i], _mm_add_ps(_mm_loadu_ps(&angle[i]), a));
+
+    __m128 t = _mm_mul_ps(_mm_loadu_ps(&age_rate[i]), vdt);
+    _mm_storeu_ps(&age[i], _mm_add_ps(_mm_loadu_ps(&age[i]), t));
+  }
+#else
+  for (; i < len; i++) {
+    vx[i] += dvx;
+    vy[i] += dvy;
+    px[i] += vx[i] * dt;
+    py[i] += vy[i] * dt;
+    angle[i] += spin[i] * dt;
+    age[i] += age_rate[i] * dt;
+  }
+#endif
+
+  for (i = 0; i < len;) {
+    if (age[i] >= 1) {
+      remove_particle(this, i);
+    } else {
+      i++;
+    }
+  }
+
+  emit_accum += rate * dt;
+  if (emit_accum >= 1) {
+    u64 count = (u64)emit_accum;
+    emit_accum -= (float)count;
+    emit(count);
+  }
+}
+
+static u8 lerp_u8(u8 a, u8 b, float t) {
+  return (u8)(a + (b - a) * t + 0.5f);
+}
+
+static void write_instance(ParticleEmitter *e, u64 i, float ox, float oy,
+                           float scale, Color color) {
+  SpriteInstance *inst = &e->instances.instances[i];
+  inst->x = e->px[i];
+  inst->y = e->py[i];
+  inst->sx = scale;
+  inst->sy = scale;
+  inst->ox = ox;
+  inst->oy = oy;
+  inst->rotation = e->angle[i];
+  inst->u0 = 0;
+  inst->v0 = 0;
+  inst->u1 = 1;
+  inst->v1 = 1;
+  inst->color = color;
+}
+
+void ParticleEmitter::draw() {
+  PROFILE_FUNC();
+
+  if (image != 0) {
+    Asset a = {};
+    if (asset_read(image, &a)) {
+      img = a.image.texture();
+      a.image.uvs(&u0, &v0, &u1, &v1);
+    }
+  }
+
+  float ox = (u1 - u0) * img.width / 2;
+  float oy = (v1 - v0) * img.height / 2;
+
+  u64 i = 0;
+
+#ifdef SSE_AVAILABLE
+  __m128 s0 = _mm_set1_ps(scale_start);
+  __m128 ds = _mm_set1_ps(scale_end - scale_start);
+
+  u8 start[4] = {color_start.r, color_start.g, color_start.b, color_start.a};
+  u8 end[4] = {color_end.r, color_end.g, color_end.b, color_end.a};
+  __m128 c0[4];
+  __m128 dc[4];
+  for (i32 c = 0; c < 4; c++) {
+    // the 0.5 rounds when converted, like lerp_u8
+    c0[c] = _mm_set1_ps(start[c] + 0.5f);
+    dc[c] = _mm_set1_ps((float)(end[c] - start[c]));
+  }
+
+  // the instance buffer isn't padded, so the rest is done one at a time
+  for (; i + 4 <= len; i += 4) {
+    __m128 t = _mm_loadu_ps(&age[i]);
+
+    float scale[4];
+    _mm_storeu_ps(scale, _mm_add_ps(s0, _mm_mul_ps(ds, t)));
+
+    float rgba[4][4];
+    for (i32 c = 0; c < 4; c++) {
+      _mm_storeu_ps(rgba[c], _mm_add_ps(c0[c], _mm_mul_ps(dc[c], t)));
+    }
+
+    for (i32 k = 0; k < 4; k++) {
+      Color color = {(u8)rgba[0][k], (u8)rgba[1][k], (u8)rgba[2][k],
+                     (u8)rgba[3][k]};
+      write_instance(this, i + k, ox, oy, scale[k], color);
+    }
+  }
+#endif
+
+  for (; i < len; i++) {
+    float t = age[i];
+    float scale = scale_start + (scale_end - scale_start) * t;
+
+    Color color = {};
+    color.r = lerp_u8(color_start.r, color_end.r, t);
+    color.g = lerp_u8(color_start.g, color_end.g, t);
+    color.b = lerp_u8(color_start.b, color_end.b, t);
+    color.a = lerp_u8(color_start.a, color_end.a, t);
+    write_instance(this, i, ox, oy, scale, color);
+  }
+
+  instances.len = len;
+  instances.dirty = true;
+  instances.draw(img, u0, v0, u1, v1);
+}
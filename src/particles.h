@@ -0,0 +1,61 @@
+#pragma once
+
+#include "batch.h"
+#include "draw.h"
+#include "image.h"
+
+// particles that live and move in native code. lua sets up the emitter and
+// calls update and draw each frame.
+struct ParticleEmitter {
+  float x; // where new particles start
+  float y;
+  float rate; // particles emitted per second
+
+  float direction; // angle of the initial velocity, in radians
+  float spread;    // random offset from direction, in either way
+  float speed_min;
+  float speed_max;
+  float life_min; // in seconds
+  float life_max;
+  float spin_min; // angular velocity
+  float spin_max;
+  float ax; // acceleration
+  float ay;
+  float scale_start;
+  float scale_end;
+  Color color_start;
+  Color color_end;
+
+  u64 image; // index into assets, 0 if img is used as is
+  Image img;
+
+  // region of img drawn for each particle
+  float u0;
+  float v0;
+  float u1;
+  float v1;
+
+  // structure of arrays, with capacity padded to a multiple of 4 so the
+  // update loop can run four particles at a time
+  float *px;
+  float *py;
+  float *vx;
+  float *vy;
+  float *angle;
+  float *spin;
+  float *age;      // 0 at birth, 1 at death
+  float *age_rate; // 1 / lifetime
+  u64 len;
+  u64 capacity;
+
+  float emit_accum;
+  u64 rng;
+  InstanceBuffer instances;
+
+  void make(u64 cap);
+  void trash();
+  void clear();
+  void emit(u64 count);
+  void update(float dt);
+  void draw();
+};
@@ -1,6 +1,5 @@
 #include "physics.h"
 #include "deps/sokol_gfx.h"
-#include "deps/sokol_gl.h"
 #include "draw.h"
 #include "luax.h"
 #include <box2d/box2d.h>
@@ -223,10 +222,7 @@ void draw_fixtures_for_body(b2Body *body, float meter) {
       b2PolygonShape *poly = (b2PolygonShape *)f->GetShape();
 
       if (poly->m_count > 0) {
-        sgl_disable_texture();
-        sgl_begin_line_strip();
-
-        renderer_apply_color();
+        renderer_begin_prim(RendererPrim_LineStrip, SG_INVALID_ID);
 
         for (i32 i = 0; i < poly->m_count; i++) {
           b2Vec2 pos = body->GetWorldPoint(poly->m_vertices[i]);
@@ -236,7 +232,7 @@ void draw_fixtures_for_body(b2Body *body, float meter) {
         b2Vec2 pos = body->GetWorldPoint(poly->m_vertices[0]);
         renderer_push_xy(pos.x * meter, pos.y * meter);
 
-        sgl_end();
+        renderer_end_prim();
       }
       break;
     }
@@ -75,4 +75,18 @@ template <typename T> struct Queue {
 
     return item;
   }
+
+  bool try_demand(T *out) {
+    LockGuard lock{&mtx};
+
+    if (len == 0) {
+      return false;
+    }
+
+    *out = data[front];
+    front = (front + 1) % capacity;
+    len--;
+
+    return true;
+  }
 };
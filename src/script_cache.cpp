@@ -0,0 +1,280 @@
+#include "script_cache.h"
+#include "app.h"
+#include "hash_map.h"
+#include "os.h"
+#include "profile.h"
+#include "strings.h"
+#include "sync.h"
+#include "vfs.h"
+#include <stdio.h>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+struct ScriptCacheHeader {
+  u32 magic;
+  u32 version;
+  u64 key;
+  u64 size;
+};
+
+static constexpr u32 SCRIPT_CACHE_MAGIC = 0x434c5053; // "SPLC"
+static constexpr u32 SCRIPT_CACHE_VERSION = 1;
+
+struct ScriptCache {
+  Mutex mtx;
+  HashMap<String> chunks;
+  HashMap<u64> names; // key: hash of chunk name. value: key in chunks
+  String dir;
+};
+
+static ScriptCache g_script_cache;
+
+void script_cache_setup() { g_script_cache.mtx.make(); }
+
+void script_cache_shutdown() {
+  for (auto [k, v] : g_script_cache.chunks) {
+    mem_free(v->data);
+  }
+  g_script_cache.chunks.trash();
+  g_script_cache.names.trash();
+  mem_free(g_script_cache.dir.data);
+  g_script_cache.mtx.trash();
+  g_script_cache = {};
+}
+
+void script_cache_set_dir(String dir, u64 max_size) {
+  if (dir.len == 0) {
+    return;
+  }
+
+  os_make_dir(dir.data);
+
+  // entries are touched when read, so the ones pruned are the ones that
+  // haven't been used in the longest time, like old versions of scripts
+  os_prune_dir(dir.data, ".luac", max_size);
+
+  LockGuard lock{&g_script_cache.mtx};
+  mem_free(g_script_cache.dir.data);
+  g_script_cache.dir = to_cstr(dir);
+}
+
+// scripts can be loaded on any thread, so paths go in the caller's buffer
+static bool entry_path(char *buf, u64 len, u64 key) {
+  LockGuard lock{&g_script_cache.mtx};
+
+  if (g_script_cache.dir.len == 0) {
+    return false;
+  }
+
+  snprintf(buf, len, "%s/%016llx.luac", g_script_cache.dir.data,
+           (unsigned long long)key);
+  return true;
+}
+
+// loads under the lock, since another thread can evict the chunk as soon
+// as it's released
+static bool memory_load(lua_State *L, u64 key, const char *name) {
+  LockGuard lock{&g_script_cache.mtx};
+
+  String *chunk = g_script_cache.chunks.get(key);
+  if (chunk == nullptr) {
+    return false;
+  }
+
+  PROFILE_BLOCK("load bytecode");
+  if (luaL_loadbufferx(L, chunk->data, chunk->len, name, "b") != LUA_OK) {
+    lua_pop(L, 1);
+    return false;
+  }
+  return true;
+}
+
+// takes ownership of chunk, and frees it if another thread got there first.
+// a chunk from an older version of the same script is evicted, and its
+// entry on disk is deleted.
+static void memory_write(u64 key, u64 name_key, String chunk) {
+  char stale[1024] = {};
+
+  {
+    LockGuard lock{&g_script_cache.mtx};
+
+    if (g_script_cache.chunks.get(key) != nullptr) {
+      mem_free(chunk.data);
+      return;
+    }
+
+    g_script_cache.chunks[key] = chunk;
+
+    u64 *old = g_script_cache.names.get(name_key);
+    if (old != nullptr && *old != key) {
+      String *old_chunk = g_script_cache.chunks.get(*old);
+      if (old_chunk != nullptr) {
+        mem_free(old_chunk->data);
+        g_script_cache.chunks.unset(*old);
+      }
+
+      if (g_script_cache.dir.len != 0) {
+        snprintf(stale, sizeof(stale), "%s/%016llx.luac",
+                 g_script_cache.dir.data, (unsigned long long)*old);
+      }
+    }
+    g_script_cache.names[name_key] = key;
+  }
+
+  if (stale[0] != 0) {
+    remove(stale);
+  }
+}
+
+static bool parse_entry(String file, u64 key, String *out) {
+  ScriptCacheHeader header = {};
+  if (file.len < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, file.data, sizeof(header));
+
+  bool ok = header.magic == SCRIPT_CACHE_MAGIC &&
+            header.version == SCRIPT_CACHE_VERSION && header.key == key &&
+            header.size == file.len - sizeof(header);
+  if (!ok) {
+    return false;
+  }
+
+  *out = to_cstr({&file.data[sizeof(header)], header.size});
+  return true;
+}
+
+static bool disk_read(u64 key, String *out) {
+  char path[1024] = {};
+  if (!entry_path(path, sizeof(path), key)) {
+    return false;
+  }
+
+  PROFILE_FUNC();
+
+  // shipped with the game, or with a directory mount, the file on disk
+  FileView view = {};
+  if (vfs_view_file(&view, path)) {
+    defer(vfs_release_view(&view));
+    if (parse_entry(view.contents, key, out)) {
+      // entries in an archive can't be touched, and aren't pruned
+      if (!g_app->is_fused.load()) {
+        os_touch_file(path);
+      }
+      return true;
+    }
+  }
+
+  // made by an earlier run of a fused game
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  defer(fclose(f));
+
+  fseek(f, 0L, SEEK_END);
+  u64 size = (u64)ftell(f);
+  rewind(f);
+
+  char *buf = (char *)mem_alloc(size);
+  defer(mem_free(buf));
+  if (fread(buf, 1, size, f) != size) {
+    return false;
+  }
+
+  if (!parse_entry({buf, size}, key, out)) {
+    return false;
+  }
+
+  // marks the entry as used, so pruning keeps it
+  os_touch_file(path);
+  return true;
+}
+
+static void disk_write(u64 key, String chunk) {
+  char path[1024] = {};
+  if (!entry_path(path, sizeof(path), key)) {
+    return;
+  }
+
+  PROFILE_FUNC();
+
+  ScriptCacheHeader header = {};
+  header.magic = SCRIPT_CACHE_MAGIC;
+  header.version = SCRIPT_CACHE_VERSION;
+  header.key = key;
+  header.size = chunk.len;
+
+  // written under another name first, so a reader never sees half a file
+  char tmp[1024] = {};
+  snprintf(tmp, sizeof(tmp), "%s.%llu.tmp", path,
+           (unsigned long long)this_thread_id());
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == nullptr) {
+    return;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(chunk.data, 1, chunk.len, f) == chunk.len;
+  fclose(f);
+
+  if (!ok || rename(tmp, path) != 0) {
+    remove(tmp);
+  }
+}
+
+static i32 dump_writer(lua_State *L, const void *p, size_t sz, void *ud) {
+  StringBuilder *sb = (StringBuilder *)ud;
+  *sb << String{(char *)p, sz};
+  return 0;
+}
+
+i32 script_cache_load(lua_State *L, String contents, const char *name) {
+  PROFILE_FUNC();
+
+  // bytecode from another lua version fails to load, and is compiled again
+  u64 name_key = fnv1a(name, strlen(name));
+  u64 key = fnv1a(contents) ^ (name_key * 31) ^
+            ((u64)LUA_VERSION_NUM << 32) ^ SCRIPT_CACHE_VERSION;
+
+  if (memory_load(L, key, name)) {
+    return LUA_OK;
+  }
+
+  String chunk = {};
+  if (disk_read(key, &chunk)) {
+    PROFILE_BLOCK("load bytecode");
+    if (luaL_loadbufferx(L, chunk.data, chunk.len, name, "b") == LUA_OK) {
+      memory_write(key, name_key, chunk);
+      return LUA_OK;
+    }
+    lua_pop(L, 1);
+    mem_free(chunk.data);
+  }
+
+  {
+    PROFILE_BLOCK("compile source");
+    i32 res = luaL_loadbufferx(L, contents.data, contents.len, name, "t");
+    if (res != LUA_OK) {
+      return res;
+    }
+  }
+
+  StringBuilder sb = {};
+  lua_dump(L, dump_writer, &sb, 0);
+  if (sb.len == 0) {
+    sb.trash();
+    return LUA_OK;
+  }
+
+  String dumped = to_cstr(String(sb));
+  sb.trash();
+
+  disk_write(key, dumped);
+  memory_write(key, name_key, dumped);
+  return LUA_OK;
+}
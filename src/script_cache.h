@@ -0,0 +1,24 @@
+#pragma once
+
+#include "prelude.h"
+
+// compiled lua chunks, so scripts that haven't changed aren't parsed again.
+// chunks stay in memory until shutdown or until their script changes, which
+// covers the lua states made for threads, and are saved to disk if a
+// directory is set. entries are keyed by a hash of the source and the chunk
+// name.
+
+struct lua_State;
+
+void script_cache_setup();
+void script_cache_shutdown();
+
+// entries are saved in the given directory, which is made if needed. saving
+// is off if dir is empty. fused games also read entries from dir in the
+// mounted archive, so a cache made while developing can be shipped. entries
+// used least recently are deleted until the directory fits in max_size.
+void script_cache_set_dir(String dir, u64 max_size);
+
+// like luaL_loadbuffer, but loads the compiled chunk from the cache if there
+// is one, and adds it to the cache if there isn't
+i32 script_cache_load(lua_State *L, String contents, const char *name);
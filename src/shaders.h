@@ -0,0 +1,288 @@
+#pragma once
+
+// hand written shaders for draws that bypass sokol_gl. vertex uniforms are
+// passed as an array of vec4 so the same block layout works for every backend.
+// vs_params[0..3] is the model view projection matrix, vs_params[4] is the
+// draw color, and vs_params[5..6] are free for shaders that need more.
+//
+// the sgl vertex shaders match the vertex layout and uniforms of sokol_gl's
+// own shader, so they can be used in sokol_gl pipelines. vs_params[0..3] is
+// the model view projection matrix, vs_params[4..7] is the texture matrix.
+
+static const char *g_sprite_vs_glsl330 = R"glsl(#version 330
+uniform vec4 vs_params[7];
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texcoord0;
+layout(location = 2) in vec4 color0;
+out vec2 uv;
+out vec4 color;
+void main() {
+  mat4 mvp = mat4(vs_params[0], vs_params[1], vs_params[2], vs_params[3]);
+  gl_Position = mvp * vec4(position, 0.0, 1.0);
+  uv = texcoord0;
+  color = color0 * vs_params[4];
+}
+)glsl";
+
+static const char *g_sprite_fs_glsl330 = R"glsl(#version 330
+uniform sampler2D tex_smp;
+in vec2 uv;
+in vec4 color;
+layout(location = 0) out vec4 frag_color;
+void main() {
+  frag_color = texture(tex_smp, uv) * color;
+}
+)glsl";
+
+static const char *g_sprite_vs_glsl300es = R"glsl(#version 300 es
+uniform vec4 vs_params[7];
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texcoord0;
+layout(location = 2) in vec4 color0;
+out vec2 uv;
+out vec4 color;
+void main() {
+  mat4 mvp = mat4(vs_params[0], vs_params[1], vs_params[2], vs_params[3]);
+  gl_Position = mvp * vec4(position, 0.0, 1.0);
+  uv = texcoord0;
+  color = color0 * vs_params[4];
+}
+)glsl";
+
+static const char *g_sprite_fs_glsl300es = R"glsl(#version 300 es
+precision mediump float;
+uniform highp sampler2D tex_smp;
+in highp vec2 uv;
+in highp vec4 color;
+layout(location = 0) out highp vec4 frag_color;
+void main() {
+  frag_color = texture(tex_smp, uv) * color;
+}
+)glsl";
+
+static const char *g_sprite_vs_hlsl4 = R"hlsl(
+cbuffer vs_params : register(b0) {
+  row_major float4x4 mvp;
+  float4 tint;
+};
+struct vs_in {
+  float2 position : TEXCOORD0;
+  float2 texcoord0 : TEXCOORD1;
+  float4 color0 : TEXCOORD2;
+};
+struct vs_out {
+  float2 uv : TEXCOORD0;
+  float4 color : TEXCOORD1;
+  float4 pos : SV_Position;
+};
+vs_out main(vs_in inp) {
+  vs_out outp;
+  outp.pos = mul(float4(inp.position, 0.0, 1.0), mvp);
+  outp.uv = inp.texcoord0;
+  outp.color = inp.color0 * tint;
+  return outp;
+}
+)hlsl";
+
+static const char *g_sprite_fs_hlsl4 = R"hlsl(
+Texture2D<float4> tex : register(t0);
+SamplerState smp : register(s0);
+struct ps_in {
+  float2 uv : TEXCOORD0;
+  float4 color : TEXCOORD1;
+};
+float4 main(ps_in inp) : SV_Target0 {
+  return tex.Sample(smp, inp.uv) * inp.color;
+}
+)hlsl";
+
+// instanced quads. the vertex buffer is a unit quad, and each instance has
+// a position, scale, origin, rotation, uv rect and color. vs_params[5] is the
+// region of the texture the uv rect is relative to, as (u, v, width, height),
+// and vs_params[6].xy is the size of that region in pixels.
+
+static const char *g_instance_vs_glsl330 = R"glsl(#version 330
+uniform vec4 vs_params[7];
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 inst_xform;
+layout(location = 2) in vec3 inst_origin;
+layout(location = 3) in vec4 inst_uv;
+layout(location = 4) in vec4 inst_color;
+out vec2 uv;
+out vec4 color;
+void main() {
+  mat4 mvp = mat4(vs_params[0], vs_params[1], vs_params[2], vs_params[3]);
+  vec4 region = vs_params[5];
+  vec2 size = (inst_uv.zw - inst_uv.xy) * vs_params[6].xy;
+  vec2 p = (corner * size - inst_origin.xy) * inst_xform.zw;
+  float c = cos(inst_origin.z);
+  float s = sin(inst_origin.z);
+  p = inst_xform.xy + vec2(p.x * c - p.y * s, p.x * s + p.y * c);
+  gl_Position = mvp * vec4(p, 0.0, 1.0);
+  uv = region.xy + mix(inst_uv.xy, inst_uv.zw, corner) * region.zw;
+  color = inst_color * vs_params[4];
+}
+)glsl";
+
+static const char *g_instance_vs_glsl300es = R"glsl(#version 300 es
+uniform vec4 vs_params[7];
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 inst_xform;
+layout(location = 2) in vec3 inst_origin;
+layout(location = 3) in vec4 inst_uv;
+layout(location = 4) in vec4 inst_color;
+out vec2 uv;
+out vec4 color;
+void main() {
+  mat4 mvp = mat4(vs_params[0], vs_params[1], vs_params[2], vs_params[3]);
+  vec4 region = vs_params[5];
+  vec2 size = (inst_uv.zw - inst_uv.xy) * vs_params[6].xy;
+  vec2 p = (corner * size - inst_origin.xy) * inst_xform.zw;
+  float c = cos(inst_origin.z);
+  float s = sin(inst_origin.z);
+  p = inst_xform.xy + vec2(p.x * c - p.y * s, p.x * s + p.y * c);
+  gl_Position = mvp * vec4(p, 0.0, 1.0);
+  uv = region.xy + mix(inst_uv.xy, inst_uv.zw, corner) * region.zw;
+  color = inst_color * vs_params[4];
+}
+)glsl";
+
+static const char *g_instance_vs_hlsl4 = R"hlsl(
+cbuffer vs_params : register(b0) {
+  row_major float4x4 mvp;
+  float4 tint;
+  float4 region;
+  float4 region_size;
+};
+struct vs_in {
+  float2 corner : TEXCOORD0;
+  float4 inst_xform : TEXCOORD1;
+  float3 inst_origin : TEXCOORD2;
+  float4 inst_uv : TEXCOORD3;
+  float4 inst_color : TEXCOORD4;
+};
+struct vs_out {
+  float2 uv : TEXCOORD0;
+  float4 color : TEXCOORD1;
+  float4 pos : SV_Position;
+};
+vs_out main(vs_in inp) {
+  vs_out outp;
+  float2 size = (inp.inst_uv.zw - inp.inst_uv.xy) * region_size.xy;
+  float2 p = (inp.corner * size - inp.inst_origin.xy) * inp.inst_xform.zw;
+  float c = cos(inp.inst_origin.z);
+  float s = sin(inp.inst_origin.z);
+  p = inp.inst_xform.xy + float2(p.x * c - p.y * s, p.x * s + p.y * c);
+  outp.pos = mul(float4(p, 0.0, 1.0), mvp);
+  outp.uv = region.xy + lerp(inp.inst_uv.xy, inp.inst_uv.zw, inp.corner) *
+                            region.zw;
+  outp.color = inp.inst_color * tint;
+  return outp;
+}
+)hlsl";
+
+static const char *g_sgl_vs_glsl330 = R"glsl(#version 330
+uniform vec4 vs_params[8];
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 texcoord0;
+layout(location = 2) in vec4 color0;
+layout(location = 3) in float psize;
+out vec2 uv;
+out vec4 color;
+void main() {
+  mat4 mvp = mat4(vs_params[0], vs_params[1], vs_params[2], vs_params[3]);
+  mat4 tm = mat4(vs_params[4], vs_params[5], vs_params[6], vs_params[7]);
+  gl_Position = mvp * position;
+  gl_PointSize = psize;
+  uv = (tm * vec4(texcoord0, 0.0, 1.0)).xy;
+  color = color0;
+}
+)glsl";
+
+static const char *g_sgl_vs_glsl300es = R"glsl(#version 300 es
+uniform vec4 vs_params[8];
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 texcoord0;
+layout(location = 2) in vec4 color0;
+layout(location = 3) in float psize;
+out vec2 uv;
+out vec4 color;
+void main() {
+  mat4 mvp = mat4(vs_params[0], vs_params[1], vs_params[2], vs_params[3]);
+  mat4 tm = mat4(vs_params[4], vs_params[5], vs_params[6], vs_params[7]);
+  gl_Position = mvp * position;
+  gl_PointSize = psize;
+  uv = (tm * vec4(texcoord0, 0.0, 1.0)).xy;
+  color = color0;
+}
+)glsl";
+
+static const char *g_sgl_vs_hlsl4 = R"hlsl(
+cbuffer vs_params : register(b0) {
+  row_major float4x4 mvp;
+  row_major float4x4 tm;
+};
+struct vs_in {
+  float4 position : TEXCOORD0;
+  float2 texcoord0 : TEXCOORD1;
+  float4 color0 : TEXCOORD2;
+  float psize : TEXCOORD3;
+};
+struct vs_out {
+  float2 uv : TEXCOORD0;
+  float4 color : TEXCOORD1;
+  float4 pos : SV_Position;
+};
+vs_out main(vs_in inp) {
+  vs_out outp;
+  outp.pos = mul(inp.position, mvp);
+  outp.uv = mul(float4(inp.texcoord0, 0.0, 1.0), tm).xy;
+  outp.color = inp.color0;
+  return outp;
+}
+)hlsl";
+
+// signed distance field glyphs. the edge of the glyph is at alpha 0.5, and
+// the edge is smoothed over about one screen pixel at any scale.
+
+static const char *g_sdf_fs_glsl330 = R"glsl(#version 330
+uniform sampler2D tex_smp;
+in vec2 uv;
+in vec4 color;
+layout(location = 0) out vec4 frag_color;
+void main() {
+  float dist = texture(tex_smp, uv).a;
+  float w = fwidth(dist) * 0.5;
+  float alpha = smoothstep(0.5 - w, 0.5 + w, dist);
+  frag_color = vec4(color.rgb, color.a * alpha);
+}
+)glsl";
+
+static const char *g_sdf_fs_glsl300es = R"glsl(#version 300 es
+precision mediump float;
+uniform highp sampler2D tex_smp;
+in highp vec2 uv;
+in highp vec4 color;
+layout(location = 0) out highp vec4 frag_color;
+void main() {
+  float dist = texture(tex_smp, uv).a;
+  float w = fwidth(dist) * 0.5;
+  float alpha = smoothstep(0.5 - w, 0.5 + w, dist);
+  frag_color = vec4(color.rgb, color.a * alpha);
+}
+)glsl";
+
+static const char *g_sdf_fs_hlsl4 = R"hlsl(
+Texture2D<float4> tex : register(t0);
+SamplerState smp : register(s0);
+struct ps_in {
+  float2 uv : TEXCOORD0;
+  float4 color : TEXCOORD1;
+};
+float4 main(ps_in inp) : SV_Target0 {
+  float dist = tex.Sample(smp, inp.uv).a;
+  float w = fwidth(dist) * 0.5;
+  float alpha = smoothstep(0.5 - w, 0.5 + w, dist);
+  return float4(inp.color.rgb, inp.color.a * alpha);
+}
+)hlsl";
@@ -11,12 +11,13 @@
 bool SpriteData::load(String filepath) {
   PROFILE_FUNC();
 
-  String contents = {};
-  bool ok = vfs_read_entire_file(&contents, filepath);
+  FileView view = {};
+  bool ok = vfs_view_file(&view, filepath);
   if (!ok) {
     return false;
   }
-  defer(mem_free(contents.data));
+  defer(vfs_release_view(&view));
+  String contents = view.contents;
 
   ase_t *ase = nullptr;
   {
@@ -61,8 +62,7 @@ bool SpriteData::load(String filepath) {
   u32 id = 0;
   {
     PROFILE_BLOCK("make image");
-    LockGuard lock{&g_app->gpu_mtx};
-    id = sg_make_image(desc).id;
+    id = image_make_gpu(&desc);
   }
 
   Image img = {};
@@ -0,0 +1,284 @@
+#include "startup_bench.h"
+#include "array.h"
+#include "deps/sokol_time.h"
+#include "os.h"
+#include "strings.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern "C" {
+#include <lua.h>
+}
+
+// forwards to the allocator it replaces, counting allocations on the way
+struct CountingAllocator : Allocator {
+  Allocator *inner;
+  std::atomic<u64> count;
+
+  void make() {}
+
+  void trash() {
+    inner->trash();
+    operator delete(inner);
+  }
+
+  void *alloc(size_t bytes, const char *file, i32 line) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    return inner->alloc(bytes, file, line);
+  }
+
+  void free(void *ptr) { inner->free(ptr); }
+};
+
+struct StartupPhase {
+  const char *name;
+  u64 ticks;
+  u64 allocs;
+  u64 lua_allocs;
+};
+
+struct StartupBench {
+  bool active;
+  CountingAllocator *allocator;
+  lua_Alloc lua_alloc;
+  u64 lua_allocs;
+
+  StartupPhase phases[32];
+  i32 phase_count;
+
+  StartupPhase current; // totals so far, when the phase started
+};
+
+static StartupBench g_bench;
+
+static u64 count_allocs() { return g_bench.allocator->count.load(); }
+
+void startup_bench_start() {
+  CountingAllocator *allocator = new CountingAllocator();
+  allocator->inner = g_allocator;
+  allocator->count = 0;
+
+  g_allocator = allocator;
+  g_bench.allocator = allocator;
+  g_bench.active = true;
+}
+
+bool startup_bench_active() { return g_bench.active; }
+
+static void *counting_lua_alloc(void *ud, void *ptr, size_t osize,
+                                size_t nsize) {
+  if (ptr == nullptr && nsize != 0) {
+    g_bench.lua_allocs++;
+  }
+  return g_bench.lua_alloc(ud, ptr, osize, nsize);
+}
+
+void startup_bench_count_lua(lua_State *L) {
+  if (!g_bench.active) {
+    return;
+  }
+
+  void *ud = nullptr;
+  g_bench.lua_alloc = lua_getallocf(L, &ud);
+  lua_setallocf(L, counting_lua_alloc, ud);
+}
+
+void startup_bench_phase(const char *name) {
+  if (!g_bench.active) {
+    return;
+  }
+
+  StartupPhase *cur = &g_bench.current;
+  u64 now = stm_now();
+  u64 allocs = count_allocs();
+
+  if (cur->name != nullptr &&
+      g_bench.phase_count < (i32)array_size(g_bench.phases)) {
+    StartupPhase phase = {};
+    phase.name = cur->name;
+    phase.ticks = now - cur->ticks;
+    phase.allocs = allocs - cur->allocs;
+    phase.lua_allocs = g_bench.lua_allocs - cur->lua_allocs;
+    g_bench.phases[g_bench.phase_count++] = phase;
+  }
+
+  cur->name = name;
+  cur->ticks = now;
+  cur->allocs = allocs;
+  cur->lua_allocs = g_bench.lua_allocs;
+}
+
+void startup_bench_finish() {
+  if (!g_bench.active) {
+    return;
+  }
+
+  startup_bench_phase(nullptr);
+  g_bench.active = false;
+
+  for (i32 i = 0; i < g_bench.phase_count; i++) {
+    StartupPhase p = g_bench.phases[i];
+    printf("bench_startup %s %llu %llu %llu\n", p.name,
+           (unsigned long long)p.ticks, (unsigned long long)p.allocs,
+           (unsigned long long)p.lua_allocs);
+  }
+  fflush(stdout);
+}
+
+struct PhaseSamples {
+  char name[64];
+  Array<u64> ticks;
+  Array<u64> allocs;
+  Array<u64> lua_allocs;
+};
+
+static u64 median(Array<u64> samples) {
+  qsort(samples.data, samples.len, sizeof(u64),
+        [](const void *a, const void *b) -> int {
+          u64 lhs = *(u64 *)a;
+          u64 rhs = *(u64 *)b;
+          return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+        });
+
+  u64 mid = samples.len / 2;
+  if (samples.len % 2 == 0) {
+    return (samples[mid - 1] + samples[mid]) / 2;
+  }
+  return samples[mid];
+}
+
+static void print_row(const char *name, Array<u64> ticks, u64 allocs,
+                      u64 lua_allocs) {
+  u64 min = ticks[0];
+  u64 max = ticks[0];
+  for (u64 t : ticks) {
+    min = t < min ? t : min;
+    max = t > max ? t : max;
+  }
+
+  printf("%-24s %10.3f %10.3f %10.3f %10llu %10llu\n", name, stm_ms(min),
+         stm_ms(median(ticks)), stm_ms(max), (unsigned long long)allocs,
+         (unsigned long long)lua_allocs);
+}
+
+static bool is_count(const char *arg) {
+  for (const char *c = arg; *c != 0; c++) {
+    if (*c < '0' || *c > '9') {
+      return false;
+    }
+  }
+  return *arg != 0;
+}
+
+bool startup_bench_run(i32 argc, char **argv) {
+  i32 runs = 10;
+
+  // a copy, since os_program_dir writes into the path's buffer
+  String program = to_cstr(os_program_path());
+  defer(mem_free(program.data));
+
+  // args are passed as they are, with no shell to quote them for
+  Array<const char *> cmd = {};
+  defer(cmd.trash());
+  cmd.push(program.data);
+  cmd.push("--bench-startup-run");
+  for (i32 i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench-startup") == 0) {
+      if (i + 1 < argc && is_count(argv[i + 1])) {
+        runs = atoi(argv[++i]);
+      }
+    } else {
+      cmd.push(argv[i]);
+    }
+  }
+  cmd.push(nullptr);
+
+  if (runs < 1) {
+    fprintf(stderr, "usage: %s --bench-startup [runs, at least 1]\n",
+            argv[0]);
+    return false;
+  }
+
+  Array<PhaseSamples> phases = {};
+  Array<u64> totals = {};
+  defer({
+    for (PhaseSamples &p : phases) {
+      p.ticks.trash();
+      p.allocs.trash();
+      p.lua_allocs.trash();
+    }
+    phases.trash();
+    totals.trash();
+  });
+
+  for (i32 run = 0; run < runs; run++) {
+    String out = {};
+    bool ok = os_run_capture(cmd.data, &out);
+    defer(mem_free(out.data));
+    if (!ok) {
+      fprintf(stderr, "startup run %d failed\n", run + 1);
+      return false;
+    }
+
+    u64 total = 0;
+    for (String line : SplitLines(out)) {
+      if (!line.starts_with("bench_startup ")) {
+        continue;
+      }
+
+      char buf[256] = {};
+      memcpy(buf, line.data, line.len < 255 ? line.len : 255);
+
+      char name[64] = {};
+      unsigned long long ticks = 0, allocs = 0, lua_allocs = 0;
+      if (sscanf(buf, "bench_startup %63s %llu %llu %llu", name, &ticks,
+                 &allocs, &lua_allocs) != 4) {
+        continue;
+      }
+
+      PhaseSamples *p = nullptr;
+      for (PhaseSamples &existing : phases) {
+        if (strcmp(existing.name, name) == 0) {
+          p = &existing;
+        }
+      }
+
+      if (p == nullptr) {
+        PhaseSamples samples = {};
+        memcpy(samples.name, name, sizeof(name));
+        phases.push(samples);
+        p = &phases[phases.len - 1];
+      }
+
+      p->ticks.push(ticks);
+      p->allocs.push(allocs);
+      p->lua_allocs.push(lua_allocs);
+      total += ticks;
+    }
+
+    if (total == 0) {
+      fprintf(stderr, "startup run %d didn't report its phases\n", run + 1);
+      return false;
+    }
+    totals.push(total);
+  }
+
+  printf("startup phases over %d runs, allocations are medians\n", runs);
+  printf("%-24s %10s %10s %10s %10s %10s\n", "phase", "min ms", "median ms",
+         "max ms", "allocs", "lua allocs");
+
+  u64 total_allocs = 0;
+  u64 total_lua_allocs = 0;
+  for (PhaseSamples &p : phases) {
+    u64 allocs = median(p.allocs);
+    u64 lua_allocs = median(p.lua_allocs);
+    print_row(p.name, p.ticks, allocs, lua_allocs);
+
+    total_allocs += allocs;
+    total_lua_allocs += lua_allocs;
+  }
+
+  print_row("total", totals, total_allocs, total_lua_allocs);
+  return true;
+}
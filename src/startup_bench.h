@@ -0,0 +1,27 @@
+#pragma once
+
+#include "prelude.h"
+
+// timings for each phase of startup, for --bench-startup. every run is a
+// new process started with --bench-startup-run, so each one starts cold.
+// runs print their phases to stdout after the first frame and quit, and
+// the parent prints min, median and max for each phase.
+
+struct lua_State;
+
+// runs the program with the rest of argv. the number of runs can follow
+// --bench-startup, and is 10 if it doesn't. returns false if a run failed.
+bool startup_bench_run(i32 argc, char **argv);
+
+// called at the start of a run. counts allocations from here on.
+void startup_bench_start();
+bool startup_bench_active();
+
+// also counts allocations made by the lua state
+void startup_bench_count_lua(lua_State *L);
+
+// ends the current phase and starts the next. does nothing if not active.
+void startup_bench_phase(const char *name);
+
+// ends the last phase and prints every phase of this run
+void startup_bench_finish();
@@ -0,0 +1,402 @@
+#include "text.h"
+#include "app.h"
+#include "draw.h"
+#include "hash_map.h"
+#include "profile.h"
+#include "scanner.h"
+#include "strings.h"
+
+struct TextLayout {
+  FontFamily *font;
+  float size;
+  Array<TextGlyph> glyphs;
+  Array<u32> images;
+};
+
+static void layout_line(TextLayout *layout, float x, float *y, String line) {
+  for (Rune r : UTF8(line)) {
+    u32 atlas = 0;
+    float xx = x;
+    float yy = *y;
+    stbtt_aligned_quad q =
+        layout->font->quad(&atlas, &xx, &yy, layout->size, r.charcode());
+
+    TextGlyph g = {};
+    g.x0 = x + q.x0;
+    g.y0 = *y + q.y0;
+    g.x1 = x + q.x1;
+    g.y1 = *y + q.y1;
+    g.u0 = q.s0;
+    g.v0 = q.t0;
+    g.u1 = q.s1;
+    g.v1 = q.t1;
+
+    layout->glyphs.push(g);
+    layout->images.push(atlas);
+
+    x = xx;
+  }
+
+  *y += layout->size;
+}
+
+static void layout_text(TextLayout *layout, String text, float limit,
+                        float *y) {
+  FontFamily *font = layout->font;
+  float size = layout->size;
+
+  if (limit < 0) {
+    for (String line : SplitLines(text)) {
+      layout_line(layout, 0, y, line);
+    }
+  } else {
+    StringBuilder sb = {};
+    defer(sb.trash());
+
+    for (String line : SplitLines(text)) {
+      sb.clear();
+      Scanner scan = line;
+
+      for (String word = scan.next_string(); word != "";
+           word = scan.next_string()) {
+
+        sb << word;
+
+        float width = font->width(size, String(sb));
+        if (width < limit) {
+          sb << " ";
+          continue;
+        }
+
+        sb.len -= word.len;
+        sb.data[sb.len] = '\0';
+
+        layout_line(layout, 0, y, String(sb));
+
+        sb.clear();
+        sb << word << " ";
+      }
+
+      layout_line(layout, 0, y, String(sb));
+    }
+  }
+}
+
+void TextMesh::make(FontFamily *font, float size, String text, float limit) {
+  PROFILE_FUNC();
+
+  TextLayout layout = {};
+  layout.font = font;
+  layout.size = size;
+  defer({
+    layout.glyphs.trash();
+    layout.images.trash();
+  });
+
+  // a glyph that makes the atlas wider replaces the textures and coords of
+  // the glyphs laid out before it, so the text is laid out again
+  float y = size;
+  for (i32 attempt = 0; attempt < 2; attempt++) {
+    u32 generation = font->atlas.generation;
+
+    layout.glyphs.len = 0;
+    layout.images.len = 0;
+    y = size;
+    layout_text(&layout, text, limit, &y);
+
+    if (font->atlas.generation == generation) {
+      break;
+    }
+  }
+
+  // neighbouring glyphs on the same atlas image share a draw. glyphs stay
+  // in source order, so glyphs that overlap are drawn the way they're laid
+  // out, and an image can have more than one run.
+  TextMesh mesh = {};
+  mesh.glyphs.reserve(layout.glyphs.len);
+  mesh.advance_y = y - size;
+  mesh.sdf = font->sdf;
+
+  for (u64 i = 0; i < layout.glyphs.len; i++) {
+    u32 image = layout.images[i];
+
+    TextRun *last = mesh.runs.len > 0 ? &mesh.runs[mesh.runs.len - 1] : nullptr;
+    if (last != nullptr && last->image == image) {
+      last->count++;
+    } else {
+      TextRun run = {};
+      run.image = image;
+      run.first = (u32)mesh.glyphs.len;
+      run.count = 1;
+      mesh.runs.push(run);
+    }
+
+    mesh.glyphs.push(layout.glyphs[i]);
+  }
+
+  *this = mesh;
+}
+
+void TextMesh::trash() {
+  glyphs.trash();
+  runs.trash();
+}
+
+u64 TextMesh::memory_size() {
+  return sizeof(TextMesh) + sizeof(TextGlyph) * glyphs.capacity +
+         sizeof(TextRun) * runs.capacity;
+}
+
+struct TextCacheEntry {
+  FontFamily *font;
+  float size;
+  float limit;
+  String text;
+  TextMesh mesh;
+  u64 bytes;
+
+  // least recently used list
+  TextCacheEntry *prev;
+  TextCacheEntry *next;
+};
+
+struct TextCache {
+  HashMap<TextCacheEntry *> entries;
+  TextCacheEntry *head; // most recently used
+  TextCacheEntry *tail;
+  u64 bytes;
+  u64 budget = 1024 * 1024;
+};
+
+static TextCache g_text_cache;
+
+static u64 text_cache_key(FontFamily *font, float size, String text,
+                          float limit) {
+  struct {
+    FontFamily *font;
+    float size;
+    float limit;
+  } params = {font, size, limit};
+
+  u64 hash = fnv1a((const char *)&params, sizeof(params));
+  return hash ^ (fnv1a(text) * 1099511628211);
+}
+
+static void text_cache_unlink(TextCacheEntry *e) {
+  if (e->prev != nullptr) {
+    e->prev->next = e->next;
+  } else {
+    g_text_cache.head = e->next;
+  }
+
+  if (e->next != nullptr) {
+    e->next->prev = e->prev;
+  } else {
+    g_text_cache.tail = e->prev;
+  }
+
+  e->prev = nullptr;
+  e->next = nullptr;
+}
+
+static void text_cache_push_front(TextCacheEntry *e) {
+  e->prev = nullptr;
+  e->next = g_text_cache.head;
+  if (g_text_cache.head != nullptr) {
+    g_text_cache.head->prev = e;
+  }
+  g_text_cache.head = e;
+
+  if (g_text_cache.tail == nullptr) {
+    g_text_cache.tail = e;
+  }
+}
+
+static void text_cache_remove(u64 key, TextCacheEntry *e) {
+  text_cache_unlink(e);
+  g_text_cache.entries.unset(key);
+  g_text_cache.bytes -= e->bytes;
+
+  e->mesh.trash();
+  mem_free(e->text.data);
+  mem_free(e);
+}
+
+static void text_cache_evict(TextCacheEntry *keep) {
+  while (g_text_cache.bytes > g_text_cache.budget &&
+         g_text_cache.tail != nullptr && g_text_cache.tail != keep) {
+    TextCacheEntry *e = g_text_cache.tail;
+    u64 key = text_cache_key(e->font, e->size, e->text, e->limit);
+    text_cache_remove(key, e);
+  }
+}
+
+TextMesh *text_cache_get(FontFamily *font, float size, String text,
+                         float limit) {
+  u64 key = text_cache_key(font, size, text, limit);
+
+  TextCacheEntry **found = g_text_cache.entries.get(key);
+  if (found != nullptr) {
+    TextCacheEntry *e = *found;
+    if (e->font == font && e->size == size && e->limit == limit &&
+        e->text == text) {
+      text_cache_unlink(e);
+      text_cache_push_front(e);
+      return &e->mesh;
+    }
+
+    // hash collision, replace the old entry
+    text_cache_remove(key, e);
+  }
+
+  TextCacheEntry *e = (TextCacheEntry *)mem_alloc(sizeof(TextCacheEntry));
+  *e = {};
+  e->font = font;
+  e->size = size;
+  e->limit = limit;
+  e->text = to_cstr(text);
+  e->mesh.make(font, size, text, limit);
+  e->bytes = sizeof(TextCacheEntry) + e->text.len + e->mesh.memory_size();
+
+  g_text_cache.entries[key] = e;
+  g_text_cache.bytes += e->bytes;
+  text_cache_push_front(e);
+
+  text_cache_evict(e);
+  return &e->mesh;
+}
+
+void text_cache_evict_font(FontFamily *font) {
+  TextCacheEntry *e = g_text_cache.head;
+  while (e != nullptr) {
+    TextCacheEntry *next = e->next;
+    if (e->font == font) {
+      u64 key = text_cache_key(e->font, e->size, e->text, e->limit);
+      text_cache_remove(key, e);
+    }
+    e = next;
+  }
+}
+
+void text_cache_set_budget(u64 bytes) {
+  g_text_cache.budget = bytes;
+  text_cache_evict(nullptr);
+}
+
+void text_cache_trash() {
+  text_cache_set_budget(0);
+  g_text_cache.entries.trash();
+  g_text_cache.entries = {};
+}
+
+void StaticText::make(FontFamily *font, float size, String text,
+                      float limit) {
+  PROFILE_FUNC();
+
+  StaticText st = {};
+  st.mesh.make(font, size, text, limit);
+
+  u64 len = st.mesh.glyphs.len;
+  if (len == 0) {
+    *this = st;
+    return;
+  }
+
+  Array<SpriteVertex> vertices = {};
+  defer(vertices.trash());
+  vertices.reserve(len * 4);
+
+  Array<u32> indices = {};
+  defer(indices.trash());
+  indices.reserve(len * 6);
+
+  Color white = {255, 255, 255, 255};
+  for (TextGlyph g : st.mesh.glyphs) {
+    u32 v = (u32)vertices.len;
+    vertices.push({g.x0, g.y0, g.u0, g.v0, white});
+    vertices.push({g.x0, g.y1, g.u0, g.v1, white});
+    vertices.push({g.x1, g.y1, g.u1, g.v1, white});
+    vertices.push({g.x1, g.y0, g.u1, g.v0, white});
+
+    indices.push(v + 0);
+    indices.push(v + 1);
+    indices.push(v + 2);
+    indices.push(v + 0);
+    indices.push(v + 2);
+    indices.push(v + 3);
+  }
+
+  sg_buffer_desc vdesc = {};
+  vdesc.type = SG_BUFFERTYPE_VERTEXBUFFER;
+  vdesc.data.ptr = vertices.data;
+  vdesc.data.size = sizeof(SpriteVertex) * vertices.len;
+
+  sg_buffer_desc idesc = {};
+  idesc.type = SG_BUFFERTYPE_INDEXBUFFER;
+  idesc.data.ptr = indices.data;
+  idesc.data.size = sizeof(u32) * indices.len;
+
+  {
+    LockGuard lock{&g_app->gpu_mtx};
+    st.vbuf = sg_make_buffer(vdesc).id;
+    st.ibuf = sg_make_buffer(idesc).id;
+  }
+
+  for (TextRun run : st.mesh.runs) {
+    font_retain_image(run.image);
+  }
+
+  *this = st;
+}
+
+void StaticText::trash() {
+  if (vbuf != SG_INVALID_ID) {
+    // a draw of the text can still be queued
+    LockGuard lock{&g_app->gpu_mtx};
+    renderer_retire_buffer(vbuf);
+    renderer_retire_buffer(ibuf);
+
+    for (TextRun run : mesh.runs) {
+      font_release_image(run.image);
+    }
+  }
+
+  mesh.trash();
+}
+
+float StaticText::draw(float x, float y) {
+  PROFILE_FUNC();
+
+  if (vbuf == SG_INVALID_ID) {
+    return y + mesh.advance_y;
+  }
+
+  bool ok = renderer_push_matrix();
+  if (!ok) {
+    return y + mesh.advance_y;
+  }
+
+  renderer_translate(x, y);
+
+  RendererDraw rd = {};
+  rd.bind.vertex_buffers[0] = {vbuf};
+  rd.bind.index_buffer = {ibuf};
+
+  if (mesh.sdf) {
+    rd.pip = renderer_sdf_pipeline();
+    rd.bind.fs.samplers[0] = renderer_linear_sampler();
+  } else {
+    rd.pip = renderer_sprite_pipeline();
+    rd.bind.fs.samplers[0] = renderer_sampler();
+  }
+
+  for (TextRun run : mesh.runs) {
+    rd.bind.fs.images[0] = {run.image};
+    rd.base_element = (i32)run.first * 6;
+    rd.num_elements = (i32)run.count * 6;
+    renderer_push_draw(&rd);
+  }
+
+  renderer_pop_matrix();
+  return y + mesh.advance_y;
+}
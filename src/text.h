@@ -0,0 +1,48 @@
+#pragma once
+
+#include "array.h"
+#include "font.h"
+
+struct TextGlyph {
+  float x0, y0, x1, y1;
+  float u0, v0, u1, v1;
+};
+
+// neighbouring glyphs that use the same font atlas image
+struct TextRun {
+  u32 image;
+  u32 first;
+  u32 count;
+};
+
+// glyph quads for a laid out string, relative to where it's drawn
+struct TextMesh {
+  Array<TextGlyph> glyphs;
+  Array<TextRun> runs;
+  float advance_y; // distance to the bottom of the text
+  bool sdf;        // glyphs are distance fields, see FontFamily::sdf
+
+  // limit is the word wrap width, or negative to only break on new lines
+  void make(FontFamily *font, float size, String text, float limit);
+  void trash();
+  u64 memory_size();
+};
+
+// text meshes made by draw_font are kept in a cache, so strings drawn every
+// frame are only laid out once
+TextMesh *text_cache_get(FontFamily *font, float size, String text,
+                         float limit);
+void text_cache_evict_font(FontFamily *font);
+void text_cache_set_budget(u64 bytes);
+void text_cache_trash();
+
+// text that lives in gpu memory, for long strings that rarely change
+struct StaticText {
+  TextMesh mesh;
+  u32 vbuf;
+  u32 ibuf;
+
+  void make(FontFamily *font, float size, String text, float limit);
+  void trash();
+  float draw(float x, float y);
+};
@@ -0,0 +1,161 @@
+#include "texture_cache.h"
+#include "os.h"
+#include "profile.h"
+#include "strings.h"
+#include "sync.h"
+#include <stdio.h>
+
+struct TextureCacheHeader {
+  u32 magic;
+  u32 version;
+  u64 key;
+  i32 width;
+  i32 height;
+  i32 num_levels;
+  i32 reserved;
+};
+
+static constexpr u32 TEXTURE_CACHE_MAGIC = 0x58545053; // "SPTX"
+static constexpr u32 TEXTURE_CACHE_VERSION = 1;
+
+static String g_cache_dir;
+
+void texture_cache_setup(String dir, u64 max_size) {
+  if (dir.len == 0) {
+    return;
+  }
+
+  os_make_dir(dir.data);
+  g_cache_dir = to_cstr(dir);
+
+  // entries are touched when read, so this deletes the ones that haven't
+  // been used in the longest time
+  os_prune_dir(g_cache_dir.data, ".tex", max_size);
+}
+
+void texture_cache_shutdown() {
+  mem_free(g_cache_dir.data);
+  g_cache_dir = {};
+}
+
+u64 texture_cache_key(String contents, u64 flags) {
+  return fnv1a(contents) ^ (flags << 32) ^ TEXTURE_CACHE_VERSION;
+}
+
+static u64 level_size(i32 width, i32 height, i32 level) {
+  return (u64)(width >> level) * (u64)(height >> level) * 4;
+}
+
+// images can be loaded on any thread, so paths go in the caller's buffer
+static void entry_path(char *buf, u64 len, u64 key) {
+  snprintf(buf, len, "%s/%016llx.tex", g_cache_dir.data,
+           (unsigned long long)key);
+}
+
+void CachedTexture::trash() {
+  if (blob.data != nullptr) {
+    os_unmap_file(blob);
+  }
+}
+
+bool texture_cache_read(u64 key, CachedTexture *out) {
+  if (g_cache_dir.len == 0) {
+    return false;
+  }
+
+  PROFILE_FUNC();
+
+  char path[1024] = {};
+  entry_path(path, sizeof(path), key);
+
+  // levels are uploaded straight from the mapping, without a copy
+  String blob = {};
+  if (!os_map_file(path, &blob)) {
+    return false;
+  }
+
+  char *buf = blob.data;
+  u64 size = blob.len;
+  if (size < sizeof(TextureCacheHeader)) {
+    os_unmap_file(blob);
+    return false;
+  }
+
+  TextureCacheHeader header = {};
+  memcpy(&header, buf, sizeof(header));
+
+  bool ok = header.magic == TEXTURE_CACHE_MAGIC &&
+            header.version == TEXTURE_CACHE_VERSION && header.key == key &&
+            header.width > 0 && header.height > 0 && header.num_levels > 0 &&
+            header.num_levels <= TEXTURE_CACHE_MAX_LEVELS;
+
+  CachedTexture ct = {};
+  ct.blob = blob;
+  ct.width = header.width;
+  ct.height = header.height;
+  ct.num_levels = header.num_levels;
+
+  u64 offset = sizeof(TextureCacheHeader);
+  for (i32 i = 0; ok && i < ct.num_levels; i++) {
+    u64 len = level_size(ct.width, ct.height, i);
+    if (len == 0 || offset + len > size) {
+      ok = false;
+      break;
+    }
+
+    ct.levels[i] = (u8 *)&buf[offset];
+    offset += len;
+  }
+
+  if (!ok) {
+    os_unmap_file(blob);
+    return false;
+  }
+
+  // marks the entry as used, so pruning keeps it
+  os_touch_file(path);
+
+  *out = ct;
+  return true;
+}
+
+void texture_cache_write(u64 key, i32 width, i32 height, u8 **levels,
+                         i32 num_levels) {
+  if (g_cache_dir.len == 0 || num_levels > TEXTURE_CACHE_MAX_LEVELS) {
+    return;
+  }
+
+  PROFILE_FUNC();
+
+  TextureCacheHeader header = {};
+  header.magic = TEXTURE_CACHE_MAGIC;
+  header.version = TEXTURE_CACHE_VERSION;
+  header.key = key;
+  header.width = width;
+  header.height = height;
+  header.num_levels = num_levels;
+
+  char path[1024] = {};
+  entry_path(path, sizeof(path), key);
+
+  // written under another name first, so a reader never sees half a file
+  char tmp[1024] = {};
+  snprintf(tmp, sizeof(tmp), "%s.%llu.tmp", path,
+           (unsigned long long)this_thread_id());
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == nullptr) {
+    return;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  for (i32 i = 0; ok && i < num_levels; i++) {
+    u64 len = level_size(width, height, i);
+    ok = fwrite(levels[i], 1, len, f) == len;
+  }
+  fclose(f);
+
+  if (!ok || rename(tmp, path) != 0) {
+    remove(tmp);
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "prelude.h"
+
+// decoded images and their mip chains, saved to disk so they don't have to
+// be decoded again. entries are keyed by a hash of the source file, so a
+// changed file gets a new entry instead of reading a stale one.
+
+constexpr i32 TEXTURE_CACHE_MAX_LEVELS = 16;
+
+struct CachedTexture {
+  String blob; // the whole cache file, mapped
+  i32 width;
+  i32 height;
+  i32 num_levels;                       // base level, then each mip
+  u8 *levels[TEXTURE_CACHE_MAX_LEVELS]; // rgba, pointing into blob
+
+  void trash();
+};
+
+// entries are kept in the given directory, which is made if needed.
+// caching is off if dir is empty. entries used least recently are deleted
+// until the directory fits in max_size.
+void texture_cache_setup(String dir, u64 max_size);
+void texture_cache_shutdown();
+
+// flags tell apart entries made from the same file with different settings
+u64 texture_cache_key(String contents, u64 flags);
+bool texture_cache_read(u64 key, CachedTexture *out);
+
+// level i is (width >> i) by (height >> i) pixels
+void texture_cache_write(u64 key, i32 width, i32 height, u8 **levels,
+                         i32 num_levels);
@@ -1,6 +1,9 @@
 #include "tilemap.h"
+#include "app.h"
 #include "arena.h"
+#include "draw.h"
 #include "hash_map.h"
+#include "jobs.h"
 #include "json.h"
 #include "prelude.h"
 #include "priority_queue.h"
@@ -12,6 +15,7 @@
 #include <box2d/b2_fixture.h>
 #include <box2d/b2_polygon_shape.h>
 #include <box2d/b2_world.h>
+#include <float.h>
 
 static bool layer_from_json(TilemapLayer *layer, JSON *json, bool *ok,
                             Arena *arena, String filepath,
@@ -172,15 +176,173 @@ static bool level_from_json(TilemapLevel *level, JSON *json, bool *ok,
   return true;
 }
 
+struct MakeMesh {
+  Tilemap *tm;
+  sg_buffer_desc vdesc;
+  sg_buffer_desc idesc;
+};
+
+static void make_mesh_buffers(void *udata) {
+  MakeMesh *mm = (MakeMesh *)udata;
+
+  LockGuard lock{&g_app->gpu_mtx};
+  mm->tm->vbuf = sg_make_buffer(mm->vdesc).id;
+  mm->tm->ibuf = sg_make_buffer(mm->idesc).id;
+}
+
+static void make_mesh(Tilemap *tm) {
+  PROFILE_FUNC();
+
+  u64 total = 0;
+  for (TilemapLevel &level : tm->levels) {
+    for (TilemapLayer &layer : level.layers) {
+      total += layer.tiles.len;
+    }
+  }
+
+  if (total == 0) {
+    return;
+  }
+
+  Array<SpriteVertex> vertices = {};
+  defer(vertices.trash());
+  vertices.reserve(total * 4);
+
+  Array<u32> indices = {};
+  defer(indices.trash());
+  indices.reserve(total * 6);
+
+  Color white = {255, 255, 255, 255};
+
+  Array<u32> chunk_of = {};
+  defer(chunk_of.trash());
+
+  Array<u32> order = {};
+  defer(order.trash());
+
+  Array<u32> offsets = {};
+  defer(offsets.trash());
+
+  for (TilemapLevel &level : tm->levels) {
+    for (TilemapLayer &layer : level.layers) {
+      if (layer.tiles.len == 0) {
+        continue;
+      }
+
+      // bucket tiles by chunk with a counting sort. tiles keep their
+      // original order inside a chunk, so stacked tiles still overlap the
+      // same way.
+      float chunk_px = layer.grid_size * TILEMAP_CHUNK_SIZE;
+      i32 chunks_x = 1;
+      i32 chunks_y = 1;
+      for (Tile tile : layer.tiles) {
+        i32 cx = (i32)(tile.x / chunk_px);
+        i32 cy = (i32)(tile.y / chunk_px);
+        chunks_x = cx + 1 > chunks_x ? cx + 1 : chunks_x;
+        chunks_y = cy + 1 > chunks_y ? cy + 1 : chunks_y;
+      }
+
+      u64 num_chunks = (u64)chunks_x * chunks_y;
+      offsets.resize(num_chunks + 1);
+      memset(offsets.data, 0, sizeof(u32) * offsets.len);
+
+      chunk_of.resize(layer.tiles.len);
+      for (u64 i = 0; i < layer.tiles.len; i++) {
+        i32 cx = (i32)(layer.tiles[i].x / chunk_px);
+        i32 cy = (i32)(layer.tiles[i].y / chunk_px);
+        cx = cx < 0 ? 0 : cx;
+        cy = cy < 0 ? 0 : cy;
+
+        chunk_of[i] = (u32)(cy * chunks_x + cx);
+        offsets[chunk_of[i] + 1]++;
+      }
+
+      u64 non_empty = 0;
+      for (u64 i = 0; i < num_chunks; i++) {
+        if (offsets[i + 1] != 0) {
+          non_empty++;
+        }
+        offsets[i + 1] += offsets[i];
+      }
+
+      order.resize(layer.tiles.len);
+      for (u64 i = 0; i < layer.tiles.len; i++) {
+        order[offsets[chunk_of[i]]++] = (u32)i;
+      }
+
+      layer.chunks.resize(&tm->arena, non_empty);
+
+      u64 next = 0;
+      u64 chunk = 0;
+      for (u64 i = 0; i < num_chunks; i++) {
+        u64 end = offsets[i];
+        if (end == next) {
+          continue;
+        }
+
+        TilemapChunk c = {};
+        c.x0 = c.y0 = FLT_MAX;
+        c.x1 = c.y1 = -FLT_MAX;
+        c.base_element = (i32)indices.len;
+        c.num_elements = (i32)(end - next) * 6;
+
+        for (; next < end; next++) {
+          Tile tile = layer.tiles[order[next]];
+
+          float x0 = tile.x;
+          float y0 = tile.y;
+          float x1 = tile.x + layer.grid_size;
+          float y1 = tile.y + layer.grid_size;
+
+          c.x0 = x0 < c.x0 ? x0 : c.x0;
+          c.y0 = y0 < c.y0 ? y0 : c.y0;
+          c.x1 = x1 > c.x1 ? x1 : c.x1;
+          c.y1 = y1 > c.y1 ? y1 : c.y1;
+
+          u32 v = (u32)vertices.len;
+          vertices.push({x0, y0, tile.u0, tile.v0, white});
+          vertices.push({x0, y1, tile.u0, tile.v1, white});
+          vertices.push({x1, y1, tile.u1, tile.v1, white});
+          vertices.push({x1, y0, tile.u1, tile.v0, white});
+
+          indices.push(v + 0);
+          indices.push(v + 1);
+          indices.push(v + 2);
+          indices.push(v + 0);
+          indices.push(v + 2);
+          indices.push(v + 3);
+        }
+
+        layer.chunks[chunk++] = c;
+      }
+    }
+  }
+
+  MakeMesh mm = {};
+  mm.tm = tm;
+
+  mm.vdesc.type = SG_BUFFERTYPE_VERTEXBUFFER;
+  mm.vdesc.data.ptr = vertices.data;
+  mm.vdesc.data.size = sizeof(SpriteVertex) * vertices.len;
+
+  mm.idesc.type = SG_BUFFERTYPE_INDEXBUFFER;
+  mm.idesc.data.ptr = indices.data;
+  mm.idesc.data.size = sizeof(u32) * indices.len;
+
+  // on a job worker, the main thread makes the buffers
+  jobs_run_on_main(make_mesh_buffers, &mm);
+}
+
 bool Tilemap::load(String filepath) {
   PROFILE_FUNC();
 
-  String contents = {};
-  bool success = vfs_read_entire_file(&contents, filepath);
+  FileView view = {};
+  bool success = vfs_view_file(&view, filepath);
   if (!success) {
     return false;
   }
-  defer(mem_free(contents.data));
+  defer(vfs_release_view(&view));
+  String contents = view.contents;
 
   bool ok = true;
   JSONDocument doc = {};
@@ -229,6 +391,7 @@ bool Tilemap::load(String filepath) {
   tilemap.arena = arena;
   tilemap.levels = levels;
   tilemap.images = images;
+  make_mesh(&tilemap);
 
   printf("loaded tilemap with %llu levels\n",
          (unsigned long long)tilemap.levels.len);
@@ -238,6 +401,12 @@ bool Tilemap::load(String filepath) {
 }
 
 void Tilemap::trash() {
+  if (vbuf != SG_INVALID_ID) {
+    LockGuard lock{&g_app->gpu_mtx};
+    sg_destroy_buffer({vbuf});
+    sg_destroy_buffer({ibuf});
+  }
+
   for (auto [k, v] : images) {
     v->trash();
   }
@@ -18,6 +18,15 @@ struct TilemapEntity {
 
 using TilemapInt = unsigned char;
 
+constexpr i32 TILEMAP_CHUNK_SIZE = 32; // in tiles
+
+// a square group of tiles, drawn or skipped together
+struct TilemapChunk {
+  float x0, y0, x1, y1; // bounds, relative to the level
+  i32 base_element;
+  i32 num_elements;
+};
+
 struct TilemapLayer {
   String identifier;
   Image image;
@@ -27,6 +36,10 @@ struct TilemapLayer {
   i32 c_height;
   Slice<TilemapInt> int_grid;
   float grid_size;
+
+  // this layer's tiles in the tilemap mesh. chunks are stored back to back
+  // in the index buffer.
+  Slice<TilemapChunk> chunks;
 };
 
 struct TilemapLevel {
@@ -75,6 +88,10 @@ struct Tilemap {
   PriorityQueue<TileNode *> frontier;
   float graph_grid_size;
 
+  // immutable mesh with every tile in every layer, built on load
+  u32 vbuf;
+  u32 ibuf;
+
   bool load(String filepath);
   void trash();
   void destroy_bodies(b2World *world);
@@ -20,24 +20,18 @@ static u32 read4(char *bytes) {
   return n;
 }
 
-static bool read_entire_file_raw(String *out, String filepath) {
-  PROFILE_FUNC();
-
-  String path = to_cstr(filepath);
-  defer(mem_free(path.data));
-
-  FILE *file = fopen(path.data, "rb");
-  if (file == nullptr) {
-    return false;
-  }
-
+static u64 open_file_size(FILE *file) {
   fseek(file, 0L, SEEK_END);
   size_t size = ftell(file);
   rewind(file);
+  return size;
+}
+
+static bool read_open_file(String *out, FILE *file) {
+  size_t size = open_file_size(file);
 
   char *buf = (char *)mem_alloc(size + 1);
   size_t read = fread(buf, sizeof(char), size, file);
-  fclose(file);
 
   if (read != size) {
     mem_free(buf);
@@ -49,6 +43,21 @@ static bool read_entire_file_raw(String *out, String filepath) {
   return true;
 }
 
+static bool read_entire_file_raw(String *out, String filepath) {
+  PROFILE_FUNC();
+
+  String path = to_cstr(filepath);
+  defer(mem_free(path.data));
+
+  FILE *file = fopen(path.data, "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  defer(fclose(file));
+
+  return read_open_file(out, file);
+}
+
 static bool list_all_files_help(Array<String> *files, String path) {
   PROFILE_FUNC();
 
@@ -80,6 +89,163 @@ static bool list_all_files_help(Array<String> *files, String path) {
   return true;
 }
 
+struct VFSFile {
+  virtual void trash() = 0;
+  virtual u64 read(void *buf, u64 len) = 0;
+  virtual bool seek(u64 offset) = 0;
+  virtual u64 tell() = 0;
+  virtual u64 size() = 0;
+};
+
+template <typename T> static T *new_vfs_file() {
+  void *ptr = mem_alloc(sizeof(T));
+  return new (ptr) T();
+}
+
+// a file that's already in memory
+struct MemoryFile : VFSFile {
+  FileView view;
+  u64 cursor;
+
+  void trash() { vfs_release_view(&view); }
+
+  u64 read(void *buf, u64 len) {
+    u64 remaining = view.contents.len - cursor;
+    u64 n = remaining < len ? remaining : len;
+    memcpy(buf, &view.contents.data[cursor], n);
+    cursor += n;
+    return n;
+  }
+
+  bool seek(u64 offset) {
+    if (offset > view.contents.len) {
+      return false;
+    }
+
+    cursor = offset;
+    return true;
+  }
+
+  u64 tell() { return cursor; }
+  u64 size() { return view.contents.len; }
+};
+
+struct StdioFile : VFSFile {
+  FILE *file;
+  u64 len;
+
+  void trash() { fclose(file); }
+
+  u64 read(void *buf, u64 n) { return fread(buf, 1, n, file); }
+
+  bool seek(u64 offset) {
+    if (offset > len) {
+      return false;
+    }
+
+    return fseek(file, (long)offset, SEEK_SET) == 0;
+  }
+
+  u64 tell() { return (u64)ftell(file); }
+  u64 size() { return len; }
+};
+
+// raw deflate data in memory, decompressed into a window the size of the
+// deflate dictionary. seeking forward decompresses and skips, seeking back
+// starts over from the beginning.
+struct InflateFile : VFSFile {
+  const u8 *src;
+  u64 src_len;
+  u64 src_cursor;
+  u64 len; // uncompressed
+  u64 cursor;
+
+  tinfl_decompressor inflator;
+  tinfl_status status;
+  u64 window_end;     // where tinfl writes next
+  u64 pending_offset; // decompressed, but not read yet
+  u64 pending_len;
+  u8 window[TINFL_LZ_DICT_SIZE];
+
+  void make(const char *data, u64 data_len, u64 uncompressed_len) {
+    src = (const u8 *)data;
+    src_len = data_len;
+    len = uncompressed_len;
+    rewind();
+  }
+
+  void rewind() {
+    tinfl_init(&inflator);
+    status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    src_cursor = 0;
+    cursor = 0;
+    window_end = 0;
+    pending_offset = 0;
+    pending_len = 0;
+  }
+
+  bool fill() {
+    if (status <= TINFL_STATUS_DONE) {
+      return false;
+    }
+
+    // the window wraps, so tinfl only writes over data that was read
+    size_t in_len = src_len - src_cursor;
+    size_t out_len = TINFL_LZ_DICT_SIZE - window_end;
+    status = tinfl_decompress(&inflator, &src[src_cursor], &in_len, window,
+                              &window[window_end], &out_len, 0);
+    src_cursor += in_len;
+
+    pending_offset = window_end;
+    pending_len = out_len;
+    window_end = (window_end + out_len) & (TINFL_LZ_DICT_SIZE - 1);
+    return out_len != 0;
+  }
+
+  // copies to buf, or skips if buf is null
+  u64 consume(u8 *buf, u64 n) {
+    u64 done = 0;
+    while (done < n && cursor < len) {
+      if (pending_len == 0 && !fill()) {
+        break;
+      }
+
+      u64 want = n - done;
+      u64 chunk = pending_len < want ? pending_len : want;
+      if (buf != nullptr) {
+        memcpy(&buf[done], &window[pending_offset], chunk);
+      }
+
+      pending_offset += chunk;
+      pending_len -= chunk;
+      cursor += chunk;
+      done += chunk;
+    }
+
+    return done;
+  }
+
+  void trash() {}
+
+  u64 read(void *buf, u64 n) { return consume((u8 *)buf, n); }
+
+  bool seek(u64 offset) {
+    if (offset > len) {
+      return false;
+    }
+
+    if (offset < cursor) {
+      rewind();
+    }
+
+    u64 skip = offset - cursor;
+    return consume(nullptr, skip) == skip;
+  }
+
+  u64 tell() { return cursor; }
+  u64 size() { return len; }
+};
+
 struct FileSystem {
   virtual void make() = 0;
   virtual void trash() = 0;
@@ -87,10 +253,31 @@ struct FileSystem {
   virtual bool file_exists(String filepath) = 0;
   virtual bool read_entire_file(String *out, String filepath) = 0;
   virtual bool list_all_files(Array<String> *files) = 0;
+
+  // backends that can't view files in place read them into a new buffer
+  virtual bool view_file(FileView *out, String filepath) {
+    out->owned = true;
+    return read_entire_file(&out->contents, filepath);
+  }
+
+  // backends that can't stream files read them with view_file
+  virtual VFSFile *open(String filepath) {
+    FileView view = {};
+    if (!view_file(&view, filepath)) {
+      return nullptr;
+    }
+
+    MemoryFile *f = new_vfs_file<MemoryFile>();
+    f->view = view;
+    f->cursor = 0;
+    return f;
+  }
 };
 
 static FileSystem *g_filesystem;
 
+constexpr u64 DIRECTORY_MAP_MIN_SIZE = 64 * 1024;
+
 struct DirectoryFileSystem : FileSystem {
   void make() {}
   void trash() {}
@@ -120,27 +307,140 @@ struct DirectoryFileSystem : FileSystem {
     return read_entire_file_raw(out, filepath);
   }
 
+  bool view_file(FileView *out, String filepath) {
+    PROFILE_FUNC();
+
+    String path = to_cstr(filepath);
+    defer(mem_free(path.data));
+
+    FILE *file = fopen(path.data, "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    defer(fclose(file));
+
+    // small files are cheaper to copy than to map. views end with a 0 byte,
+    // which a mapping only has if the file doesn't fill its last page.
+    u64 size = open_file_size(file);
+    if (size >= DIRECTORY_MAP_MIN_SIZE && size % os_page_size() != 0) {
+      String mapping = {};
+      if (os_map_file(path.data, &mapping)) {
+        if (mapping.len == size) {
+          out->owned = false;
+          out->mapped = true;
+          out->contents = mapping;
+          return true;
+        }
+
+        // changed since it was opened
+        os_unmap_file(mapping);
+      }
+    }
+
+    out->owned = true;
+    return read_open_file(&out->contents, file);
+  }
+
+  VFSFile *open(String filepath) {
+    String path = to_cstr(filepath);
+    defer(mem_free(path.data));
+
+    FILE *file = fopen(path.data, "rb");
+    if (file == nullptr) {
+      return nullptr;
+    }
+
+    StdioFile *f = new_vfs_file<StdioFile>();
+    f->file = file;
+    f->len = open_file_size(file);
+    return f;
+  }
+
   bool list_all_files(Array<String> *files) {
     return list_all_files_help(files, "");
   }
 };
 
+// lowercase, since zip lookups ignore case
+static u64 zip_name_hash(String name) {
+  u64 hash = 14695981039346656037u;
+  for (u64 i = 0; i < name.len; i++) {
+    char c = name.data[i];
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    hash ^= (u8)c;
+    hash *= 1099511628211u;
+  }
+  return hash;
+}
+
+static bool zip_name_equal(String lhs, String rhs) {
+  if (lhs.len != rhs.len) {
+    return false;
+  }
+
+  for (u64 i = 0; i < lhs.len; i++) {
+    char a = lhs.data[i];
+    char b = rhs.data[i];
+    a = a >= 'A' && a <= 'Z' ? a + ('a' - 'A') : a;
+    b = b >= 'A' && b <= 'Z' ? b + ('a' - 'A') : b;
+    if (a != b) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+struct ZipEntry {
+  String name;
+  u64 offset; // of the file data, from the start of the archive
+  u64 size;   // bytes stored in the archive
+  u64 uncompressed_size;
+  u32 crc32;
+  u32 method; // 0 if stored, MZ_DEFLATED if compressed, -1 if unsupported
+};
+
+struct ZipCacheSlot {
+  u32 entry;
+  u64 last_used;
+  String contents;
+};
+
+// only entries this small are cached, so copying out of the cache under the
+// lock stays cheap
+constexpr u64 ZIP_CACHE_MAX_ENTRY = 512 * 1024;
+constexpr i32 ZIP_CACHE_SLOTS = 8;
+
+// the entry table is built at mount and never changes after that, so reads
+// decompress straight from the archive in memory without taking a lock. only
+// the cache of recently decompressed files has one.
 struct ZipFileSystem : FileSystem {
-  Mutex mtx = {};
-  mz_zip_archive zip = {};
   String zip_contents = {};
+  char *zip_begin = nullptr;
+  Array<ZipEntry> entries = {};
+  HashMap<u32> by_name = {};
 
-  void make() {
-    mtx.make();
-  }
+  Mutex cache_mtx = {};
+  ZipCacheSlot cache[ZIP_CACHE_SLOTS] = {};
+  u64 cache_tick = 0;
+
+  void make() { cache_mtx.make(); }
 
   void trash() {
-    if (zip_contents.data != nullptr) {
-      mz_zip_reader_end(&zip);
-      mem_free(zip_contents.data);
+    for (ZipCacheSlot &slot : cache) {
+      mem_free(slot.contents.data);
+    }
+
+    for (ZipEntry &e : entries) {
+      mem_free(e.name.data);
     }
+    entries.trash();
+    by_name.trash();
+    mem_free(zip_contents.data);
 
-    mtx.trash();
+    cache_mtx.trash();
   }
 
   bool mount(String filepath) {
@@ -183,97 +483,639 @@ struct ZipFileSystem : FileSystem {
       return false;
     }
 
+    mz_zip_archive zip = {};
     mz_bool zip_ok = mz_zip_reader_init_mem(&zip, begin, zip_len, 0);
     if (!zip_ok) {
       mz_zip_error err = mz_zip_get_last_error(&zip);
       fprintf(stderr, "failed to read zip: %s\n", mz_zip_get_error_string(err));
       return false;
     }
+    defer(mz_zip_reader_end(&zip));
+
+    u32 num_files = mz_zip_reader_get_num_files(&zip);
+    entries.reserve(num_files);
+    by_name.reserve(num_files);
+
+    for (u32 i = 0; i < num_files; i++) {
+      mz_zip_archive_file_stat stat;
+      if (!mz_zip_reader_file_stat(&zip, i, &stat)) {
+        fprintf(stderr, "can't read central directory entry %u\n", i);
+        return false;
+      }
+
+      // file data starts after the local header, which can have a different
+      // extra field than the central directory
+      constexpr u64 local_header_size = 30;
+      u64 local = stat.m_local_header_ofs;
+      if (local + local_header_size > zip_len ||
+          read4(&begin[local]) != 0x04034b50) {
+        fprintf(stderr, "bad local header for %s\n", stat.m_filename);
+        return false;
+      }
+
+      u16 name_len = 0;
+      u16 extra_len = 0;
+      memcpy(&name_len, &begin[local + 26], 2);
+      memcpy(&extra_len, &begin[local + 28], 2);
+
+      ZipEntry e = {};
+      e.name = to_cstr({stat.m_filename, strlen(stat.m_filename)});
+      e.offset = local + local_header_size + name_len + extra_len;
+      e.size = stat.m_comp_size;
+      e.uncompressed_size = stat.m_uncomp_size;
+      e.crc32 = stat.m_crc32;
+      e.method = stat.m_method;
+
+      bool supported = stat.m_is_supported && !stat.m_is_encrypted &&
+                       (e.method == 0 || e.method == MZ_DEFLATED) &&
+                       e.offset + e.size <= zip_len;
+      if (!supported) {
+        e.method = (u32)-1;
+      }
+
+      u64 hash = zip_name_hash(e.name);
+      if (by_name.get(hash) == nullptr) {
+        by_name[hash] = (u32)entries.len;
+      }
+      entries.push(e);
+    }
 
     zip_contents = contents;
+    zip_begin = begin;
 
     success = true;
     return true;
   }
 
-  bool file_exists(String filepath) {
-    PROFILE_FUNC();
+  const ZipEntry *find(String filepath) {
+    u32 *index = by_name.get(zip_name_hash(filepath));
+    if (index == nullptr) {
+      return nullptr;
+    }
 
-    String path = to_cstr(filepath);
-    defer(mem_free(path.data));
+    const ZipEntry *e = &entries[*index];
+    if (!zip_name_equal(e->name, filepath)) {
+      return nullptr;
+    }
 
-    LockGuard lock{&mtx};
+    return e;
+  }
+
+  bool file_exists(String filepath) { return find(filepath) != nullptr; }
+
+  bool cache_read(String *out, u32 entry) {
+    LockGuard lock{&cache_mtx};
 
-    i32 i = mz_zip_reader_locate_file(&zip, path.data, nullptr, 0);
-    if (i == -1) {
+    for (ZipCacheSlot &slot : cache) {
+      if (slot.contents.data != nullptr && slot.entry == entry) {
+        slot.last_used = ++cache_tick;
+
+        char *buf = (char *)mem_alloc(slot.contents.len + 1);
+        memcpy(buf, slot.contents.data, slot.contents.len + 1);
+        *out = {buf, slot.contents.len};
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void cache_write(u32 entry, String contents) {
+    char *buf = (char *)mem_alloc(contents.len + 1);
+    memcpy(buf, contents.data, contents.len + 1);
+
+    LockGuard lock{&cache_mtx};
+
+    ZipCacheSlot *lru = &cache[0];
+    for (ZipCacheSlot &slot : cache) {
+      if (slot.contents.data != nullptr && slot.entry == entry) {
+        // another thread decompressed the same file at the same time
+        mem_free(buf);
+        return;
+      }
+
+      if (slot.last_used < lru->last_used) {
+        lru = &slot;
+      }
+    }
+
+    mem_free(lru->contents.data);
+    lru->entry = entry;
+    lru->last_used = ++cache_tick;
+    lru->contents = {buf, contents.len};
+  }
+
+  bool read_entire_file(String *out, String filepath) {
+    PROFILE_FUNC();
+
+    const ZipEntry *e = find(filepath);
+    if (e == nullptr) {
       return false;
     }
 
-    mz_zip_archive_file_stat stat;
-    mz_bool ok = mz_zip_reader_file_stat(&zip, i, &stat);
+    if (e->method == (u32)-1) {
+      fprintf(stderr, "failed to read file '%s': unsupported zip entry\n",
+              e->name.data);
+      return false;
+    }
+
+    u32 index = (u32)(e - entries.data);
+    bool cacheable = e->method == MZ_DEFLATED &&
+                     e->uncompressed_size <= ZIP_CACHE_MAX_ENTRY;
+    if (cacheable && cache_read(out, index)) {
+      return true;
+    }
+
+    u64 size = e->uncompressed_size;
+    char *buf = (char *)mem_alloc(size + 1);
+    const char *src = &zip_begin[e->offset];
+
+    bool ok = true;
+    if (e->method == MZ_DEFLATED) {
+      size_t n = tinfl_decompress_mem_to_mem(buf, size, src, e->size, 0);
+      ok = n == size;
+    } else {
+      ok = e->size == size;
+      if (ok) {
+        memcpy(buf, src, size);
+      }
+    }
+
+    ok = ok && mz_crc32(MZ_CRC32_INIT, (u8 *)buf, size) == e->crc32;
     if (!ok) {
+      fprintf(stderr, "failed to read file '%s': corrupt zip entry\n",
+              e->name.data);
+      mem_free(buf);
       return false;
     }
 
+    buf[size] = 0;
+    *out = {buf, size};
+
+    if (cacheable) {
+      cache_write(index, *out);
+    }
+
     return true;
   }
 
-  bool read_entire_file(String *out, String filepath) {
+  VFSFile *open(String filepath) {
+    const ZipEntry *e = find(filepath);
+    if (e == nullptr || e->method == (u32)-1) {
+      return nullptr;
+    }
+
+    const char *data = &zip_begin[e->offset];
+
+    if (e->method == MZ_DEFLATED) {
+      InflateFile *f = new_vfs_file<InflateFile>();
+      f->make(data, e->size, e->uncompressed_size);
+      return f;
+    }
+
+    // stored files are read straight from the archive
+    MemoryFile *f = new_vfs_file<MemoryFile>();
+    f->view = {};
+    f->view.contents = {(char *)data, e->size};
+    f->cursor = 0;
+    return f;
+  }
+
+  bool list_all_files(Array<String> *files) {
+    PROFILE_FUNC();
+
+    for (ZipEntry &e : entries) {
+      files->push(to_cstr(e.name));
+    }
+
+    return true;
+  }
+};
+
+// pack files hold a game's files for fused builds. the whole pack is
+// mapped into memory, and uncompressed files are viewed in place.
+//
+//   PackHeader
+//   PackEntry[entry_count]
+//   u32[slot_count]  entry index + 1 by name hash, 0 if empty
+//   names            not null terminated
+//   data             each file 16 byte aligned, followed by at least one 0
+
+constexpr u32 PACK_MAGIC = 0x4b415053; // "SPAK"
+constexpr u32 PACK_VERSION = 1;
+
+enum PackCompression : u32 {
+  PackCompression_None,
+  PackCompression_Deflate,
+};
+
+struct PackHeader {
+  u32 magic;
+  u32 version;
+  u32 entry_count;
+  u32 slot_count; // power of 2, at least twice entry_count
+  u64 names_offset;
+  u64 names_len;
+};
+
+struct PackEntry {
+  u64 hash; // fnv1a of the name
+  u64 offset;
+  u64 size; // bytes stored in the pack
+  u64 uncompressed_size;
+  u32 name_offset; // from PackHeader::names_offset
+  u32 name_len;
+  u32 compression;
+  u32 reserved;
+};
+
+static u64 align16(u64 n) { return (n + 15) & ~(u64)15; }
+
+constexpr u64 PACK_MAX_DEFLATE_RATIO = 1032;
+
+struct PackFileSystem : FileSystem {
+  String mapping = {};
+  const PackHeader *header = nullptr;
+  const PackEntry *entries = nullptr;
+  const u32 *slots = nullptr;
+  const char *names = nullptr;
+
+  void make() {}
+
+  void trash() {
+    if (mapping.data != nullptr) {
+      os_unmap_file(mapping);
+    }
+  }
+
+  // deflate can't shrink data by more than about 1032 to 1, so a bigger
+  // uncompressed size is a broken entry, not a file worth allocating for
+  static bool valid_size(const PackEntry *e) {
+    switch (e->compression) {
+    case PackCompression_None: return e->uncompressed_size == e->size;
+    case PackCompression_Deflate:
+      return e->uncompressed_size <= e->size * PACK_MAX_DEFLATE_RATIO;
+    default: return false;
+    }
+  }
+
+  bool mount(String filepath) {
     PROFILE_FUNC();
 
     String path = to_cstr(filepath);
     defer(mem_free(path.data));
 
-    LockGuard lock{&mtx};
-
-    i32 file_index = mz_zip_reader_locate_file(&zip, path.data, nullptr, 0);
-    if (file_index == -1) {
+    if (!os_map_file(path.data, &mapping)) {
       return false;
     }
 
-    mz_zip_archive_file_stat stat;
-    mz_bool ok = mz_zip_reader_file_stat(&zip, file_index, &stat);
+    // anything out of bounds is an error, so nothing is checked on reads.
+    // sums of values from the file are compared by subtracting from len,
+    // so they can't wrap around.
+    u64 len = mapping.len;
+    PackHeader empty = {};
+    const PackHeader *h = len >= sizeof(PackHeader)
+                              ? (const PackHeader *)mapping.data
+                              : &empty;
+    u64 slots_offset = sizeof(PackHeader) + sizeof(PackEntry) * h->entry_count;
+    u64 tables_end = slots_offset + sizeof(u32) * (u64)h->slot_count;
+
+    bool ok = h->magic == PACK_MAGIC && h->version == PACK_VERSION &&
+              h->slot_count != 0 &&
+              (h->slot_count & (h->slot_count - 1)) == 0 &&
+              h->slot_count >= (u64)h->entry_count * 2 && tables_end <= len &&
+              h->names_offset >= tables_end && h->names_offset <= len &&
+              h->names_len <= len - h->names_offset;
+
+    const PackEntry *e = (const PackEntry *)&mapping.data[sizeof(PackHeader)];
+    for (u32 i = 0; ok && i < h->entry_count; i++) {
+      ok = e[i].offset < len && e[i].size < len - e[i].offset &&
+           (u64)e[i].name_offset + e[i].name_len <= h->names_len &&
+           valid_size(&e[i]);
+    }
+
+    // every lookup stops at an empty slot, so there has to be one
+    const u32 *s = (const u32 *)&mapping.data[slots_offset];
+    u32 used = 0;
+    for (u32 i = 0; ok && i < h->slot_count; i++) {
+      ok = s[i] <= h->entry_count;
+      used += s[i] != 0 ? 1 : 0;
+    }
+    ok = ok && used <= h->entry_count && used < h->slot_count;
+
     if (!ok) {
+      fprintf(stderr, "not a valid pack file: %s\n", path.data);
+      os_unmap_file(mapping);
+      mapping = {};
       return false;
     }
 
-    size_t size = stat.m_uncomp_size;
-    char *buf = (char *)mem_alloc(size + 1);
+    header = h;
+    entries = e;
+    slots = (const u32 *)&mapping.data[slots_offset];
+    names = &mapping.data[h->names_offset];
+    return true;
+  }
 
-    ok = mz_zip_reader_extract_to_mem(&zip, file_index, buf, size, 0);
-    if (!ok) {
-      mz_zip_error err = mz_zip_get_last_error(&zip);
-      fprintf(stderr, "failed to read file '%s': %s\n", path.data,
-              mz_zip_get_error_string(err));
+  const PackEntry *find(String filepath) {
+    u64 hash = fnv1a(filepath);
+    u32 mask = header->slot_count - 1;
+
+    for (u32 i = (u32)hash & mask;; i = (i + 1) & mask) {
+      u32 slot = slots[i];
+      if (slot == 0) {
+        return nullptr;
+      }
+
+      const PackEntry *e = &entries[slot - 1];
+      if (e->hash == hash && e->name_len == filepath.len &&
+          memcmp(&names[e->name_offset], filepath.data, filepath.len) == 0) {
+        return e;
+      }
+    }
+  }
+
+  bool file_exists(String filepath) { return find(filepath) != nullptr; }
+
+  bool inflate(String *out, const PackEntry *e) {
+    PROFILE_FUNC();
+
+    char *buf = (char *)mem_alloc(e->uncompressed_size + 1);
+    size_t n = tinfl_decompress_mem_to_mem(buf, e->uncompressed_size,
+                                           &mapping.data[e->offset], e->size,
+                                           0);
+    if (n != e->uncompressed_size) {
       mem_free(buf);
       return false;
     }
 
-    buf[size] = 0;
-    *out = {buf, size};
+    buf[n] = 0;
+    *out = {buf, n};
     return true;
   }
 
-  bool list_all_files(Array<String> *files) {
+  bool read_entire_file(String *out, String filepath) {
     PROFILE_FUNC();
 
-    LockGuard lock{&mtx};
+    const PackEntry *e = find(filepath);
+    if (e == nullptr) {
+      return false;
+    }
 
-    for (u32 i = 0; i < mz_zip_reader_get_num_files(&zip); i++) {
-      mz_zip_archive_file_stat file_stat;
-      mz_bool ok = mz_zip_reader_file_stat(&zip, i, &file_stat);
-      if (!ok) {
-        return false;
-      }
+    if (e->compression == PackCompression_Deflate) {
+      return inflate(out, e);
+    }
+
+    char *buf = (char *)mem_alloc(e->size + 1);
+    memcpy(buf, &mapping.data[e->offset], e->size);
+    buf[e->size] = 0;
+    *out = {buf, e->size};
+    return true;
+  }
+
+  bool view_file(FileView *out, String filepath) {
+    const PackEntry *e = find(filepath);
+    if (e == nullptr) {
+      return false;
+    }
 
-      String name = {file_stat.m_filename, strlen(file_stat.m_filename)};
-      files->push(to_cstr(name));
+    if (e->compression == PackCompression_Deflate) {
+      out->owned = true;
+      return inflate(&out->contents, e);
     }
 
+    out->owned = false;
+    out->contents = {&mapping.data[e->offset], e->size};
+    return true;
+  }
+
+  VFSFile *open(String filepath) {
+    const PackEntry *e = find(filepath);
+    if (e == nullptr) {
+      return nullptr;
+    }
+
+    const char *data = &mapping.data[e->offset];
+
+    if (e->compression == PackCompression_Deflate) {
+      InflateFile *f = new_vfs_file<InflateFile>();
+      f->make(data, e->size, e->uncompressed_size);
+      return f;
+    }
+
+    MemoryFile *f = new_vfs_file<MemoryFile>();
+    f->view = {};
+    f->view.contents = {(char *)data, e->size};
+    f->cursor = 0;
+    return f;
+  }
+
+  bool list_all_files(Array<String> *files) {
+    for (u32 i = 0; i < header->entry_count; i++) {
+      const PackEntry *e = &entries[i];
+      files->push(to_cstr({(char *)&names[e->name_offset], e->name_len}));
+    }
     return true;
   }
 };
 
+static bool write_zeros(FILE *f, u64 n) {
+  char zeros[256] = {};
+  while (n > 0) {
+    u64 len = n < sizeof(zeros) ? n : sizeof(zeros);
+    if (fwrite(zeros, 1, len, f) != len) {
+      return false;
+    }
+    n -= len;
+  }
+  return true;
+}
+
+static bool is_hex_digits(String str) {
+  for (u64 i = 0; i < str.len; i++) {
+    char c = str.data[i];
+    bool hex = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    if (!hex) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// files left out of a pack: the pack itself and older ones, anything in a
+// dot directory like .git, and script and texture cache entries. --pack
+// runs before spry.conf, so cache entries are found by name instead of by
+// their configured directory.
+static bool pack_skips(String file) {
+  if (file.ends_with(".spk")) {
+    return true;
+  }
+
+  u64 start = 0;
+  for (u64 i = 0; i < file.len; i++) {
+    if (file.data[i] == '/') {
+      if (file.data[start] == '.') {
+        return true;
+      }
+      start = i + 1;
+    }
+  }
+
+  // <16 hex digits>.luac or .tex, or a temp file left while writing one
+  String name = {&file.data[start], file.len - start};
+  if (name.len < 16 || !is_hex_digits({name.data, 16})) {
+    return false;
+  }
+
+  String ext = {&name.data[16], name.len - 16};
+  return ext == ".luac" || ext == ".tex" ||
+         ((ext.starts_with(".luac.") || ext.starts_with(".tex.")) &&
+          ext.ends_with(".tmp"));
+}
+
+bool vfs_write_pack(const char *dir, const char *out) {
+  PROFILE_FUNC();
+
+  // open the output before moving into dir, so relative paths still work
+  FILE *f = fopen(out, "wb");
+  if (f == nullptr) {
+    fprintf(stderr, "can't open %s for writing\n", out);
+    return false;
+  }
+  defer(fclose(f));
+
+  if (os_change_dir(dir) != 0) {
+    fprintf(stderr, "can't open directory %s\n", dir);
+    return false;
+  }
+
+  Array<String> all_files = {};
+  defer({
+    for (String file : all_files) {
+      mem_free(file.data);
+    }
+    all_files.trash();
+  });
+  list_all_files_help(&all_files, "");
+
+  Array<String> files = {};
+  defer(files.trash());
+  for (String file : all_files) {
+    if (!pack_skips(file)) {
+      files.push(file);
+    }
+  }
+
+  PackHeader header = {};
+  header.magic = PACK_MAGIC;
+  header.version = PACK_VERSION;
+  header.entry_count = (u32)files.len;
+  header.slot_count = 1;
+  while (header.slot_count < files.len * 2) {
+    header.slot_count *= 2;
+  }
+
+  Array<PackEntry> entries = {};
+  defer(entries.trash());
+  entries.resize(files.len);
+
+  Array<u32> slots = {};
+  defer(slots.trash());
+  slots.resize(header.slot_count);
+  memset(slots.data, 0, sizeof(u32) * slots.len);
+
+  u64 names_len = 0;
+  for (u64 i = 0; i < files.len; i++) {
+    PackEntry e = {};
+    e.hash = fnv1a(files[i]);
+    e.name_offset = (u32)names_len;
+    e.name_len = (u32)files[i].len;
+    entries[i] = e;
+    names_len += files[i].len;
+
+    u32 mask = header.slot_count - 1;
+    u32 slot = (u32)e.hash & mask;
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = (u32)i + 1;
+  }
+
+  header.names_offset = sizeof(PackHeader) +
+                        sizeof(PackEntry) * entries.len +
+                        sizeof(u32) * slots.len;
+  header.names_len = names_len;
+
+  // tables are written last, once every file's offset and size is known
+  u64 offset = align16(header.names_offset + header.names_len);
+  if (!write_zeros(f, offset)) {
+    return false;
+  }
+
+  u64 total_in = 0;
+  u64 total_out = 0;
+  for (u64 i = 0; i < files.len; i++) {
+    String contents = {};
+    if (!read_entire_file_raw(&contents, files[i])) {
+      fprintf(stderr, "can't read %s\n", files[i].data);
+      return false;
+    }
+    defer(mem_free(contents.data));
+
+    PackEntry &e = entries[i];
+    e.offset = offset;
+    e.uncompressed_size = contents.len;
+    e.compression = PackCompression_None;
+
+    // files that are already compressed, like png and ogg, are stored as
+    // is, so they can be viewed in place
+    size_t deflated_len = 0;
+    void *deflated = nullptr;
+    if (contents.len >= 64) {
+      deflated = tdefl_compress_mem_to_heap(contents.data, contents.len,
+                                            &deflated_len,
+                                            TDEFL_DEFAULT_MAX_PROBES);
+    }
+    defer(mz_free(deflated));
+
+    String data = contents;
+    if (deflated != nullptr && deflated_len < contents.len - contents.len / 8) {
+      data = {(char *)deflated, deflated_len};
+      e.compression = PackCompression_Deflate;
+    }
+    e.size = data.len;
+
+    u64 padded = align16(data.len + 1);
+    if (fwrite(data.data, 1, data.len, f) != data.len ||
+        !write_zeros(f, padded - data.len)) {
+      return false;
+    }
+
+    offset += padded;
+    total_in += contents.len;
+    total_out += data.len;
+  }
+
+  bool ok = fseek(f, 0, SEEK_SET) == 0 &&
+            fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(entries.data, sizeof(PackEntry), entries.len, f) ==
+                entries.len &&
+            fwrite(slots.data, sizeof(u32), slots.len, f) == slots.len;
+  for (u64 i = 0; ok && i < files.len; i++) {
+    ok = fwrite(files[i].data, 1, files[i].len, f) == files[i].len;
+  }
+
+  if (!ok) {
+    fprintf(stderr, "failed to write %s\n", out);
+    return false;
+  }
+
+  printf("packed %llu files, %llu bytes into %llu bytes\n",
+         (unsigned long long)files.len, (unsigned long long)total_in,
+         (unsigned long long)offset);
+  return true;
+}
+
 #ifdef __EMSCRIPTEN__
 EM_JS(char *, web_mount_dir, (), { return stringToNewUTF8(spryMount); });
 
@@ -381,6 +1223,9 @@ MountResult vfs_mount(const char *filepath) {
     if (mount_dir.ends_with(".zip")) {
       res.ok = vfs_mount_type<ZipFileSystem>(mount_dir);
       res.is_fused = true;
+    } else if (mount_dir.ends_with(".spk")) {
+      res.ok = vfs_mount_type<PackFileSystem>(mount_dir);
+      res.is_fused = true;
     } else {
       res.ok = vfs_mount_type<DirectoryFileSystem>(mount_dir);
       res.can_hot_reload = res.ok;
@@ -410,55 +1255,61 @@ bool vfs_read_entire_file(String *out, String filepath) {
   return g_filesystem->read_entire_file(out, filepath);
 }
 
+bool vfs_view_file(FileView *out, String filepath) {
+  return g_filesystem->view_file(out, filepath);
+}
+
+void vfs_release_view(FileView *view) {
+  if (view->owned) {
+    mem_free(view->contents.data);
+  } else if (view->mapped) {
+    os_unmap_file(view->contents);
+  }
+  *view = {};
+}
+
 bool vfs_list_all_files(Array<String> *files) {
   return g_filesystem->list_all_files(files);
 }
 
-struct AudioFile {
-  u8 *buf;
-  u64 cursor;
-  u64 len;
-};
+VFSFile *vfs_open(String filepath) { return g_filesystem->open(filepath); }
+
+void vfs_file_close(VFSFile *f) {
+  f->trash();
+  mem_free(f);
+}
+
+u64 vfs_file_read(VFSFile *f, void *buf, u64 len) { return f->read(buf, len); }
+bool vfs_file_seek(VFSFile *f, u64 offset) { return f->seek(offset); }
+u64 vfs_file_tell(VFSFile *f) { return f->tell(); }
+u64 vfs_file_size(VFSFile *f) { return f->size(); }
 
 void *vfs_for_miniaudio() {
   ma_vfs_callbacks vtbl = {};
 
   vtbl.onOpen = [](ma_vfs *pVFS, const char *pFilePath, ma_uint32 openMode,
                    ma_vfs_file *pFile) -> ma_result {
-    String contents = {};
-
     if (openMode & MA_OPEN_MODE_WRITE) {
       return MA_ERROR;
     }
 
-    bool ok = vfs_read_entire_file(&contents, pFilePath);
-    if (!ok) {
+    VFSFile *file = vfs_open(pFilePath);
+    if (file == nullptr) {
       return MA_ERROR;
     }
 
-    AudioFile *file = (AudioFile *)mem_alloc(sizeof(AudioFile));
-    file->buf = (u8 *)contents.data;
-    file->len = contents.len;
-    file->cursor = 0;
-
     *pFile = file;
     return MA_SUCCESS;
   };
 
   vtbl.onClose = [](ma_vfs *pVFS, ma_vfs_file file) -> ma_result {
-    AudioFile *f = (AudioFile *)file;
-    mem_free(f->buf);
-    mem_free(f);
+    vfs_file_close((VFSFile *)file);
     return MA_SUCCESS;
   };
 
   vtbl.onRead = [](ma_vfs *pVFS, ma_vfs_file file, void *pDst,
                    size_t sizeInBytes, size_t *pBytesRead) -> ma_result {
-    AudioFile *f = (AudioFile *)file;
-
-    u64 remaining = f->len - f->cursor;
-    u64 len = remaining < sizeInBytes ? remaining : sizeInBytes;
-    memcpy(pDst, &f->buf[f->cursor], len);
+    u64 len = vfs_file_read((VFSFile *)file, pDst, sizeInBytes);
 
     if (pBytesRead != nullptr) {
       *pBytesRead = len;
@@ -478,35 +1329,32 @@ void *vfs_for_miniaudio() {
 
   vtbl.onSeek = [](ma_vfs *pVFS, ma_vfs_file file, ma_int64 offset,
                    ma_seek_origin origin) -> ma_result {
-    AudioFile *f = (AudioFile *)file;
+    VFSFile *f = (VFSFile *)file;
 
     i64 seek = 0;
     switch (origin) {
     case ma_seek_origin_start: seek = offset; break;
-    case ma_seek_origin_end: seek = f->len + offset; break;
+    case ma_seek_origin_end: seek = vfs_file_size(f) + offset; break;
     case ma_seek_origin_current:
-    default: seek = f->cursor + offset; break;
+    default: seek = vfs_file_tell(f) + offset; break;
     }
 
-    if (seek < 0 || seek > f->len) {
+    if (seek < 0 || !vfs_file_seek(f, (u64)seek)) {
       return MA_ERROR;
     }
 
-    f->cursor = (u64)seek;
     return MA_SUCCESS;
   };
 
   vtbl.onTell = [](ma_vfs *pVFS, ma_vfs_file file,
                    ma_int64 *pCursor) -> ma_result {
-    AudioFile *f = (AudioFile *)file;
-    *pCursor = f->cursor;
+    *pCursor = vfs_file_tell((VFSFile *)file);
     return MA_SUCCESS;
   };
 
   vtbl.onInfo = [](ma_vfs *pVFS, ma_vfs_file file,
                    ma_file_info *pInfo) -> ma_result {
-    AudioFile *f = (AudioFile *)file;
-    pInfo->sizeInBytes = f->len;
+    pInfo->sizeInBytes = vfs_file_size((VFSFile *)file);
     return MA_SUCCESS;
   };
 
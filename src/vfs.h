@@ -12,9 +12,37 @@ struct MountResult {
 MountResult vfs_mount(const char *filepath);
 void vfs_trash();
 
+// read only file contents. large files in a directory are mapped into
+// memory, and uncompressed files in a pack file are viewed in place, so
+// neither is copied. release views when done, and read files that are kept
+// for a long time with vfs_read_entire_file, since a mapped file that's
+// truncated while in use faults when read.
+struct FileView {
+  String contents; // followed by a 0 byte, like vfs_read_entire_file
+  bool owned;      // contents were allocated for this view
+  bool mapped;     // contents are a mapping of the whole file
+};
+
 bool vfs_file_exists(String filepath);
 bool vfs_read_entire_file(String *out, String filepath);
+bool vfs_view_file(FileView *out, String filepath);
+void vfs_release_view(FileView *view);
 bool vfs_write_entire_file(String filepath, String contents);
 bool vfs_list_all_files(Array<String> *files);
 
-void *vfs_for_miniaudio();
\ No newline at end of file
+// a read only file that's read a piece at a time. files in a directory are
+// read from disk as needed, and compressed files in an archive are
+// decompressed as they're read, so memory use doesn't grow with file size.
+struct VFSFile;
+
+VFSFile *vfs_open(String filepath); // nullptr if the file can't be opened
+void vfs_file_close(VFSFile *f);
+u64 vfs_file_read(VFSFile *f, void *buf, u64 len); // bytes read
+bool vfs_file_seek(VFSFile *f, u64 offset);        // from the start
+u64 vfs_file_tell(VFSFile *f);
+u64 vfs_file_size(VFSFile *f);
+
+void *vfs_for_miniaudio();
+
+// writes every file in dir into a pack file that can be mounted instead
+bool vfs_write_pack(const char *dir, const char *out);
\ No newline at end of file
@@ -121,12 +121,24 @@ $api_reference = [
         " .hot_reload" => ["boolean", "Enable/disable hot reloading of scripts and assets.", "true"],
         " .startup_load_scripts" => ["boolean", "Enable/disable loading all lua scripts in the project.", "true"],
         " .fullscreen" => ["boolean", "If true, start the program in fullscreen mode.", "false"],
-        " .reload_interval" => ["number", "The time in seconds to update files for hot reloading.", 0.1],
+        " .reload_interval" => ["number", "The time in seconds to check files for hot reloading. Not used on Linux, where changes are picked up as soon as files are written.", 0.1],
         " .swap_interval" => ["number", "Set the swap interval. Typically 1 for VSync, or 0 for no VSync.", 1],
         " .target_fps" => ["number", "Set the maximum frames to render per second. No FPS limit if target is 0.", 0],
         " .window_width" => ["number", "The window width.", 800],
         " .window_height" => ["number", "The window height.", 600],
         " .window_title" => ["string", "The window title.", "'Spry'"],
+        " .text_cache_budget" => ["number", "Memory in bytes used to cache the layout of drawn text.", 1048576],
+        " .max_vertices" => ["number", "Vertices that can be drawn before the renderer moves to another buffer.", 65536],
+        " .max_commands" => ["number", "Draw commands that can be issued before the renderer moves to another buffer.", 16384],
+        " .image_pack_size" => ["number", "Images loaded with `spry.image_load` that are at most this many pixels wide and high share textures with other images. Off if 0.", 0],
+        " .image_page_size" => ["number", "The width and height of the textures that small images are packed into.", 2048],
+        " .texture_cache" => ["string", "A directory to save decoded images and their mipmaps in, so later runs can skip decoding. Entries are keyed by file contents, so changed images are decoded again. Off if empty.", "''"],
+        " .texture_cache_size" => ["number", "Bytes the texture cache directory can use. Entries used least recently are deleted at startup until it fits.", 1073741824],
+        " .script_cache" => ["string", "A directory to save compiled Lua scripts in, so later runs can skip parsing them. Entries are keyed by file contents, so changed scripts are compiled again. Games running from a zip or pack file also read entries from this directory in the archive. Off if empty.", "''"],
+        " .script_cache_size" => ["number", "Bytes the script cache directory can use. Entries used least recently are deleted at startup until it fits. Entries for old versions of a script are deleted when the script changes.", 67108864],
+        " .srgb_mipmaps" => ["boolean", "If true, average mipmap colors in linear space, which keeps dark and bright detail from shifting as images get smaller.", "false"],
+        " .worker_threads" => ["number", "Threads used for work like mipmap generation and compiling scripts at startup. One less than the number of cores if 0.", 0],
+        " .asset_budget" => ["number", "Memory in bytes that images, sprites and tilemaps can use together. When over budget, assets that aren't used anymore are freed, least recently used first. No limit if 0.", 0],
       ],
       "return" => false,
     ],
@@ -347,6 +359,47 @@ $api_reference = [
         "on failure" => "nil, string",
       ],
     ],
+    "spry.unload" => [
+      "desc" => "
+        Drop an Image, Sprite or Tilemap. If nothing else uses the same
+        file, it's freed once the current frame is drawn. The object can't
+        be used after this, and drawing it raises an error.
+
+        Objects that are garbage collected are freed the same way, but only
+        when `asset_budget` in `spry.conf` runs out.
+      ",
+      "example" => "
+        spry.unload(level.tilemap)
+        level.tilemap = spry.tilemap_load 'level2.ldtk'
+      ",
+      "args" => [
+        "asset" => ["Image, Sprite or Tilemap", "The object to unload."],
+      ],
+      "return" => false,
+    ],
+    "spry.asset_stats" => [
+      "desc" => "
+        Get memory used by loaded images, sprites, tilemaps and scripts. The
+        table has these fields:
+
+        - `count`: assets loaded.
+        - `cpu_bytes`, `gpu_bytes`: memory used by every asset together.
+        - `budget`: `asset_budget` from `spry.conf`.
+        - `unloaded`: assets freed to stay under budget so far.
+        - `assets`: if `detailed` is true, a list with a table for each
+          asset, with `name`, `kind`, `refs`, `cpu_bytes` and `gpu_bytes`.
+      ",
+      "example" => "
+        local stats = spry.asset_stats(true)
+        for _, a in ipairs(stats.assets) do
+          print(a.name, a.refs, a.gpu_bytes)
+        end
+      ",
+      "args" => [
+        "detailed" => ["boolean", "If true, include the list of assets.", "false"],
+      ],
+      "return" => "table",
+    ],
   ],
   "Filesystem" => [
     "spry.program_path" => [
@@ -384,6 +437,71 @@ $api_reference = [
         "on failure" => "nil, false",
       ],
     ],
+    "spry.file_open" => [
+      "desc" => "
+        Open a file for reading a piece at a time, without loading the
+        whole file into memory. Compressed files in a zip or pack file are
+        decompressed as they're read. The file is closed when it's garbage
+        collected, or with `File:close`.
+      ",
+      "example" => "
+        local f = spry.file_open 'data/level.bin'
+        local header = f:read(16)
+      ",
+      "args" => [
+        "path" => ["string", "The file path."],
+      ],
+      "return" => [
+        "on success" => "File",
+        "on failure" => "nil",
+      ],
+    ],
+    "File:read" => [
+      "desc" => "Read bytes from the current position, and move past them.",
+      "example" => "
+        while true do
+          local chunk = f:read(4096)
+          if chunk == nil then break end
+          process(chunk)
+        end
+      ",
+      "args" => [
+        "n" => ["number", "The most bytes to read.", "the rest of the file"],
+      ],
+      "return" => [
+        "on success" => "string",
+        "at the end of the file" => "nil",
+      ],
+    ],
+    "File:seek" => [
+      "desc" => "
+        Move to a position in the file. In compressed files, seeking back
+        decompresses from the start of the file again.
+      ",
+      "example" => "f:seek(0)",
+      "args" => [
+        "offset" => ["number", "The position, in bytes from the start."],
+      ],
+      "return" => "boolean",
+    ],
+    "File:tell" => [
+      "desc" => "Get the current position in the file.",
+      "example" => "local pos = f:tell()",
+      "args" => [],
+      "return" => "number",
+    ],
+    "File:size" => [
+      "desc" => "Get the size of the file in bytes.",
+      "example" => "local remaining = f:size() - f:tell()",
+      "args" => [],
+      "return" => "number",
+    ],
+    "File:close" => [
+      "desc" => "Close the file. The file can't be used after this.",
+      "example" => "f:close()",
+      "args" => [],
+      "return" => false,
+    ],
     "spry.file_write" => [
       "desc" => "Write string contents to a file.",
       "example" => "spry.file_write('checkpoints.data' serialize(player_checkpoints))",
@@ -648,6 +766,67 @@ $api_reference = [
       "args" => [],
       "return" => false,
     ],
+    "spry.deferred_draw" => [
+      "desc" => "
+        Enable or disable deferred drawing. When enabled, draws are recorded
+        and sorted by layer, then by texture, before they are sent to the GPU.
+        This reduces texture switches when many different images are drawn in
+        an interleaved order, but draws that share a layer are no longer
+        guaranteed to overlap in the order they were made. Use
+        `spry.draw_layer` to keep things in front of each other.
+      ",
+      "example" => "
+        function spry.start()
+          spry.deferred_draw(true)
+        end
+      ",
+      "args" => [
+        "enabled" => ["boolean", "True to defer and sort draws."],
+      ],
+      "return" => false,
+    ],
+    "spry.draw_layer" => [
+      "desc" => "
+        Set the layer for draws made after this call. Layers are drawn from
+        lowest to highest. Only used when deferred drawing is enabled. Calling
+        this function without arguments returns the current layer.
+      ",
+      "example" => "
+        spry.draw_layer(0)
+        tilemap:draw()
+
+        spry.draw_layer(1)
+        world:draw()
+      ",
+      "args" => [
+        "layer" => ["number", "The layer, in the range [-32768, 32767].", 0],
+      ],
+      "return" => false,
+    ],
+    "spry.draw_stats" => [
+      "desc" => "
+        Get draw counters for the previous frame. The table has these fields:
+
+        - `commands`, `vertices`: primitives and vertices drawn.
+        - `state_changes`, `state_changes_saved`: texture switches, and
+          switches avoided by `spry.deferred_draw`.
+        - `sgl_vertices`, `sgl_commands`: buffer space used by immediate mode
+          drawing.
+        - `sgl_contexts`: buffers used. More than 1 means the frame went over
+          `max_vertices` or `max_commands` from `spry.conf`.
+        - `sgl_dropped`: vertices that were skipped because every buffer was
+          full.
+        - `sgl_vertices_peak`, `sgl_commands_peak`: the highest usage of any
+          frame so far, useful for picking `max_vertices` and `max_commands`.
+      ",
+      "example" => "
+        local stats = spry.draw_stats()
+        print(stats.state_changes, stats.state_changes_saved)
+        print(stats.sgl_vertices_peak, stats.sgl_commands_peak)
+      ",
+      "args" => [],
+      "return" => "table",
+    ],
     "spry.draw_filled_rect" => [
       "desc" => "Draw a solid filled rectangle.",
       "example" => "spry.draw_filled_rect(self.x, self.y, w, h)",
@@ -750,7 +929,14 @@ $api_reference = [
   ],
   "Image" => [
     "spry.image_load" => [
-      "desc" => "Create an image object from an image file.",
+      "desc" => "
+        Create an image object from an image file.
+
+        If `image_pack_size` is set in `spry.conf`, small images are packed
+        into shared textures as they're loaded, so drawing many different
+        small images doesn't switch textures between draws. Packed images
+        can't be drawn with a repeating sampler.
+      ",
       "example" => "local tree_img = spry.image_load 'tree.png'",
       "args" => [
         "file" => ["string", "The image file to open."],
@@ -761,6 +947,47 @@ $api_reference = [
         "if image can't be loaded" => "nil",
       ],
     ],
+    "spry.image_load_async" => [
+      "desc" => "
+        Start loading an image on a worker thread, and return a future for
+        it right away. The file is read and decoded on a worker, and the
+        texture is created on the main thread at the end of the frame.
+        Use `AssetFuture:ready` to poll the load, or `await` it in a
+        coroutine.
+      ",
+      "example" => "
+        function Level:load_thread()
+          self.background = await(spry.image_load_async 'background.png')
+        end
+      ",
+      "args" => [
+        "file" => ["string", "The image file to open."],
+        "generate_mips" => ["bool", "If true, also generate mipmaps.", "true"],
+      ],
+      "return" => "AssetFuture",
+    ],
+    "AssetFuture:ready" => [
+      "desc" => "Check if an async load is done, whether or not it succeeded.",
+      "example" => "
+        if future:ready() then
+          img = future:get()
+        end
+      ",
+      "args" => [],
+      "return" => "boolean",
+    ],
+    "AssetFuture:get" => [
+      "desc" => "
+        Get the loaded asset. The asset is an Image, Sprite or Tilemap,
+        depending on the function that started the load.
+      ",
+      "example" => "local img = future:get()",
+      "args" => [],
+      "return" => [
+        "on success" => "Image, Sprite or Tilemap",
+        "if not ready or the asset can't be loaded" => "nil",
+      ],
+    ],
     "Image:draw" => [
       "desc" => "Draw an image onto the screen.",
       "example" => "
@@ -793,12 +1020,108 @@ $api_reference = [
       "return" => "number",
     ],
   ],
+  "Canvas" => [
+    "spry.make_canvas" => [
+      "desc" => "
+        Create a canvas. A canvas is an image that can be drawn into. Content
+        that is expensive to draw, but rarely changes, can be drawn into a
+        canvas once, then drawn every frame as a single image.
+      ",
+      "example" => "
+        function spry.start()
+          background = spry.make_canvas(800, 600)
+          background:begin()
+          tilemap:draw()
+          background:finish()
+        end
+
+        function spry.frame(dt)
+          background:draw(0, 0)
+        end
+      ",
+      "args" => [
+        "width" => ["number", "The canvas width in pixels."],
+        "height" => ["number", "The canvas height in pixels."],
+      ],
+      "return" => [
+        "on success" => "Canvas",
+        "if the canvas can't be made" => "nil",
+      ],
+    ],
+    "Canvas:begin" => [
+      "desc" => "
+        Start drawing into the canvas. Everything drawn until `Canvas:finish`
+        goes to the canvas, with the top-left corner of the canvas at `(0, 0)`.
+        Canvases are rendered before the screen each frame. A canvas can't be
+        started while another canvas is active.
+
+        Pass `false` to draw on top of the existing canvas content instead of
+        clearing it.
+      ",
+      "example" => "
+        -- clear to transparent
+        canvas:begin()
+
+        -- clear to white
+        canvas:begin(255, 255, 255, 255)
+
+        -- keep what's already there
+        canvas:begin(false)
+      ",
+      "args" => [
+        "r" => ["number", "The red clear color, or `false` to not clear.", 0],
+        "g" => ["number", "The green clear color.", 0],
+        "b" => ["number", "The blue clear color.", 0],
+        "a" => ["number", "The alpha clear color.", 0],
+      ],
+      "return" => false,
+    ],
+    "Canvas:finish" => [
+      "desc" => "Stop drawing into the canvas, and go back to the screen.",
+      "example" => "canvas:finish()",
+      "args" => [],
+      "return" => false,
+    ],
+    "Canvas:draw" => [
+      "desc" => "Draw the canvas like an image.",
+      "example" => "canvas:draw(0, 0)",
+      "args" => array_merge($draw_description, [
+        "u0" => ["number", "The top-left x texture coordinate in the range [0, 1].", 0],
+        "v0" => ["number", "The top-left y texture coordinate in the range [0, 1].", 0],
+        "u1" => ["number", "The bottom-right x texture coordinate.", 1],
+        "v1" => ["number", "The bottom-right y texture coordinate.", 1],
+      ]),
+      "return" => false,
+    ],
+    "Canvas:width" => [
+      "desc" => "Get the width of the canvas.",
+      "example" => "local w = canvas:width()",
+      "args" => [],
+      "return" => "number",
+    ],
+    "Canvas:height" => [
+      "desc" => "Get the height of the canvas.",
+      "example" => "local h = canvas:height()",
+      "args" => [],
+      "return" => "number",
+    ],
+  ],
   "Font" => [
     "spry.font_load" => [
-      "desc" => "Create a font object from a `.ttf` file.",
-      "example" => "local font = spry.font_load 'roboto.ttf'",
+      "desc" => "
+        Create a font object from a `.ttf` file.
+
+        If `sdf` is true, glyphs are stored as signed distance fields. They
+        are rasterized once and stay sharp when drawn at any size, scale, or
+        rotation, at the cost of slightly rounder corners.
+      ",
+      "example" => "
+        local font = spry.font_load 'roboto.ttf'
+        local title = spry.font_load('roboto.ttf', true)
+      ",
       "args" => [
         "file" => ["string", "The font file to open."],
+        "sdf" => ["boolean", "Use signed distance field glyphs.", "false"],
       ],
       "return" => [
         "on success" => "Font",
@@ -835,6 +1158,32 @@ $api_reference = [
       ],
       "return" => "number",
     ],
+    "Font:make_text" => [
+      "desc" => "
+        Create a text object. The text is laid out once and kept in GPU
+        memory, which makes it cheap to draw long text that doesn't change
+        often, like dialogue.
+      ",
+      "example" => "
+        local line = font:make_text('Once upon a time...', 24, 400)
+        line:draw(100, 100)
+      ",
+      "args" => [
+        "text" => ["string", "The text to lay out."],
+        "size" => ["number", "The size of the text.", 12],
+        "limit" => ["number", "Word wrap width.", -1],
+      ],
+      "return" => "Text",
+    ],
+    "Text:draw" => [
+      "desc" => "Draw a text object. Returns the bottom y position of the text.",
+      "example" => "line:draw(100, 100)",
+      "args" => [
+        "x" => ["number", "The x position to draw at.", 0],
+        "y" => ["number", "The y position to draw at.", 0],
+      ],
+      "return" => "number",
+    ],
   ],
   "Sound" => [
     "spry.set_master_volume" => [
@@ -1033,6 +1382,17 @@ $api_reference = [
         "if sprite can't be loaded" => "nil",
       ],
     ],
+    "spry.sprite_load_async" => [
+      "desc" => "
+        Start loading a sprite on a worker thread. See
+        `spry.image_load_async`.
+      ",
+      "example" => "local future = spry.sprite_load_async 'player.ase'",
+      "args" => [
+        "file" => ["string", "The Aseprite file to open."],
+      ],
+      "return" => "AssetFuture",
+    ],
     "Sprite:play" => [
       "desc" => "
         Play an animation loop with the given tag. If the sprite's animation
@@ -1151,6 +1511,399 @@ $api_reference = [
       "return" => "number",
     ],
   ],
+  "Sprite Batch" => [
+    "spry.make_batch" => [
+      "desc" => "
+        Create a sprite batch. A sprite batch holds many quads that share the
+        same image in GPU memory, and draws all of them at once. Quads stay in
+        the batch between frames, so static scenery only needs to be added
+        once.
+      ",
+      "example" => "
+        local batch = spry.make_batch(img, 4096)
+        for i = 0, 99 do
+          batch:add(i * 16, 0)
+        end
+      ",
+      "args" => [
+        "image" => ["Image | AtlasImage", "The image used by every quad in the batch."],
+        "capacity" => ["number", "The maximum number of quads.", 1024],
+      ],
+      "return" => "SpriteBatch",
+    ],
+    "SpriteBatch:add" => [
+      "desc" => "
+        Add a quad to the batch. The quad uses the current color from
+        `spry.push_color`. Texture coordinates are relative to the batch's
+        image, so for an atlas image, `(0, 0, 1, 1)` covers the atlas region.
+      ",
+      "example" => "local i = batch:add(x, y)",
+      "args" => array_merge($draw_description, [
+        "u0" => ["number", "The top-left x texture coordinate in the range [0, 1].", 0],
+        "v0" => ["number", "The top-left y texture coordinate in the range [0, 1].", 0],
+        "u1" => ["number", "The bottom-right x texture coordinate.", 1],
+        "v1" => ["number", "The bottom-right y texture coordinate.", 1],
+      ]),
+      "return" => [
+        "on success" => "The index of the new quad, starting at 1.",
+        "if the batch is full" => "nil",
+      ],
+    ],
+    "SpriteBatch:set" => [
+      "desc" => "Replace a quad that was previously added to the batch.",
+      "example" => "batch:set(i, x, y)",
+      "args" => array_merge([
+        "index" => ["number", "The quad index returned by `SpriteBatch:add`."],
+      ], $draw_description, [
+        "u0" => ["number", "The top-left x texture coordinate in the range [0, 1].", 0],
+        "v0" => ["number", "The top-left y texture coordinate in the range [0, 1].", 0],
+        "u1" => ["number", "The bottom-right x texture coordinate.", 1],
+        "v1" => ["number", "The bottom-right y texture coordinate.", 1],
+      ]),
+      "return" => "boolean",
+    ],
+    "SpriteBatch:clear" => [
+      "desc" => "Remove all quads from the batch.",
+      "example" => "batch:clear()",
+      "args" => [],
+      "return" => false,
+    ],
+    "SpriteBatch:draw" => [
+      "desc" => "
+        Draw every quad in the batch with a single draw call. The current
+        transform and color are applied to the whole batch.
+      ",
+      "example" => "
+        spry.push_matrix()
+        spry.translate(-camera.x, -camera.y)
+        batch:draw()
+        spry.pop_matrix()
+      ",
+      "args" => [],
+      "return" => false,
+    ],
+    "SpriteBatch:len" => [
+      "desc" => "Get the number of quads in the batch.",
+      "example" => "local n = batch:len()",
+      "args" => [],
+      "return" => "number",
+    ],
+    "SpriteBatch:capacity" => [
+      "desc" => "Get the maximum number of quads the batch can hold.",
+      "example" => "local cap = batch:capacity()",
+      "args" => [],
+      "return" => "number",
+    ],
+  ],
+  "Instances" => [
+    "spry.make_instances" => [
+      "desc" => "
+        Create an instance buffer. Each instance is one quad, stored as its
+        position, scale, origin, rotation, texture coordinates and color. The
+        corners are computed on the GPU, so instances are cheaper to update
+        every frame than sprite batch quads. Useful for bullets, particles,
+        and other things that move a lot.
+      ",
+      "example" => "
+        local bullets = spry.make_instances(2048)
+        for _, b in ipairs(all_bullets) do
+          bullets:add(b.x, b.y, b.angle)
+        end
+      ",
+      "args" => [
+        "capacity" => ["number", "The maximum number of instances.", 1024],
+      ],
+      "return" => "Instances",
+    ],
+    "spry.draw_instances" => [
+      "desc" => "
+        Draw every instance in the buffer with one draw call, using the given
+        image. The current transform and color are applied to all instances.
+        For an atlas image, instance texture coordinates are relative to the
+        atlas region.
+      ",
+      "example" => "
+        bullets:clear()
+        for _, b in ipairs(all_bullets) do
+          bullets:add(b.x, b.y, b.angle)
+        end
+        spry.draw_instances(bullet_img, bullets)
+      ",
+      "args" => [
+        "image" => ["Image | AtlasImage", "The image to draw instances with."],
+        "buffer" => ["Instances", "The instances to draw."],
+      ],
+      "return" => false,
+    ],
+    "Instances:add" => [
+      "desc" => "
+        Add an instance. The instance uses the current color from
+        `spry.push_color`.
+      ",
+      "example" => "local i = bullets:add(x, y)",
+      "args" => array_merge($draw_description, [
+        "u0" => ["number", "The top-left x texture coordinate in the range [0, 1].", 0],
+        "v0" => ["number", "The top-left y texture coordinate in the range [0, 1].", 0],
+        "u1" => ["number", "The bottom-right x texture coordinate.", 1],
+        "v1" => ["number", "The bottom-right y texture coordinate.", 1],
+      ]),
+      "return" => [
+        "on success" => "The index of the new instance, starting at 1.",
+        "if the buffer is full" => "nil",
+      ],
+    ],
+    "Instances:set" => [
+      "desc" => "Replace an instance that was previously added.",
+      "example" => "bullets:set(i, x, y)",
+      "args" => array_merge([
+        "index" => ["number", "The index returned by `Instances:add`."],
+      ], $draw_description, [
+        "u0" => ["number", "The top-left x texture coordinate in the range [0, 1].", 0],
+        "v0" => ["number", "The top-left y texture coordinate in the range [0, 1].", 0],
+        "u1" => ["number", "The bottom-right x texture coordinate.", 1],
+        "v1" => ["number", "The bottom-right y texture coordinate.", 1],
+      ]),
+      "return" => "boolean",
+    ],
+    "Instances:clear" => [
+      "desc" => "Remove all instances from the buffer.",
+      "example" => "bullets:clear()",
+      "args" => [],
+      "return" => false,
+    ],
+    "Instances:len" => [
+      "desc" => "Get the number of instances in the buffer.",
+      "example" => "local n = bullets:len()",
+      "args" => [],
+      "return" => "number",
+    ],
+    "Instances:capacity" => [
+      "desc" => "Get the maximum number of instances the buffer can hold.",
+      "example" => "local cap = bullets:capacity()",
+      "args" => [],
+      "return" => "number",
+    ],
+  ],
+  "Particles" => [
+    "spry.make_emitter" => [
+      "desc" => "
+        Create a particle emitter. Particles are stored and updated in native
+        code, and drawn with a single draw call, so an emitter can handle
+        thousands of particles that would be too slow as Lua tables.
+
+        Each particle starts at the emitter's position, moving in a random
+        direction within `spread` of `direction`. Scale and color blend from
+        their start values to their end values over the particle's lifetime.
+      ",
+      "example" => "
+        smoke = spry.make_emitter(atlas:get_image 'tile_0008', {
+          rate = 60,
+          speed_min = 10,
+          speed_max = 30,
+          life_min = 0.3,
+          life_max = 0.5,
+          spin_min = -1,
+          spin_max = 1,
+          color_end = {255, 255, 255, 0},
+        })
+      ",
+      "args" => [
+        "image" => ["Image | AtlasImage", "The image drawn for each particle."],
+        "desc" => ["table", "Emitter settings:"],
+        " .capacity" => ["number", "The maximum number of live particles.", 1024],
+        " .x" => ["number", "The x position where particles are emitted.", 0],
+        " .y" => ["number", "The y position where particles are emitted.", 0],
+        " .rate" => ["number", "Particles emitted per second.", 0],
+        " .direction" => ["number", "The angle particles move in, in radians.", 0],
+        " .spread" => ["number", "The maximum random offset from direction, in radians.", "math.pi"],
+        " .speed_min" => ["number", "The minimum initial speed.", 0],
+        " .speed_max" => ["number", "The maximum initial speed.", "speed_min"],
+        " .life_min" => ["number", "The minimum lifetime, in seconds.", 1],
+        " .life_max" => ["number", "The maximum lifetime, in seconds.", "life_min"],
+        " .spin_min" => ["number", "The minimum angular velocity.", 0],
+        " .spin_max" => ["number", "The maximum angular velocity.", "spin_min"],
+        " .ax" => ["number", "The x acceleration.", 0],
+        " .ay" => ["number", "The y acceleration.", 0],
+        " .scale_start" => ["number", "The scale of new particles.", 1],
+        " .scale_end" => ["number", "The scale of particles about to die.", "scale_start"],
+        " .color_start" => ["table", "The color of new particles, as `{r, g, b, a}`.", "{255, 255, 255, 255}"],
+        " .color_end" => ["table", "The color of particles about to die.", "color_start"],
+      ],
+      "return" => "Emitter",
+    ],
+    "Emitter:update" => [
+      "desc" => "
+        Move particles, remove dead ones, and emit new ones based on the
+        emitter's rate.
+      ",
+      "example" => "smoke:update(dt)",
+      "args" => [
+        "dt" => ["number", "Delta time."],
+      ],
+      "return" => false,
+    ],
+    "Emitter:draw" => [
+      "desc" => "
+        Draw every live particle. The current transform and color are applied
+        to all of them.
+      ",
+      "example" => "smoke:draw()",
+      "args" => [],
+      "return" => false,
+    ],
+    "Emitter:emit" => [
+      "desc" => "Emit a burst of particles at once.",
+      "example" => "sparks:emit(50)",
+      "args" => [
+        "count" => ["number", "The number of particles to emit."],
+      ],
+      "return" => false,
+    ],
+    "Emitter:set_position" => [
+      "desc" => "Set where new particles are emitted.",
+      "example" => "smoke:set_position(player.x, player.y)",
+      "args" => [
+        "x" => ["number", "The x position."],
+        "y" => ["number", "The y position."],
+      ],
+      "return" => false,
+    ],
+    "Emitter:set_rate" => [
+      "desc" => "Set the number of particles emitted per second.",
+      "example" => "smoke:set_rate(0)",
+      "args" => [
+        "rate" => ["number", "Particles per second."],
+      ],
+      "return" => false,
+    ],
+    "Emitter:set_direction" => [
+      "desc" => "Set the angle that new particles move in.",
+      "example" => "smoke:set_direction(player.angle + math.pi)",
+      "args" => [
+        "angle" => ["number", "The angle in radians."],
+      ],
+      "return" => false,
+    ],
+    "Emitter:clear" => [
+      "desc" => "Remove every live particle.",
+      "example" => "smoke:clear()",
+      "args" => [],
+      "return" => false,
+    ],
+    "Emitter:len" => [
+      "desc" => "Get the number of live particles.",
+      "example" => "local n = smoke:len()",
+      "args" => [],
+      "return" => "number",
+    ],
+  ],
+  "Draw Lists" => [
+    "spry.make_draw_list" => [
+      "desc" => "
+        Create a draw list. Draws made between `DrawList:begin` and
+        `DrawList:finish` are stored in the list instead of going to the
+        screen, so a list can be filled from another thread. The main thread
+        then draws the list. Lists are sent to other threads through
+        channels, and are freed once no thread has a reference to them.
+      ",
+      "example" => "
+        function spry.start()
+          lists = {}
+          for i = 1, 4 do
+            lists[i] = spry.make_draw_list(i)
+            spry.make_thread(worker_code)
+            spry.get_channel('jobs'):send(lists[i])
+          end
+        end
+
+        -- worker thread
+        local jobs = spry.get_channel 'jobs'
+        local done = spry.get_channel 'done'
+        local list = jobs:recv()
+        while true do
+          jobs:recv() -- wait for the next frame
+          list:clear()
+          list:begin()
+          spry.draw_filled_rect(x, y, 16, 16)
+          list:finish()
+          done:send(true)
+        end
+      ",
+      "args" => [
+        "order" => ["number", "Where the list goes in `spry.draw_lists`.", 0],
+      ],
+      "return" => "DrawList",
+    ],
+    "spry.draw_lists" => [
+      "desc" => "
+        Draw several lists, sorted by their order. Lists with the same order
+        are drawn in the order they're given. Threads finish in any order,
+        so this keeps the result the same every frame. Lists being recorded
+        on another thread are skipped.
+      ",
+      "example" => "
+        for i = 1, #lists do
+          done:recv()
+        end
+        spry.draw_lists(table.unpack(lists))
+      ",
+      "args" => [
+        "..." => ["DrawList", "The lists to draw."],
+      ],
+      "return" => false,
+    ],
+    "DrawList:begin" => [
+      "desc" => "
+        Start recording into the list. Until `DrawList:finish`, images,
+        sprites, rectangles and lines drawn on this thread are stored in the
+        list, using the list's own transform and color stacks. Text, sprite
+        batches, instances, particles and tilemaps are skipped. Waits if
+        the list is being drawn on the main thread.
+      ",
+      "example" => "list:begin()",
+      "args" => [],
+      "return" => false,
+    ],
+    "DrawList:finish" => [
+      "desc" => "Stop recording into the list.",
+      "example" => "list:finish()",
+      "args" => [],
+      "return" => false,
+    ],
+    "DrawList:clear" => [
+      "desc" => "
+        Remove everything recorded in the list. Waits if the list is being
+        drawn on the main thread.
+      ",
+      "example" => "list:clear()",
+      "args" => [],
+      "return" => false,
+    ],
+    "DrawList:draw" => [
+      "desc" => "
+        Draw the list on the main thread. The current transform is applied on
+        top of the transform the draws were recorded with. Returns false
+        without drawing if the list is being recorded on another thread.
+      ",
+      "example" => "list:draw()",
+      "args" => [],
+      "return" => "boolean",
+    ],
+    "DrawList:set_order" => [
+      "desc" => "Set where the list goes in `spry.draw_lists`.",
+      "example" => "list:set_order(2)",
+      "args" => [
+        "order" => ["number", "The new order."],
+      ],
+      "return" => false,
+    ],
+    "DrawList:len" => [
+      "desc" => "Get the number of vertices recorded in the list.",
+      "example" => "local n = list:len()",
+      "args" => [],
+      "return" => "number",
+    ],
+  ],
   "Tilemap" => [
     "spry.tilemap_load" => [
       "desc" => "
@@ -1166,14 +1919,35 @@ $api_reference = [
         "if tilemap can't be loaded" => "nil",
       ],
     ],
+    "spry.tilemap_load_async" => [
+      "desc" => "
+        Start loading a tilemap and its tileset images on a worker thread.
+        See `spry.image_load_async`.
+      ",
+      "example" => "local future = spry.tilemap_load_async 'world.ldtk'",
+      "args" => [
+        "file" => ["string", "The tilemap file to open."],
+      ],
+      "return" => "AssetFuture",
+    ],
     "Tilemap:draw" => [
-      "desc" => "Draw an entire tilemap, including all of the map's levels and layers.",
+      "desc" => "
+        Draw a tilemap, including all of the map's levels and layers. Only
+        the parts of the map inside the view rectangle are drawn. If no
+        rectangle is given, the visible area of the window is used, taking
+        the current transform into account.
+      ",
       "example" => "
         camera:begin_draw()
         tilemap:draw()
         camera:end_draw()
       ",
-      "args" => [],
+      "args" => [
+        "x" => ["number", "The left edge of the view rectangle.", "nil"],
+        "y" => ["number", "The top edge of the view rectangle.", "nil"],
+        "w" => ["number", "The width of the view rectangle.", "nil"],
+        "h" => ["number", "The height of the view rectangle.", "nil"],
+      ],
       "return" => false,
     ],
     "Tilemap:entities" => [
@@ -3182,6 +3956,22 @@ $api_reference = [
       ],
       "return" => "number",
     ],
+    "await" => [
+      "desc" => "
+        Yields a coroutine until an async load is done. Returns the loaded
+        asset, or nil if it can't be loaded.
+      ",
+      "example" => "
+        function Level:load_thread()
+          self.tilemap = await(spry.tilemap_load_async 'world.ldtk')
+          self.player = await(spry.sprite_load_async 'player.ase')
+        end
+      ",
+      "args" => [
+        "future" => ["AssetFuture", "The load to wait for."],
+      ],
+      "return" => "Image, Sprite or Tilemap",
+    ],
   ],
 ];
 